@@ -9,7 +9,47 @@ namespace backend {
 struct AppConfig {
   std::string node_name;
   std::string log_level;
+  std::string io_backend;
+  unsigned io_uring_entries;
+  unsigned io_uring_buffer_count;
+  unsigned io_uring_buffer_size;
   std::uint16_t tcp_port;
+  int tcp_listen_backlog;
+  int tcp_accept_batch;
+  bool tcp_edge_triggered;
+  std::string tcp_accept_mode;
+  std::string tcp_worker_assignment;
+  std::size_t tcp_send_high_watermark;
+  std::size_t tcp_send_low_watermark;
+  std::string tcp_framing;
+  int tcp_frame_length_bytes;
+  std::string tcp_frame_delimiter;
+  std::size_t tcp_max_message_size;
+  std::size_t tcp_read_pause_watermark;
+  std::uint64_t tcp_idle_timeout_ms;
+  std::uint64_t udp_idle_timeout_ms;
+  std::size_t udp_batch_size;
+  std::size_t udp_max_datagram_size;
+  bool udp_gso;
+  bool udp_gro;
+  std::uint64_t rtp_idle_timeout_ms;
+  std::uint32_t rtp_forward_sample_every;
+  // 0 hands RTP packets on in arrival order; statistics are kept either way.
+  std::uint64_t rtp_jitter_buffer_ms;
+  std::uint32_t rtp_clock_rate;
+  // RTCP receiver reports about every received stream; 0 sends none.
+  std::uint64_t rtcp_report_interval_ms;
+  // Per disk thread: open files kept, bytes buffered per file, and how long
+  // an append may wait in the buffer; 0 writes it at the end of the pass.
+  std::size_t recorder_max_open_files;
+  std::size_t recorder_block_size;
+  std::uint64_t recorder_flush_interval_ms;
+  // Recordings are cut into segments of at most this many bytes (which are
+  // preallocated) or this long; 0 lifts the limit.
+  std::uint64_t recording_segment_bytes;
+  std::uint64_t recording_segment_ms;
+  // Sealed segments kept per recording directory; 0 keeps everything.
+  std::uint64_t recording_retention_bytes;
   int tcp_io_threads;
   int udp_io_threads;
   int worker_threads;
@@ -20,6 +60,8 @@ struct AppConfig {
   std::size_t queue_size_worker_to_io;
   std::size_t queue_size_worker_to_disk;
   std::size_t queue_size_worker_to_log;
+  std::size_t queue_batch_size;
+  int queue_spin_iterations;
   std::string lua_main_script;
 
   static AppConfig LoadFromFile(const std::string& path);
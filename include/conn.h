@@ -2,12 +2,43 @@
 
 #include "event.h"
 
+#include <cstddef>
 #include <cstdint>
+#include <deque>
+#include <memory>
 #include <string>
-#include <unordered_map>
+#include <vector>
+
+#include <sys/uio.h>
 
 namespace backend {
 
+// Session ids handed to Lua name the IO thread that owns the connection or
+// session, so replies are routed back without a lookup: bits 0-31 hold the
+// fd or table slot, bits 32-39 the index of the owning IO thread and bits
+// 40-63 the generation of the slot, which makes ids of closed connections
+// stale once their fd or slot is reused.
+constexpr std::uint32_t kSessionGenerationMask = 0xFFFFFF;
+
+inline std::uint64_t MakeSessionId(int owner, std::uint32_t index,
+                                   std::uint32_t generation = 0) {
+  return (static_cast<std::uint64_t>(generation & kSessionGenerationMask) << 40) |
+         (static_cast<std::uint64_t>(owner & 0xFF) << 32) |
+         static_cast<std::uint64_t>(index);
+}
+
+inline int SessionOwner(std::uint64_t session_id) {
+  return static_cast<int>((session_id >> 32) & 0xFF);
+}
+
+inline std::uint32_t SessionIndex(std::uint64_t session_id) {
+  return static_cast<std::uint32_t>(session_id & 0xFFFFFFFFu);
+}
+
+inline std::uint32_t SessionGeneration(std::uint64_t session_id) {
+  return static_cast<std::uint32_t>(session_id >> 40) & kSessionGenerationMask;
+}
+
 enum class ConnState {
   Connecting = 0,
   Established = 1,
@@ -15,60 +46,152 @@ enum class ConnState {
   Closed = 3
 };
 
+// Outbound chunks of one connection, kept as separate strings so a flush can
+// hand all of them to the kernel in one scatter-gather send. The deque never
+// moves queued chunks, so bytes of an in-flight asynchronous send stay put
+// while more are appended.
+class SendQueue {
+ public:
+  void Append(std::string&& chunk);
+  // Fills up to max_iov entries describing the unsent bytes, oldest first.
+  int FillIov(iovec* iov, int max_iov) const;
+  void Consume(std::size_t bytes);
+
+  std::size_t PendingBytes() const {
+    return pending_bytes_;
+  }
+
+  bool Empty() const {
+    return pending_bytes_ == 0;
+  }
+
+ private:
+  std::deque<std::string> chunks_;
+  std::size_t head_offset_ = 0;
+  std::size_t pending_bytes_ = 0;
+};
+
+// Fixed-capacity byte ring a connection reads into with readv. Framing needs
+// the unread bytes contiguous, so Data() moves them to the front only when
+// they wrap, and a ring that drains empty restarts at offset 0.
+class RecvRing {
+ public:
+  explicit RecvRing(std::size_t capacity);
+
+  // Describes the free space in at most two entries; returns how many.
+  int FillIov(iovec* iov);
+  void Commit(std::size_t bytes);
+  const char* Data();
+  void Consume(std::size_t bytes);
+
+  std::size_t Size() const {
+    return size_;
+  }
+
+  std::size_t Capacity() const {
+    return capacity_;
+  }
+
+  bool Full() const {
+    return size_ == capacity_;
+  }
+
+ private:
+  std::unique_ptr<char[]> data_;
+  std::size_t capacity_;
+  std::size_t head_;
+  std::size_t size_;
+};
+
+// Fields touched on every IO event. Buffers are allocated on first use so an
+// idle connection costs only its slab entry.
 struct Conn {
   int fd;
   ConnState state;
+  std::uint32_t generation;
   int worker_index;
   ProtocolType protocol;
-  std::string recv_buffer;
-  std::string send_buffer;
-  std::string remote_ip;
+  bool write_armed;
+  bool send_blocked;
+  bool send_scheduled;
+  bool read_paused;
+  std::unique_ptr<RecvRing> recv_ring;
+  std::unique_ptr<SendQueue> send_queue;
+
+  SendQueue& Send() {
+    if (!send_queue) {
+      send_queue = std::make_unique<SendQueue>();
+    }
+    return *send_queue;
+  }
+
+  std::size_t PendingSendBytes() const {
+    return send_queue ? send_queue->PendingBytes() : 0;
+  }
+};
+
+// Fields read on accept, event delivery and expiry only.
+struct ConnInfo {
+  std::uint32_t remote_addr;
   std::uint16_t remote_port;
+  std::uint32_t idle_timer;
+  std::uint64_t accepted_ms;
   std::uint64_t last_active_ms;
 };
 
+// Connections indexed directly by fd in fixed-size pages, so lookups are two
+// loads, growth never moves existing entries and there is no per-connection
+// node allocation. Each slot keeps a generation that is bumped on reuse.
 class TcpConnTable {
  public:
-  bool Add(const Conn& conn);
+  TcpConnTable();
+  ~TcpConnTable();
+
+  // Claims the slot of fd with a new generation. Returns nullptr if the slot
+  // is still live.
+  Conn* Add(int fd);
   void Remove(int fd);
   Conn* Find(int fd);
+  // Returns nullptr unless fd is live and still has the given generation.
+  Conn* Find(int fd, std::uint32_t generation);
+  ConnInfo& Info(int fd);
+
+  std::size_t Size() const {
+    return size_;
+  }
+
+  // Bytes held by the slab itself, excluding lazily allocated buffers.
+  std::size_t MemoryUsage() const;
 
  private:
-  std::unordered_map<int, Conn> conns_;
+  static constexpr std::size_t kPageBits = 10;
+  static constexpr std::size_t kPageSize = std::size_t(1) << kPageBits;
+
+  struct Page {
+    Conn conns[kPageSize];
+    ConnInfo infos[kPageSize];
+  };
+
+  std::vector<std::unique_ptr<Page>> pages_;
+  std::size_t page_count_;
+  std::size_t size_;
 };
 
 struct UdpSession {
-  std::string remote_ip;
+  // IPv4 address in network byte order, port in host byte order.
+  std::uint32_t remote_addr;
   std::uint16_t remote_port;
   std::uint64_t id;
   ProtocolType protocol;
   std::uint64_t last_active_ms;
 };
 
-class UdpSessionTable {
- public:
-  UdpSession* FindOrCreate(const std::string& ip,
-                           std::uint16_t port,
-                           ProtocolType protocol,
-                           std::uint64_t now_ms);
-  UdpSession* FindById(std::uint64_t id);
-
- private:
-  std::unordered_map<std::string, UdpSession> sessions_;
-};
-
 struct RtpSession {
   std::uint32_t ssrc;
   std::uint64_t id;
   std::uint64_t last_active_ms;
-};
-
-class RtpSessionTable {
- public:
-  RtpSession* FindOrCreate(std::uint32_t ssrc, std::uint64_t now_ms);
-
- private:
-  std::unordered_map<std::uint32_t, RtpSession> sessions_;
+  // The UDP IO thread that keeps the stream's state.
+  int owner;
 };
 
 }  // namespace backend
@@ -12,6 +12,16 @@ enum class ProtocolType {
   Rtp = 3
 };
 
+enum class EventKind {
+  Message = 0,
+  SendBlocked = 1,
+  SendDrained = 2,
+  Closed = 3,
+  Expired = 4,
+  // A sampled copy of an RTP packet that a forwarding rule already relayed.
+  Forwarded = 5
+};
+
 struct EventContext {
   std::uint64_t timestamp_ms;
   std::string remote_ip;
@@ -20,6 +30,7 @@ struct EventContext {
 
 struct Event {
   ProtocolType protocol;
+  EventKind kind = EventKind::Message;
   std::uint64_t session_id;
   EventContext context;
   std::string payload;
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+namespace backend {
+
+inline void CpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+  asm volatile("yield");
+#endif
+}
+
+// eventfd-backed wakeup for a single consumer thread. The consumer marks
+// itself parked before it blocks; producers only write the eventfd when they
+// find it parked, so a busy consumer costs producers one load and the first
+// push into an idle consumer's queues costs one write.
+class EventNotifier {
+ public:
+  EventNotifier();
+  ~EventNotifier();
+
+  EventNotifier(const EventNotifier&) = delete;
+  EventNotifier& operator=(const EventNotifier&) = delete;
+
+  int Fd() const {
+    return fd_;
+  }
+
+  // Producer side, called after an item has been published.
+  void Notify() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (parked_.load(std::memory_order_relaxed) &&
+        parked_.exchange(false, std::memory_order_acq_rel)) {
+      Signal();
+    }
+  }
+
+  // Wakes the consumer whether or not it is parked.
+  void Signal();
+
+  // Consumer side, for threads that block elsewhere (for example in
+  // epoll_wait with Fd() registered): Park() before blocking, Unpark() after.
+  void Park() {
+    parked_.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+  }
+
+  void Unpark() {
+    parked_.store(false, std::memory_order_relaxed);
+  }
+
+  // Consumer side: calls try_work up to spin_iterations times, then parks
+  // until a producer signals or timeout_ms elapses. Returns true when
+  // try_work reported work.
+  template <typename TryWork>
+  bool Await(TryWork&& try_work, int spin_iterations, int timeout_ms) {
+    for (int i = 0; i < spin_iterations; ++i) {
+      if (try_work()) {
+        return true;
+      }
+      CpuRelax();
+    }
+    Park();
+    if (try_work()) {
+      Unpark();
+      return true;
+    }
+    Wait(timeout_ms);
+    Unpark();
+    return try_work();
+  }
+
+  // Blocks until the eventfd is readable or timeout_ms elapses, then resets it.
+  void Wait(int timeout_ms);
+  // Resets the eventfd counter without blocking.
+  void Drain();
+
+ private:
+  int fd_;
+  std::atomic<bool> parked_;
+};
+
+}  // namespace backend
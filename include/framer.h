@@ -0,0 +1,27 @@
+#pragma once
+
+#include "event.h"
+#include "protocol.h"
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace backend {
+
+// Splits a TCP byte stream into messages with a ProtocolHandler, parsing them
+// in place over the connection's receive buffer.
+class Framer {
+ public:
+  explicit Framer(std::shared_ptr<ProtocolHandler> handler);
+
+  // Appends one event per complete message at the start of data to out.
+  // Returns how many bytes those messages span, leaving the rest for the next
+  // read, or ProtocolHandler::kFrameError if the stream cannot be framed.
+  std::size_t Feed(const char* data, std::size_t length, std::vector<Event>& out);
+
+ private:
+  std::shared_ptr<ProtocolHandler> handler_;
+};
+
+}  // namespace backend
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace backend {
+
+// Counters owned by one IO thread. The owner is the only writer, so updates
+// are a relaxed load and store instead of a locked read-modify-write.
+inline void AddCounter(std::atomic<std::uint64_t>& counter, std::uint64_t delta) {
+  counter.store(counter.load(std::memory_order_relaxed) + delta,
+                std::memory_order_relaxed);
+}
+
+struct TcpIoCounters {
+  std::atomic<std::uint64_t> accepted{0};
+  std::atomic<std::uint64_t> send_messages{0};
+  std::atomic<std::uint64_t> send_syscalls{0};
+  std::atomic<std::uint64_t> received_messages{0};
+  // Every syscall the thread made for socket IO and waiting, whichever backend.
+  std::atomic<std::uint64_t> io_syscalls{0};
+};
+
+struct UdpIoCounters {
+  std::atomic<std::uint64_t> received_datagrams{0};
+  std::atomic<std::uint64_t> recv_syscalls{0};
+  std::atomic<std::uint64_t> sent_datagrams{0};
+  std::atomic<std::uint64_t> send_syscalls{0};
+  // Datagrams longer than udp_max_datagram_size, dropped on receive.
+  std::atomic<std::uint64_t> truncated_datagrams{0};
+  // Kernel buffers behind those datagrams: one per datagram, or one per GRO
+  // buffer and UDP_SEGMENT run with offload.
+  std::atomic<std::uint64_t> recv_buffers{0};
+  std::atomic<std::uint64_t> send_buffers{0};
+  // Datagrams the kernel refused or had no buffer space for.
+  std::atomic<std::uint64_t> send_drops{0};
+  // RTP packets relayed by Lua-installed rules, counted per target.
+  std::atomic<std::uint64_t> forwarded_rtp{0};
+  // Compound RTCP packets handled in C++, and receiver reports sent.
+  std::atomic<std::uint64_t> rtcp_packets{0};
+  std::atomic<std::uint64_t> rtcp_reports{0};
+  // Recording tasks dropped because the disk queue was full.
+  std::atomic<std::uint64_t> recording_drops{0};
+  // Recorded RTP packets played back by the replay thread.
+  std::atomic<std::uint64_t> replayed_rtp{0};
+};
+
+struct UdpIoStats {
+  std::uint64_t received_datagrams;
+  std::uint64_t recv_syscalls;
+  std::uint64_t sent_datagrams;
+  std::uint64_t send_syscalls;
+  std::uint64_t truncated_datagrams;
+  std::uint64_t recv_buffers;
+  std::uint64_t send_buffers;
+  std::uint64_t send_drops;
+  std::uint64_t forwarded_rtp;
+  std::uint64_t rtcp_packets;
+  std::uint64_t rtcp_reports;
+  std::uint64_t replayed_rtp;
+};
+
+// Owned by the recorder of one disk thread.
+struct RecorderCounters {
+  std::atomic<std::uint64_t> records{0};
+  std::atomic<std::uint64_t> appended_bytes{0};
+  std::atomic<std::uint64_t> written_bytes{0};
+  std::atomic<std::uint64_t> write_calls{0};
+  std::atomic<std::uint64_t> opens{0};
+  std::atomic<std::uint64_t> closes{0};
+  // Closes forced by the open-file limit.
+  std::atomic<std::uint64_t> evictions{0};
+  // Records lost to open or write failures.
+  std::atomic<std::uint64_t> dropped_records{0};
+  // Recording segments completed, and those deleted to keep their
+  // directory within the retention budget.
+  std::atomic<std::uint64_t> sealed_segments{0};
+  std::atomic<std::uint64_t> expired_segments{0};
+  std::atomic<std::uint64_t> expired_bytes{0};
+};
+
+struct RecorderStats {
+  std::uint64_t records;
+  std::uint64_t appended_bytes;
+  std::uint64_t written_bytes;
+  std::uint64_t write_calls;
+  std::uint64_t opens;
+  std::uint64_t closes;
+  std::uint64_t evictions;
+  // Lost to open or write failures, plus recording tasks the IO threads
+  // could not queue.
+  std::uint64_t dropped_records;
+  std::uint64_t sealed_segments;
+  std::uint64_t expired_segments;
+  std::uint64_t expired_bytes;
+
+  // File system calls (open, write, close) per record. Opening, writing and
+  // closing the file for every record costs 3.
+  double WriteAmplification() const {
+    if (records == 0) {
+      return 0.0;
+    }
+    return static_cast<double>(opens + write_calls + closes) / static_cast<double>(records);
+  }
+};
+
+// Shared by every IO thread assigning connections to the worker and by the
+// worker itself, so connections is updated with atomic read-modify-writes.
+struct WorkerCounters {
+  std::atomic<std::uint64_t> connections{0};
+  std::atomic<std::uint64_t> events{0};
+};
+
+struct WorkerStats {
+  std::uint64_t connections;
+  std::uint64_t events;
+};
+
+struct TcpIoStats {
+  std::uint64_t accepted;
+  std::uint64_t send_messages;
+  std::uint64_t send_syscalls;
+  std::uint64_t received_messages;
+  std::uint64_t io_syscalls;
+
+  double SendSyscallsPerMessage() const {
+    if (send_messages == 0) {
+      return 0.0;
+    }
+    return static_cast<double>(send_syscalls) / static_cast<double>(send_messages);
+  }
+
+  double IoSyscallsPerMessage() const {
+    std::uint64_t messages = received_messages + send_messages;
+    if (messages == 0) {
+      return 0.0;
+    }
+    return static_cast<double>(io_syscalls) / static_cast<double>(messages);
+  }
+};
+
+}  // namespace backend
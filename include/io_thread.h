@@ -0,0 +1,62 @@
+#pragma once
+
+#include "app_config.h"
+#include "event.h"
+#include "mpsc_queue.h"
+#include "uring_reactor.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <netinet/in.h>
+
+namespace backend {
+
+// Pieces the TCP and UDP IO threads and their epoll and io_uring backends
+// share with the rest of the runtime.
+
+constexpr int kParkTimeoutMs = 1000;
+constexpr std::uint64_t kIdleWheelTickMs = 100;
+constexpr int kBackpressurePollMs = 1;
+// Recording directories, each with its own retention budget.
+constexpr char kRtpRecordingDir[] = "rtp";
+constexpr char kUdpRecordingDir[] = "recordings";
+
+std::uint64_t NowMs();
+std::uint64_t NowUs();
+// Wall-clock time, for recordings that are searched by time of day.
+std::uint64_t WallMs();
+
+std::string IpFromSockaddr(const sockaddr_in& addr);
+std::string IpFromAddress(std::uint32_t address);
+
+// Hands every worker its batch. Events a full queue did not take stay in
+// pending; returns true if any are left.
+bool FlushPendingEvents(std::vector<std::vector<Event>>& pending,
+                        std::vector<std::unique_ptr<MpscQueue<Event>>>& queues);
+
+enum class UringOp : std::uint64_t {
+  Accept = 1,
+  Recv = 2,
+  Send = 3,
+  Notify = 4,
+  Cancel = 5
+};
+
+// io_uring user_data: the operation in bits 56-63, the connection generation
+// in bits 32-55 and the fd in bits 0-31, so a completion finds its
+// connection without a lookup table.
+std::uint64_t UringData(UringOp op, int fd, std::uint32_t generation = 0);
+UringOp UringDataOp(std::uint64_t user_data);
+int UringDataFd(std::uint64_t user_data);
+std::uint32_t UringDataGeneration(std::uint64_t user_data);
+
+// A ring for an IO thread when io_uring is configured and usable, null
+// otherwise so the thread falls back to epoll.
+std::unique_ptr<UringReactor> MakeUringReactor(const AppConfig& config, const char* kind,
+                                               int index, unsigned buffer_count,
+                                               unsigned buffer_size);
+
+}  // namespace backend
@@ -2,9 +2,11 @@
 
 #include "event.h"
 #include "mpsc_queue.h"
+#include "rtp_forward_table.h"
 #include "tasks.h"
 
 #include <string>
+#include <vector>
 
 struct lua_State;
 
@@ -13,9 +15,12 @@ namespace backend {
 class LuaVm {
  public:
   LuaVm(const std::string& script_path,
-        MpscQueue<GenericTask>* to_io,
+        std::vector<MpscQueue<GenericTask>*> to_tcp_io,
+        std::vector<MpscQueue<GenericTask>*> to_udp_io,
         MpscQueue<DiskTask>* to_disk,
         MpscQueue<LogTask>* to_log,
+        MpscQueue<ReplayTask>* to_replay,
+        RtpForwardTable* rtp_forwards,
         int worker_index);
   ~LuaVm();
 
@@ -28,6 +33,11 @@ class LuaVm {
   static void PushEvent(lua_State* state, const Event& event);
   static int Lua_SendTcp(lua_State* state);
   static int Lua_SendUdp(lua_State* state);
+  static int Lua_AddRtpForward(lua_State* state);
+  static int Lua_AddRtpForwardAddr(lua_State* state);
+  static int Lua_RemoveRtpForward(lua_State* state);
+  static int Lua_ReplayRtp(lua_State* state);
+  static int Lua_ReplayRtpAddr(lua_State* state);
   static int Lua_PostDiskTask(lua_State* state);
   static int Lua_CallExternalService(lua_State* state);
   static int Lua_Log(lua_State* state);
@@ -36,9 +46,12 @@ class LuaVm {
 
   std::string script_path_;
   lua_State* state_;
-  MpscQueue<GenericTask>* to_io_;
+  std::vector<MpscQueue<GenericTask>*> to_tcp_io_;
+  std::vector<MpscQueue<GenericTask>*> to_udp_io_;
   MpscQueue<DiskTask>* to_disk_;
   MpscQueue<LogTask>* to_log_;
+  MpscQueue<ReplayTask>* to_replay_;
+  RtpForwardTable* rtp_forwards_;
   int worker_index_;
 };
 
@@ -1,21 +1,44 @@
 #pragma once
 
+#include "event_notifier.h"
+
 #include <atomic>
 #include <cstddef>
+#include <cstdint>
 #include <memory>
 #include <utility>
-#include <vector>
 
 namespace backend {
 
+constexpr std::size_t kCacheLineSize = 64;
+
+// Bounded lock-free multi-producer single-consumer ring.
+// Every slot carries a sequence number: producers claim a position with one
+// CAS on head_ and publish the slot by bumping its sequence, so producers only
+// contend on head_ and never wait on each other's copies. The capacity is
+// rounded up to a power of two so indices are masked instead of divided.
 template <typename T>
 class MpscQueue {
  public:
   explicit MpscQueue(std::size_t capacity)
-      : buffer_(capacity),
-        capacity_(capacity),
-        head_(0),
-        tail_(0) {
+      : capacity_(RoundUpPowerOfTwo(capacity)),
+        mask_(capacity_ - 1),
+        slots_(new Slot[capacity_]) {
+    for (std::size_t i = 0; i < capacity_; ++i) {
+      slots_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    head_.store(0, std::memory_order_relaxed);
+    tail_ = 0;
+    consumed_.store(0, std::memory_order_relaxed);
+  }
+
+  MpscQueue(const MpscQueue&) = delete;
+  MpscQueue& operator=(const MpscQueue&) = delete;
+
+  // Enables the waitable mode: every successful push notifies the consumer
+  // parked on notifier. One notifier may serve several queues.
+  void SetNotifier(EventNotifier* notifier) {
+    notifier_ = notifier;
   }
 
   bool Push(const T& value) {
@@ -27,40 +50,149 @@ class MpscQueue {
   }
 
   bool Pop(T& out) {
-    std::size_t head = head_.load(std::memory_order_acquire);
-    if (tail_ == head) {
+    Slot& slot = slots_[tail_ & mask_];
+    std::size_t sequence = slot.sequence.load(std::memory_order_acquire);
+    if (sequence != tail_ + 1) {
       return false;
     }
-    std::size_t index = tail_ % capacity_;
-    out = std::move(buffer_[index]);
+    out = std::move(slot.value);
+    slot.sequence.store(tail_ + capacity_, std::memory_order_release);
     ++tail_;
+    consumed_.store(tail_, std::memory_order_relaxed);
     return true;
   }
 
+  // Moves up to count items into the queue with a single claim on head_.
+  // Returns how many were accepted; items past that count are left untouched.
+  std::size_t PushBatch(T* items, std::size_t count) {
+    if (count == 0) {
+      return 0;
+    }
+    std::size_t position = head_.load(std::memory_order_relaxed);
+    std::size_t claimed = 0;
+    while (true) {
+      std::size_t sequence =
+          slots_[position & mask_].sequence.load(std::memory_order_acquire);
+      std::intptr_t diff =
+          static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(position);
+      if (diff < 0) {
+        return 0;
+      }
+      if (diff > 0) {
+        position = head_.load(std::memory_order_relaxed);
+        continue;
+      }
+      // The consumer frees slots in order, so if the last slot of the run is
+      // free for this lap every slot before it is free as well.
+      claimed = count < capacity_ ? count : capacity_;
+      while (claimed > 1) {
+        std::size_t last = position + claimed - 1;
+        if (slots_[last & mask_].sequence.load(std::memory_order_acquire) == last) {
+          break;
+        }
+        claimed >>= 1;
+      }
+      if (head_.compare_exchange_weak(position, position + claimed,
+                                      std::memory_order_relaxed)) {
+        break;
+      }
+    }
+    for (std::size_t i = 0; i < claimed; ++i) {
+      Slot& slot = slots_[(position + i) & mask_];
+      slot.value = std::move(items[i]);
+      slot.sequence.store(position + i + 1, std::memory_order_release);
+    }
+    if (notifier_ != nullptr) {
+      notifier_->Notify();
+    }
+    return claimed;
+  }
+
+  // Moves up to max_count ready items into out and advances the consumer
+  // index once. Returns the number of items written.
+  std::size_t PopBatch(T* out, std::size_t max_count) {
+    std::size_t count = 0;
+    while (count < max_count) {
+      std::size_t position = tail_ + count;
+      Slot& slot = slots_[position & mask_];
+      if (slot.sequence.load(std::memory_order_acquire) != position + 1) {
+        break;
+      }
+      out[count] = std::move(slot.value);
+      slot.sequence.store(position + capacity_, std::memory_order_release);
+      ++count;
+    }
+    tail_ += count;
+    consumed_.store(tail_, std::memory_order_relaxed);
+    return count;
+  }
+
+  // Consumer side only.
+  bool Empty() const {
+    return slots_[tail_ & mask_].sequence.load(std::memory_order_acquire) != tail_ + 1;
+  }
+
+  // Approximate number of queued items, callable from any thread. Used for
+  // backpressure decisions, not for correctness.
+  std::size_t Size() const {
+    std::size_t head = head_.load(std::memory_order_relaxed);
+    std::size_t consumed = consumed_.load(std::memory_order_relaxed);
+    return head > consumed ? head - consumed : 0;
+  }
+
+  std::size_t Capacity() const {
+    return capacity_;
+  }
+
  private:
+  struct Slot {
+    std::atomic<std::size_t> sequence;
+    T value;
+  };
+
+  static std::size_t RoundUpPowerOfTwo(std::size_t value) {
+    std::size_t result = 2;
+    while (result < value) {
+      result <<= 1;
+    }
+    return result;
+  }
+
   template <typename U>
   bool Enqueue(U&& value) {
-    while (lock_.test_and_set(std::memory_order_acquire)) {
+    std::size_t position = head_.load(std::memory_order_relaxed);
+    Slot* slot = nullptr;
+    while (true) {
+      slot = &slots_[position & mask_];
+      std::size_t sequence = slot->sequence.load(std::memory_order_acquire);
+      std::intptr_t diff =
+          static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(position);
+      if (diff == 0) {
+        if (head_.compare_exchange_weak(position, position + 1,
+                                        std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        position = head_.load(std::memory_order_relaxed);
+      }
     }
-    std::size_t head = head_.load(std::memory_order_relaxed);
-    std::size_t used = head - tail_;
-    if (used >= capacity_) {
-      lock_.clear(std::memory_order_release);
-      return false;
+    slot->value = std::forward<U>(value);
+    slot->sequence.store(position + 1, std::memory_order_release);
+    if (notifier_ != nullptr) {
+      notifier_->Notify();
     }
-    std::size_t index = head % capacity_;
-    buffer_[index] = std::forward<U>(value);
-    head_.store(head + 1, std::memory_order_release);
-    lock_.clear(std::memory_order_release);
     return true;
   }
 
-  std::vector<T> buffer_;
   const std::size_t capacity_;
-  std::atomic<std::size_t> head_;
-  std::size_t tail_;
-  std::atomic_flag lock_ = ATOMIC_FLAG_INIT;
+  const std::size_t mask_;
+  std::unique_ptr<Slot[]> slots_;
+  EventNotifier* notifier_ = nullptr;
+  alignas(kCacheLineSize) std::atomic<std::size_t> head_;
+  alignas(kCacheLineSize) std::size_t tail_;
+  std::atomic<std::size_t> consumed_;
 };
 
 }  // namespace backend
-
@@ -4,17 +4,67 @@
 
 #include <cstddef>
 #include <memory>
+#include <string>
 
 namespace backend {
 
+// Handlers are shared by every IO thread and must not keep per-connection
+// state; the framing engine keeps unfinished bytes for them.
 class ProtocolHandler {
  public:
+  static constexpr std::size_t kFrameError = static_cast<std::size_t>(-1);
+
   virtual ~ProtocolHandler() = default;
 
+  // Returns how many bytes the first message in data spans, 0 if it is not
+  // complete yet, or kFrameError if the stream cannot be framed. The default
+  // treats everything read so far as one message.
+  virtual std::size_t Frame(const char* /*data*/, std::size_t length) {
+    return length;
+  }
+
+  // Fills out_event from one message framed by Frame. Returning false drops
+  // the message.
   virtual bool Parse(const char* data, std::size_t length, Event& out_event) = 0;
   virtual bool Encode(const Event& event, std::string& out_bytes) = 0;
 };
 
+// Passes bytes through as they arrive.
+class RawHandler : public ProtocolHandler {
+ public:
+  bool Parse(const char* data, std::size_t length, Event& out_event) override;
+  bool Encode(const Event& event, std::string& out_bytes) override;
+};
+
+// Messages carry a big-endian length of header_bytes (1, 2 or 4) in front of
+// the payload.
+class LengthPrefixHandler : public ProtocolHandler {
+ public:
+  LengthPrefixHandler(int header_bytes, std::size_t max_message_size);
+
+  std::size_t Frame(const char* data, std::size_t length) override;
+  bool Parse(const char* data, std::size_t length, Event& out_event) override;
+  bool Encode(const Event& event, std::string& out_bytes) override;
+
+ private:
+  std::size_t header_bytes_;
+  std::size_t max_message_size_;
+};
+
+// Messages end with delimiter, which is not part of the payload.
+class DelimiterHandler : public ProtocolHandler {
+ public:
+  DelimiterHandler(std::string delimiter, std::size_t max_message_size);
+
+  std::size_t Frame(const char* data, std::size_t length) override;
+  bool Parse(const char* data, std::size_t length, Event& out_event) override;
+  bool Encode(const Event& event, std::string& out_bytes) override;
+
+ private:
+  std::string delimiter_;
+  std::size_t max_message_size_;
+};
+
 class ProtocolRegistry {
  public:
   static ProtocolRegistry& Instance();
@@ -22,6 +72,10 @@ class ProtocolRegistry {
   void RegisterHandler(ProtocolType type, std::shared_ptr<ProtocolHandler> handler);
   std::shared_ptr<ProtocolHandler> GetHandler(ProtocolType type) const;
 
+  // Named handlers are what listeners select with their framing setting.
+  void RegisterHandler(const std::string& name, std::shared_ptr<ProtocolHandler> handler);
+  std::shared_ptr<ProtocolHandler> GetHandler(const std::string& name) const;
+
  private:
   ProtocolRegistry() = default;
   ProtocolRegistry(const ProtocolRegistry&) = delete;
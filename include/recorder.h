@@ -0,0 +1,81 @@
+#pragma once
+
+#include "io_stats.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <unordered_map>
+
+namespace backend {
+
+// Appends records to files for one disk thread. Descriptors stay open in an
+// LRU bounded by max_open_files, and each open file collects appends in an
+// aligned block that is written when the next record does not fit or once
+// it has waited flush_interval_ms. A record is never split across writes,
+// so appends from other threads to the same O_APPEND file cannot land in
+// the middle of one. Not thread-safe: every file belongs to one disk thread.
+class Recorder {
+ public:
+  Recorder(std::size_t max_open_files, std::size_t block_size, std::uint64_t flush_interval_ms,
+           RecorderCounters* counters);
+  ~Recorder();
+  Recorder(const Recorder&) = delete;
+  Recorder& operator=(const Recorder&) = delete;
+
+  // Returns false if the record is dropped because the file cannot be
+  // opened or written. A file opened by this append gets disk preallocated
+  // a chunk ahead of its writes, up to reserve_bytes in all.
+  bool Append(const std::string& path, const char* data, std::size_t len, std::uint64_t now_ms,
+              std::uint64_t reserve_bytes = 0);
+
+  // Writes the blocks that have waited flush_interval_ms.
+  void FlushDue(std::uint64_t now_ms);
+
+  // Writes out and closes path, so it can be written by other means.
+  void Close(const std::string& path);
+
+  void CloseAll();
+
+  std::size_t OpenFiles() const {
+    return files_.size();
+  }
+
+ private:
+  struct File {
+    std::string path;
+    int fd = -1;
+    char* block = nullptr;
+    std::size_t used = 0;
+    std::size_t records = 0;
+    std::uint64_t dirty_since_ms = 0;
+    // Bytes in the file, where its preallocation ends, and how far it may go.
+    std::uint64_t size = 0;
+    std::uint64_t reserved = 0;
+    std::uint64_t reserve_limit = 0;
+  };
+
+  using FileList = std::list<File>;
+
+  FileList::iterator Open(const std::string& path, std::uint64_t reserve_bytes);
+  // Writes the block; records in it are counted as dropped on failure.
+  bool Flush(File& file);
+  bool WriteAll(File& file, const char* data, std::size_t len);
+  // Preallocates the next chunk once the writes come within a block of
+  // the end of the last one.
+  void Reserve(File& file);
+  void Release(FileList::iterator it);
+
+  std::size_t max_open_files_;
+  std::size_t block_size_;
+  std::uint64_t flush_interval_ms_;
+  RecorderCounters* counters_;
+  // No block is due before this, so FlushDue is cheap between deadlines.
+  std::uint64_t next_due_ms_;
+  // Most recently used first.
+  FileList files_;
+  std::unordered_map<std::string, FileList::iterator> by_path_;
+};
+
+}  // namespace backend
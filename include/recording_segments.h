@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace backend {
+
+// A segment is written under its final name plus this suffix and renamed
+// once complete, so every file without it holds a whole segment.
+constexpr char kSegmentPartSuffix[] = ".part";
+
+// Decides where one recording is cut into segments. A segment ends before
+// the record that would take it past max_bytes, or before the first record
+// once it has spanned max_ms; 0 lifts either limit. Offsets are positions
+// in the whole recording, so reservations made elsewhere place as they are.
+class RecordingSegmenter {
+ public:
+  RecordingSegmenter(std::uint64_t max_bytes, std::uint64_t max_ms);
+
+  // Places a record of len bytes at offset. Returns true when it starts a
+  // segment, the first one included.
+  bool Place(std::uint64_t offset, std::uint64_t len, std::uint64_t now_ms);
+
+  bool Started() const {
+    return started_;
+  }
+
+  // Number of the current segment, from 0.
+  std::uint64_t Segment() const {
+    return segment_;
+  }
+
+  // Where the last placed record starts within its segment.
+  std::uint64_t SegmentOffset() const {
+    return last_ - base_;
+  }
+
+ private:
+  std::uint64_t max_bytes_;
+  std::uint64_t max_ms_;
+  bool started_;
+  std::uint64_t segment_;
+  std::uint64_t base_;
+  std::uint64_t last_;
+  std::uint64_t start_ms_;
+};
+
+// prefix_<segment>_<wall ms at its start>, for example
+// rtp/session_3_000002_1760000000000. The time keeps names unique across
+// restarts, which reuse session ids.
+std::string SegmentName(const std::string& prefix, std::uint64_t segment, std::uint64_t wall_ms);
+
+// Completes the segment being written at part_path: frees the preallocated
+// space past its end and renames it without kSegmentPartSuffix.
+bool SealSegment(const std::string& part_path);
+
+// Seals the segments an earlier run left unfinished in dir and returns how
+// many there were.
+std::size_t SealLeftoverSegments(const std::string& dir);
+
+// Deletes the oldest sealed segments in dir, every file of a segment
+// together, until the directory takes at most budget_bytes of disk.
+// Unfinished segments count against the budget by the data in them, not
+// the space preallocated for them, and are never deleted.
+// Returns the number of segments deleted; bytes freed go to freed_bytes.
+std::size_t EnforceRetention(const std::string& dir, std::uint64_t budget_bytes,
+                             std::uint64_t* freed_bytes);
+
+}  // namespace backend
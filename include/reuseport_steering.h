@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstdint>
+
+namespace backend {
+
+// Attaches a classic BPF program to a SO_REUSEPORT UDP group that picks the
+// socket from a hash of the source address and port, so every datagram of a
+// peer reaches the same IO thread. Sockets are indexed in the order they
+// joined the group; fd may be any member. Returns false if the kernel
+// rejects the program, in which case it keeps its own flow hash.
+bool AttachReuseportSteering(int fd, int group_size);
+
+// The index the program picks, for an address in network byte order and a
+// port in host byte order.
+int ReuseportSteeringIndex(std::uint32_t remote_addr, std::uint16_t remote_port,
+                           int group_size);
+
+}  // namespace backend
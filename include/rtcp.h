@@ -0,0 +1,90 @@
+#pragma once
+
+#include "rtp_jitter_buffer.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace backend {
+
+// RTCP packet types (RFC 3550 section 12.1).
+constexpr std::uint8_t kRtcpSenderReport = 200;
+constexpr std::uint8_t kRtcpReceiverReport = 201;
+constexpr std::uint8_t kRtcpSourceDescription = 202;
+constexpr std::uint8_t kRtcpBye = 203;
+constexpr std::uint8_t kRtcpApp = 204;
+
+struct RtcpSenderInfo {
+  std::uint64_t ntp_timestamp = 0;
+  std::uint32_t rtp_timestamp = 0;
+  std::uint32_t packet_count = 0;
+  std::uint32_t octet_count = 0;
+};
+
+struct RtcpReportBlock {
+  std::uint32_t ssrc = 0;
+  std::uint8_t fraction_lost = 0;
+  // 24-bit signed on the wire.
+  std::int32_t cumulative_lost = 0;
+  std::uint32_t extended_highest_sequence = 0;
+  std::uint32_t jitter = 0;
+  // Middle 32 bits of the last SR's NTP timestamp, and the delay since it
+  // in units of 1/65536 s.
+  std::uint32_t last_sr = 0;
+  std::uint32_t delay_since_last_sr = 0;
+};
+
+// Everything this server uses from one compound RTCP packet. Reused across
+// packets by the caller, so Clear keeps the vectors' capacity.
+struct RtcpCompound {
+  struct SenderReport {
+    std::uint32_t ssrc;
+    RtcpSenderInfo info;
+  };
+
+  std::vector<SenderReport> sender_reports;
+  // Blocks of every SR and RR, with the SSRC of the report's sender.
+  std::vector<std::pair<std::uint32_t, RtcpReportBlock>> report_blocks;
+  std::vector<std::pair<std::uint32_t, std::string>> cnames;
+  std::vector<std::uint32_t> bye_ssrcs;
+
+  void Clear();
+};
+
+// True for RTCP: version 2 and a packet type from 200 to 204. Those types
+// are never RTP payload types when RTP and RTCP share a port (RFC 5761), so
+// this must be checked before parsing a datagram as RTP.
+bool IsRtcp(const char* data, std::size_t len);
+
+// Parses a compound packet. Fails on a truncated or malformed header, but
+// keeps whatever came before it in out.
+bool ParseRtcp(const char* data, std::size_t len, RtcpCompound& out);
+
+// A report block about a received stream. The priors are the stream's
+// expected and received counts at the previous report, for the fraction
+// lost over the interval (RFC 3550 appendix A.3).
+RtcpReportBlock MakeRtcpReportBlock(std::uint32_t ssrc, const RtpStreamStats& stats,
+                                    std::uint64_t expected_prior,
+                                    std::uint64_t received_prior);
+
+// When the report after one sent at now_ms is due: RFC 3550 spreads reports
+// over 0.5 to 1.5 times the interval. An interval of 0 schedules none.
+std::uint64_t NextRtcpReportMs(std::uint64_t now_ms, std::uint64_t interval_ms,
+                               std::uint32_t random);
+
+// Writes an RR, or an SR when info is given, with up to 31 report blocks.
+// Returns the bytes written, or 0 if out is too small.
+std::size_t BuildRtcpReport(std::uint32_t ssrc, const RtcpSenderInfo* info,
+                            const RtcpReportBlock* blocks, std::size_t block_count,
+                            char* out, std::size_t capacity);
+
+// Writes an SDES packet with one chunk holding the CNAME of ssrc, cut to 255
+// bytes. Every compound packet must carry one (RFC 3550 section 6.1).
+// Returns the bytes written, or 0 if out is too small.
+std::size_t BuildRtcpSdes(std::uint32_t ssrc, const std::string& cname, char* out,
+                          std::size_t capacity);
+
+}  // namespace backend
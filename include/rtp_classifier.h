@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace backend {
+
+struct RtpHeader {
+  std::uint8_t version;
+  bool padding;
+  bool extension;
+  std::uint8_t csrc_count;
+  bool marker;
+  std::uint8_t payload_type;
+  std::uint16_t sequence_number;
+  std::uint32_t timestamp;
+  std::uint32_t ssrc;
+  std::size_t header_length;
+};
+
+// Parses the fixed header, CSRCs and extension of one RTP packet. Also
+// accepts RTCP, so IsRtcp has to be checked first.
+bool ParseRtpHeader(const char* data, std::size_t len, RtpHeader& out);
+
+enum class PacketClass : std::uint8_t {
+  Other = 0,
+  Rtp,
+  Rtcp,
+  Stun,
+};
+
+// STUN magic cookie (RFC 5389), bytes 4 to 7 of every STUN message.
+constexpr std::uint32_t kStunMagicCookie = 0x2112A442;
+
+// Classification of a batch of datagrams, one array per field. The RTP
+// fields are only set where kind is Rtp. Reused across batches by the
+// caller, so Resize keeps the arrays' capacity.
+struct PacketBatch {
+  std::vector<PacketClass> kind;
+  // First header byte: version, padding, extension and CSRC count.
+  std::vector<std::uint8_t> first_byte;
+  std::vector<std::uint8_t> payload_type;
+  std::vector<std::uint8_t> marker;
+  std::vector<std::uint16_t> sequence_number;
+  std::vector<std::uint32_t> timestamp;
+  std::vector<std::uint32_t> ssrc;
+  std::vector<std::uint32_t> header_length;
+
+  void Resize(std::size_t count);
+
+  // Packet i's fields as ParseRtpHeader returns them.
+  RtpHeader Header(std::size_t i) const;
+};
+
+// Classifies one datagram the way ClassifyPackets does. header is filled
+// for RTP.
+PacketClass ClassifyPacket(const char* data, std::size_t len, RtpHeader& header);
+
+// Classifies count datagrams, data[i] of len[i] bytes, as RTCP, RTP, STUN
+// or other, in that order of precedence, and parses the RTP headers. The
+// version, packet type and length checks run over 16 packets at a time.
+void ClassifyPackets(const char* const* data, const std::size_t* len, std::size_t count,
+                     PacketBatch& out);
+
+}  // namespace backend
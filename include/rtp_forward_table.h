@@ -0,0 +1,72 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <shared_mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace backend {
+
+// Where a forwarded RTP packet goes: a UDP session, resolved when the packet
+// is sent so rules die with their session, or a fixed address.
+struct RtpForwardTarget {
+  std::uint64_t session_id;
+  // IPv4 address in network byte order, port in host byte order; used when
+  // session_id is 0.
+  std::uint32_t remote_addr;
+  std::uint16_t remote_port;
+
+  bool operator==(const RtpForwardTarget& other) const {
+    return session_id == other.session_id && remote_addr == other.remote_addr &&
+           remote_port == other.remote_port;
+  }
+};
+
+// Forwarding rules installed by Lua and applied by the UDP IO threads, keyed
+// on SSRC. Rules change rarely and are read for every RTP packet, so the
+// table is sharded behind reader-writer locks like the session directories,
+// and an empty table is skipped without locking. Every sample_every-th
+// packet of a rule is also handed to Lua; 0 hands none.
+class RtpForwardTable {
+ public:
+  explicit RtpForwardTable(std::uint32_t sample_every = 0);
+
+  // Returns false if the target is already installed for ssrc.
+  bool Add(std::uint32_t ssrc, const RtpForwardTarget& target);
+  // Removes every target of ssrc.
+  void Remove(std::uint32_t ssrc);
+  // Drops targets naming session_id from every rule.
+  void RemoveSession(std::uint64_t session_id);
+  // Replaces out with the targets of ssrc and returns false if there are
+  // none. sampled says whether Lua should also see this packet.
+  bool Lookup(std::uint32_t ssrc, std::vector<RtpForwardTarget>& out, bool* sampled);
+
+  std::size_t Size() const {
+    return size_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  static constexpr std::uint32_t kShardCount = 16;
+
+  struct Rule {
+    std::vector<RtpForwardTarget> targets;
+    std::atomic<std::uint64_t> packets{0};
+  };
+
+  struct Shard {
+    mutable std::shared_mutex mutex;
+    std::unordered_map<std::uint32_t, Rule> rules;
+  };
+
+  Shard& ShardOf(std::uint32_t ssrc) {
+    return shards_[(ssrc * 0x9e3779b1u) >> 28];
+  }
+
+  std::uint32_t sample_every_;
+  std::atomic<std::size_t> size_;
+  Shard shards_[kShardCount];
+};
+
+}  // namespace backend
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace backend {
+
+// Binary index of an RTP recording segment, rtp/<segment>.ridx next to the
+// payload file <segment>.bin: one header, then one fixed-width record per packet in
+// recording order. Fields are in host byte order so the file can be mapped
+// and read in place; the header's byte order mark rejects foreign files.
+constexpr char kRtpIndexMagic[8] = {'R', 'T', 'P', 'I', 'D', 'X', '\0', '\0'};
+constexpr std::uint32_t kRtpIndexVersion = 1;
+constexpr std::uint32_t kRtpIndexByteOrder = 0x01020304;
+// A checkpoint is flagged at the first frame that starts this long after
+// the previous one, so playback can start there.
+constexpr std::uint64_t kRtpIndexCheckpointMs = 1000;
+
+// Record flags.
+constexpr std::uint8_t kRtpIndexMarker = 1;
+// First packet of a frame: its RTP timestamp differs from the previous one.
+constexpr std::uint8_t kRtpIndexFrameStart = 2;
+constexpr std::uint8_t kRtpIndexCheckpoint = 4;
+
+struct RtpIndexHeader {
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t byte_order;
+  std::uint32_t header_size;
+  std::uint32_t record_size;
+  std::uint32_t ssrc;
+  std::uint32_t reserved;
+};
+
+struct RtpIndexRecord {
+  // Wall-clock milliseconds when the packet was recorded; 0 when converted
+  // from a text index, which has no time.
+  std::uint64_t wall_ms;
+  // RTP timestamp with its wrap count in the high bits.
+  std::uint64_t extended_timestamp;
+  // Where the packet starts in the .bin file.
+  std::uint64_t offset;
+  std::uint32_t length;
+  std::uint16_t sequence;
+  std::uint8_t payload_type;
+  std::uint8_t flags;
+};
+
+static_assert(sizeof(RtpIndexHeader) == 32, "RtpIndexHeader is a file format");
+static_assert(sizeof(RtpIndexRecord) == 32, "RtpIndexRecord is a file format");
+
+// Unwraps 32-bit RTP timestamps into a count that keeps increasing across
+// wrap-around, starting one cycle up so slightly older ones stay positive.
+class RtpTimestampExtender {
+ public:
+  std::uint64_t Extend(std::uint32_t timestamp);
+
+ private:
+  bool started_ = false;
+  std::uint64_t highest_ = 0;
+};
+
+// Produces the index records of one stream, in recording order.
+class RtpIndexWriter {
+ public:
+  explicit RtpIndexWriter(std::uint32_t ssrc,
+                          std::uint64_t checkpoint_interval_ms = kRtpIndexCheckpointMs);
+
+  // Appends the record of one packet to out. The packet at offset 0 starts
+  // a new recording, so the file header goes in front of it.
+  void Append(std::uint16_t sequence, std::uint32_t timestamp, std::uint8_t payload_type,
+              bool marker, std::uint64_t wall_ms, std::uint64_t offset, std::uint32_t length,
+              std::string& out);
+
+ private:
+  std::uint32_t ssrc_;
+  std::uint64_t checkpoint_interval_ms_;
+  RtpTimestampExtender timestamps_;
+  bool has_previous_;
+  std::uint64_t previous_timestamp_;
+  bool has_checkpoint_;
+  std::uint64_t last_checkpoint_ms_;
+};
+
+// A read-only mapping of a binary index. Records appended after Open are
+// not seen; a record cut short by a concurrent append is ignored.
+class RtpIndexReader {
+ public:
+  RtpIndexReader();
+  ~RtpIndexReader();
+  RtpIndexReader(const RtpIndexReader&) = delete;
+  RtpIndexReader& operator=(const RtpIndexReader&) = delete;
+
+  bool Open(const std::string& path);
+  void Close();
+
+  const RtpIndexHeader& Header() const {
+    return *header_;
+  }
+
+  std::size_t Size() const {
+    return size_;
+  }
+
+  const RtpIndexRecord& Record(std::size_t i) const {
+    return records_[i];
+  }
+
+  // Binary searches, so they assume the key never decreases in recording
+  // order. Wall time always holds for one recording thread; RTP timestamps
+  // hold for audio and for video without B-frames. Both return the first
+  // record at or after the key, or Size().
+  std::size_t SeekWallClock(std::uint64_t wall_ms) const;
+  std::size_t SeekTimestamp(std::uint64_t extended_timestamp) const;
+
+  // The checkpoint at or before record i, for starting playback on a frame
+  // boundary; 0 if there is none.
+  std::size_t CheckpointBefore(std::size_t i) const;
+
+ private:
+  void* map_;
+  std::size_t map_size_;
+  const RtpIndexHeader* header_;
+  const RtpIndexRecord* records_;
+  std::size_t size_;
+};
+
+// Rewrites a text index of "seq ts ssrc offset length" lines, as recorded
+// before the binary format, into a binary one.
+bool ConvertRtpTextIndex(const std::string& text_path, const std::string& binary_path);
+
+}  // namespace backend
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace backend {
+
+// Reception statistics of one SSRC, following RFC 3550 appendix A.
+struct RtpStreamStats {
+  // Packets that arrived, duplicates included.
+  std::uint64_t received = 0;
+  // Extended highest sequence number minus the first one, plus one.
+  std::uint64_t expected = 0;
+  // expected - received; negative when duplicates outnumber losses.
+  std::int64_t lost = 0;
+  // Arrived after a packet with a higher sequence number.
+  std::uint64_t reordered = 0;
+  // Dropped by the buffer: already released past, or held twice.
+  std::uint64_t late = 0;
+  std::uint64_t duplicates = 0;
+  // Sequence numbers released over because they never arrived in time.
+  std::uint64_t skipped = 0;
+  // Dropped for jumping too far from the highest sequence number.
+  std::uint64_t rejected = 0;
+  // Times the sequence was restarted after such a jump was confirmed.
+  std::uint64_t resyncs = 0;
+  // Cycle count in the high 16 bits, as carried in RTCP reports.
+  std::uint32_t extended_max_sequence = 0;
+  // Interarrival jitter in timestamp units.
+  double jitter = 0.0;
+};
+
+// Tracks one RTP stream and, with a non-zero depth, puts it back in sequence
+// order. Every packet is tracked in arrival order for the statistics; held
+// packets are released once they are next in sequence or have waited
+// depth_ms for the ones before them, which are then counted as skipped.
+// Held payloads live in a fixed ring of slots whose strings keep their
+// capacity, so a steady stream does not allocate.
+//
+// Sequence numbers are validated as in RFC 3550 A.1: a packet more than
+// kMaxDropout ahead or kMaxMisorder behind is rejected, unless the next one
+// follows it, which is taken as the sender restarting its sequence.
+class RtpJitterBuffer {
+ public:
+  static constexpr std::uint16_t kMaxDropout = 3000;
+  static constexpr std::uint16_t kMaxMisorder = 100;
+  // Returned by Track for a packet to drop.
+  static constexpr std::uint64_t kRejected = 0;
+
+  RtpJitterBuffer(std::uint64_t depth_ms, std::uint32_t clock_rate);
+
+  std::uint64_t DepthMs() const {
+    return depth_ms_;
+  }
+
+  // Updates the statistics and returns the extended sequence number, or
+  // kRejected.
+  std::uint64_t Track(std::uint16_t sequence, std::uint32_t timestamp,
+                      std::uint64_t arrival_ms);
+
+  // Holds a tracked packet until its turn; needs a non-zero depth. tag is
+  // handed back on release. Returns false if the packet is a duplicate or
+  // its turn has passed.
+  bool Hold(std::uint64_t extended_sequence, std::uint64_t arrival_ms, const char* data,
+            std::size_t len, std::uint32_t tag = 0);
+
+  // Calls emit(data, len, extended_sequence, tag) for every releasable
+  // packet, in sequence order.
+  template <typename Emit>
+  void Release(std::uint64_t now_ms, Emit&& emit);
+
+  // When the oldest held packet is due; UINT64_MAX if nothing is held.
+  std::uint64_t NextDueMs() const;
+
+  std::size_t Held() const {
+    return held_;
+  }
+
+  const RtpStreamStats& Stats() const {
+    return stats_;
+  }
+
+ private:
+  static constexpr std::size_t kSlotBits = 10;
+  static constexpr std::size_t kSlotCount = std::size_t(1) << kSlotBits;
+
+  struct Slot {
+    bool filled = false;
+    std::uint64_t extended_sequence = 0;
+    std::uint64_t arrival_ms = 0;
+    std::uint32_t tag = 0;
+    std::string data;
+  };
+
+  Slot& SlotOf(std::uint64_t extended_sequence) {
+    return slots_[extended_sequence & (kSlotCount - 1)];
+  }
+
+  // Starts over at sequence, dropping whatever is held.
+  void Restart(std::uint16_t sequence);
+
+  // The lowest held sequence number and the earliest arrival among the
+  // held packets. Only called with something held.
+  void ScanHeld(std::uint64_t* lowest, std::uint64_t* earliest_arrival_ms) const;
+
+  std::uint64_t depth_ms_;
+  std::uint32_t clock_rate_;
+  bool started_;
+  std::uint64_t base_;
+  std::uint64_t highest_;
+  std::uint32_t last_transit_;
+  // The sequence number that confirms a jump, or above 0xFFFF for none.
+  std::uint32_t bad_sequence_;
+  std::uint64_t next_out_;
+  std::uint64_t held_highest_;
+  std::size_t held_;
+  std::vector<Slot> slots_;
+  RtpStreamStats stats_;
+};
+
+template <typename Emit>
+void RtpJitterBuffer::Release(std::uint64_t now_ms, Emit&& emit) {
+  while (held_ > 0) {
+    Slot& slot = SlotOf(next_out_);
+    if (!slot.filled || slot.extended_sequence != next_out_) {
+      // A gap: wait until some packet behind it has been held for the depth.
+      std::uint64_t lowest = 0;
+      std::uint64_t earliest_arrival_ms = 0;
+      ScanHeld(&lowest, &earliest_arrival_ms);
+      if (earliest_arrival_ms + depth_ms_ > now_ms) {
+        return;
+      }
+      stats_.skipped += lowest - next_out_;
+      next_out_ = lowest;
+      continue;
+    }
+    slot.filled = false;
+    --held_;
+    emit(slot.data.data(), slot.data.size(), slot.extended_sequence, slot.tag);
+    ++next_out_;
+  }
+}
+
+}  // namespace backend
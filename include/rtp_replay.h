@@ -0,0 +1,87 @@
+#pragma once
+
+#include "rtp_index.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+namespace backend {
+
+// Fastest replay to the peer of a UDP session. Anyone who can reach the
+// port can ask for one, so unpaced and faster playback is only for
+// addresses the script names itself.
+constexpr double kMaxSessionReplaySpeed = 8.0;
+
+// Plays one recorded RTP segment, <segment>.bin with its <segment>.ridx,
+// back over UDP. Both files are mapped and packets go out straight from the
+// mapping in sendmmsg batches. A packet is due once the span from the first
+// packet's RTP timestamp to its own, divided by the speed, has elapsed, so
+// packets of one video frame leave together. Not thread-safe.
+class RtpReplay {
+ public:
+  RtpReplay();
+  ~RtpReplay();
+  RtpReplay(const RtpReplay&) = delete;
+  RtpReplay& operator=(const RtpReplay&) = delete;
+
+  // recording is the path without extension, for example
+  // rtp/session_3_000000_1760000000000.
+  bool Open(const std::string& recording);
+  void Close();
+
+  // Starts playback at the checkpoint before skip_ms into the recording.
+  // A speed of 2 plays twice as fast; 0 sends without pacing.
+  void Start(std::uint64_t now_us, double speed, std::uint32_t clock_rate,
+             std::uint64_t skip_ms = 0);
+
+  // Packets recorded after Open, or cut short in the payload file, are not
+  // played.
+  bool Done() const {
+    return next_ >= end_;
+  }
+
+  std::uint64_t NextDueUs() const;
+
+  // Sends the packets due by now_us to `to`, at most batch_size per
+  // sendmmsg. Stops early when the socket buffer is full; the rest go out
+  // on a later call. Returns the number of packets sent.
+  std::size_t SendDue(int fd, const sockaddr_in& to, std::uint64_t now_us,
+                      std::size_t batch_size);
+
+  std::size_t Packets() const {
+    return end_;
+  }
+
+  std::size_t Sent() const {
+    return sent_;
+  }
+
+  std::uint64_t SendCalls() const {
+    return send_calls_;
+  }
+
+ private:
+  std::uint64_t DueUs(std::size_t i) const;
+
+  RtpIndexReader index_;
+  const char* data_;
+  std::size_t data_size_;
+  std::size_t next_;
+  std::size_t end_;
+  std::uint64_t start_us_;
+  std::uint64_t base_timestamp_;
+  double us_per_tick_;
+  std::size_t sent_;
+  std::uint64_t send_calls_;
+  sockaddr_in to_;
+  std::vector<mmsghdr> msgs_;
+  std::vector<iovec> iov_;
+};
+
+}  // namespace backend
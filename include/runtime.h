@@ -2,12 +2,20 @@
 
 #include "app_config.h"
 #include "event.h"
+#include "event_notifier.h"
+#include "io_stats.h"
 #include "mpsc_queue.h"
+#include "protocol.h"
 #include "tasks.h"
 #include "lua_vm.h"
+#include "recorder.h"
+#include "rtp_forward_table.h"
+#include "udp_session_directory.h"
 
 #include <atomic>
 #include <memory>
+#include <mutex>
+#include <string>
 #include <thread>
 #include <vector>
 
@@ -22,6 +30,16 @@ class Runtime {
   void Stop();
   void Join();
 
+  TcpIoStats GetTcpIoStats() const;
+  UdpIoStats GetUdpIoStats() const;
+  RecorderStats GetRecorderStats() const;
+  // Reception statistics of an RTP stream, refreshed once per IO loop pass.
+  bool GetRtpStreamStats(std::uint32_t ssrc, RtpStreamStats& out) const;
+  // The CNAME from the stream's last RTCP SDES, empty if none came yet.
+  bool GetRtpStreamCname(std::uint32_t ssrc, std::string& out) const;
+  // Live TCP connections and handled events of every worker, by index.
+  std::vector<WorkerStats> GetWorkerStats() const;
+
  private:
   void StartTcpIoThreads();
   void StartUdpIoThreads();
@@ -29,6 +47,7 @@ class Runtime {
   void StartDiskThreads();
   void StartLogThreads();
   void StartTimerThreads();
+  void StartReplayThread();
 
   void RunTcpIoThread(int index);
   void RunUdpIoThread(int index);
@@ -36,14 +55,48 @@ class Runtime {
   void RunDiskThread(int index);
   void RunLogThread(int index);
   void RunTimerThread(int index);
+  void RunReplayThread();
+
+  void ExecuteDiskTask(const DiskTask& task, int index, Recorder& recorder);
 
   AppConfig config_;
   std::atomic<bool> running_;
+  int shared_listen_fd_;
+  // One SO_REUSEPORT socket per UDP IO thread, created in thread order so
+  // the steering program's socket index matches the thread index.
+  std::vector<int> udp_fds_;
+  UdpSessionDirectory udp_sessions_;
+  RtpSessionDirectory rtp_sessions_;
+  RtpForwardTable rtp_forwards_;
+  // Sender SSRC of the RTCP reports this server sends.
+  std::uint32_t rtcp_ssrc_;
+  std::shared_ptr<ProtocolHandler> tcp_framing_;
 
   std::vector<std::unique_ptr<MpscQueue<Event>>> io_to_worker_;
-  std::vector<std::unique_ptr<MpscQueue<GenericTask>>> worker_to_io_;
+  std::vector<std::unique_ptr<MpscQueue<GenericTask>>> worker_to_tcp_io_;
+  std::vector<std::unique_ptr<MpscQueue<GenericTask>>> worker_to_udp_io_;
+  // RTCP for port P+1 is steered apart from the RTP on port P, so it is
+  // handed to the thread that keeps the stream.
+  std::vector<std::unique_ptr<MpscQueue<RtcpTask>>> rtcp_to_udp_io_;
   std::vector<std::unique_ptr<MpscQueue<DiskTask>>> worker_to_disk_;
   std::unique_ptr<MpscQueue<LogTask>> worker_to_log_;
+  std::unique_ptr<MpscQueue<ReplayTask>> worker_to_replay_;
+
+  std::vector<std::unique_ptr<TcpIoCounters>> tcp_io_counters_;
+  std::vector<std::unique_ptr<UdpIoCounters>> udp_io_counters_;
+  std::vector<std::unique_ptr<WorkerCounters>> worker_counters_;
+  std::vector<std::unique_ptr<RecorderCounters>> recorder_counters_;
+  // Held by a disk thread while it trims a recording directory.
+  std::mutex retention_mutex_;
+  // Sends of the replay thread, which shares the UDP sockets.
+  std::unique_ptr<UdpIoCounters> replay_counters_;
+
+  std::vector<std::unique_ptr<EventNotifier>> worker_notifiers_;
+  std::vector<std::unique_ptr<EventNotifier>> tcp_io_notifiers_;
+  std::vector<std::unique_ptr<EventNotifier>> udp_io_notifiers_;
+  std::vector<std::unique_ptr<EventNotifier>> disk_notifiers_;
+  std::unique_ptr<EventNotifier> log_notifier_;
+  std::unique_ptr<EventNotifier> replay_notifier_;
 
   std::vector<std::thread> tcp_io_threads_;
   std::vector<std::thread> udp_io_threads_;
@@ -51,6 +104,7 @@ class Runtime {
   std::vector<std::thread> disk_threads_;
   std::vector<std::thread> log_threads_;
   std::vector<std::thread> timer_threads_;
+  std::thread replay_thread_;
   std::vector<std::unique_ptr<LuaVm>> lua_vms_;
 };
 
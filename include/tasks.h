@@ -18,13 +18,18 @@ enum class TaskType {
 enum class DiskOp {
   Read,
   Write,
-  Append
+  Append,
+  // Completes the recording segment written at path (see
+  // recording_segments.h) once what was queued before it is written.
+  Seal
 };
 
 struct DiskTask {
   DiskOp op;
   std::string path;
   std::string data;
+  // Preallocated when an append opens the file.
+  std::uint64_t reserve_bytes = 0;
 };
 
 struct GenericTask {
@@ -34,6 +39,26 @@ struct GenericTask {
   std::string payload;
 };
 
+// RTCP that reached a UDP IO thread about an RTP stream another one keeps:
+// a sender report from remote_addr:remote_port, or a BYE.
+struct RtcpTask {
+  std::uint32_t ssrc;
+  bool bye;
+  // Network byte order, port in host byte order.
+  std::uint32_t remote_addr;
+  std::uint16_t remote_port;
+};
+
+// Plays a recording (rtp/<segment> without extension) to a UDP session, or
+// to remote_addr:remote_port when session_id is 0.
+struct ReplayTask {
+  std::string recording;
+  std::uint64_t session_id;
+  std::uint32_t remote_addr;
+  std::uint16_t remote_port;
+  double speed;
+};
+
 struct LogTask {
   enum class Level {
     Trace,
@@ -0,0 +1,133 @@
+#pragma once
+
+#include "app_config.h"
+#include "conn.h"
+#include "event.h"
+#include "event_notifier.h"
+#include "framer.h"
+#include "io_stats.h"
+#include "mpsc_queue.h"
+#include "protocol.h"
+#include "tasks.h"
+#include "timing_wheel.h"
+#include "worker_assigner.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <netinet/in.h>
+#include <spdlog/spdlog.h>
+
+namespace backend {
+
+// What a TCP IO thread is handed by the runtime. The runtime owns all of it.
+struct TcpIoContext {
+  const AppConfig* config;
+  const std::atomic<bool>* running;
+  int index;
+  int listen_fd;
+  // The listener is shared by every TCP IO thread, one woken per connection.
+  bool shared_listener;
+  EventNotifier* notifier;
+  MpscQueue<GenericTask>* inbound;
+  std::vector<std::unique_ptr<MpscQueue<Event>>>* to_workers;
+  std::vector<std::unique_ptr<WorkerCounters>>* worker_counters;
+  TcpIoCounters* counters;
+  std::shared_ptr<ProtocolHandler> framing;
+};
+
+// One TCP IO thread: accepts on its listener, frames what its connections
+// send for the workers and writes back what the workers reply. Connection
+// bookkeeping, idle expiry, read pausing and the loop live here; waiting,
+// reading and writing are up to the epoll or io_uring backend.
+class TcpIoThread {
+ public:
+  virtual ~TcpIoThread();
+  TcpIoThread(const TcpIoThread&) = delete;
+  TcpIoThread& operator=(const TcpIoThread&) = delete;
+
+  // The io_uring backend when configured and the ring can be set up, epoll
+  // otherwise. Returns nullptr if neither can watch the listener.
+  static std::unique_ptr<TcpIoThread> Create(const TcpIoContext& context);
+
+  // Runs until the runtime stops.
+  void Run();
+
+ protected:
+  explicit TcpIoThread(const TcpIoContext& context);
+
+  // Registers the listener and the notifier. Returns false on failure.
+  virtual bool Init() = 0;
+  // Waits up to timeout_ms, unparks the notifier, then accepts, reads and
+  // writes whatever became ready.
+  virtual void Poll(int timeout_ms) = 0;
+  // True while accepts are left over from the last Poll.
+  virtual bool AcceptPending() const {
+    return false;
+  }
+  // Starts writing the send queue. Returns false if the connection failed.
+  virtual bool FlushSendQueue(Conn& conn) = 0;
+  // Stops the kernel reading for a paused connection.
+  virtual void StopReads(Conn& conn) = 0;
+  // Reads again once the worker caught up. Returns false if the connection
+  // has to be closed.
+  virtual bool ResumeReads(Conn& conn) = 0;
+  // Releases the socket of a connection whose close was already posted.
+  virtual void CloseSocket(Conn& conn) = 0;
+
+  void PauseReads(Conn& conn);
+  // True once the worker of conn is too far behind to read more for it.
+  bool WorkerBacklogged(const Conn& conn) const;
+  RecvRing& AcquireRing(Conn& conn);
+  void ReleaseRing(Conn& conn);
+  void PostConnEvent(const Conn& conn, EventKind kind, std::string payload);
+  // Posts the messages the framer produced for conn.
+  void PostFramed(const Conn& conn);
+  void CloseConn(int fd, EventKind kind);
+  void UpdateSendWatermarks(Conn& conn);
+  void SetupConn(Conn& conn, const sockaddr_in& addr);
+
+  const AppConfig& config_;
+  const int index_;
+  const int listen_fd_;
+  const bool shared_listener_;
+  EventNotifier& notifier_;
+  TcpIoCounters& counters_;
+  std::shared_ptr<spdlog::logger> logger_;
+  TcpConnTable conn_table_;
+  Framer framer_;
+  std::vector<Event> framed_;
+
+ private:
+  std::size_t WorkerDepth(int worker) const;
+
+  const std::atomic<bool>& running_;
+  MpscQueue<GenericTask>& inbound_;
+  std::vector<std::unique_ptr<MpscQueue<Event>>>& to_workers_;
+  std::vector<std::unique_ptr<WorkerCounters>>& worker_counters_;
+  const std::size_t ring_capacity_;
+  const std::size_t pause_depth_;
+  const std::size_t resume_depth_;
+  TimingWheel idle_wheel_;
+  std::vector<std::uint64_t> expired_;
+  std::vector<std::vector<Event>> pending_events_;
+  std::vector<GenericTask> outbound_;
+  std::vector<int> send_ready_;
+  // Rings only stay with connections holding part of a message, so memory
+  // follows the number of connections mid-message rather than all of them.
+  std::vector<std::unique_ptr<RecvRing>> ring_pool_;
+  std::vector<int> paused_;
+  bool events_left_ = false;
+  WorkerAssigner assigner_;
+};
+
+// The backends, in tcp_io_epoll.cpp and tcp_io_uring.cpp. The io_uring one
+// is nullptr when io_uring is not configured or not usable.
+std::unique_ptr<TcpIoThread> MakeEpollTcpIoThread(const TcpIoContext& context);
+std::unique_ptr<TcpIoThread> MakeUringTcpIoThread(const TcpIoContext& context);
+
+}  // namespace backend
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace backend {
+
+// Hierarchical timing wheel with four levels of 64 slots, each level 64 times
+// coarser than the one below. Timers are list nodes in a pooled array, so
+// scheduling, cancelling and firing are O(1) and allocate nothing once the
+// pool has grown to the peak number of live timers. Timers never fire early;
+// they fire on the first Advance at or after the tick containing the deadline.
+class TimingWheel {
+ public:
+  static constexpr std::uint32_t kInvalidTimer = 0xFFFFFFFFu;
+
+  TimingWheel(std::uint64_t tick_ms, std::uint64_t now_ms);
+
+  // Arms a timer that reports key once deadline_ms has passed. The returned
+  // handle stays valid until the timer fires or is cancelled.
+  std::uint32_t Schedule(std::uint64_t key, std::uint64_t deadline_ms);
+  void Cancel(std::uint32_t timer);
+  // Moves the wheel forward to now_ms and appends the key of every timer that
+  // fired on the way.
+  void Advance(std::uint64_t now_ms, std::vector<std::uint64_t>& expired);
+
+  std::size_t Size() const {
+    return size_;
+  }
+
+ private:
+  static constexpr int kLevels = 4;
+  static constexpr int kSlotBits = 6;
+  static constexpr std::uint32_t kSlots = 1u << kSlotBits;
+
+  struct Node {
+    std::uint64_t key;
+    std::uint64_t expire_tick;
+    std::uint32_t prev;
+    std::uint32_t next;
+    std::uint32_t slot;
+  };
+
+  void Link(std::uint32_t timer);
+  void Unlink(std::uint32_t timer);
+  void Release(std::uint32_t timer);
+  std::uint32_t TakeSlot(std::uint32_t slot);
+
+  std::uint64_t tick_ms_;
+  std::uint64_t current_tick_;
+  std::vector<Node> nodes_;
+  std::vector<std::uint32_t> slots_;
+  std::uint32_t free_head_;
+  std::size_t size_;
+};
+
+}  // namespace backend
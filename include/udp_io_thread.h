@@ -0,0 +1,194 @@
+#pragma once
+
+#include "app_config.h"
+#include "event.h"
+#include "event_notifier.h"
+#include "io_stats.h"
+#include "mpsc_queue.h"
+#include "recording_segments.h"
+#include "rtcp.h"
+#include "rtp_classifier.h"
+#include "rtp_forward_table.h"
+#include "rtp_index.h"
+#include "rtp_jitter_buffer.h"
+#include "tasks.h"
+#include "timing_wheel.h"
+#include "udp_session_directory.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <netinet/in.h>
+#include <spdlog/spdlog.h>
+
+namespace backend {
+
+// What a UDP IO thread is handed by the runtime. The runtime owns all of it.
+struct UdpIoContext {
+  const AppConfig* config;
+  const std::atomic<bool>* running;
+  int index;
+  int udp_fd;
+  EventNotifier* notifier;
+  MpscQueue<GenericTask>* inbound;
+  // RTCP queues of every UDP IO thread, by thread index; this thread drains
+  // its own and pushes to the others.
+  std::vector<std::unique_ptr<MpscQueue<RtcpTask>>>* rtcp_queues;
+  std::vector<std::unique_ptr<MpscQueue<Event>>>* to_workers;
+  std::vector<std::unique_ptr<MpscQueue<DiskTask>>>* to_disk;
+  UdpIoCounters* counters;
+  UdpSessionDirectory* udp_sessions;
+  RtpSessionDirectory* rtp_sessions;
+  RtpForwardTable* rtp_forwards;
+  // Sender SSRC of the RTCP reports this server sends.
+  std::uint32_t rtcp_ssrc;
+};
+
+// One UDP IO thread on its SO_REUSEPORT socket: plain datagrams go to the
+// workers by session, RTP through the stream's jitter buffer to Lua and the
+// recorder, RTCP is handled here. Receiving and sending are up to the epoll
+// or io_uring backend; the rest of the loop lives here.
+class UdpIoThread {
+ public:
+  virtual ~UdpIoThread();
+  UdpIoThread(const UdpIoThread&) = delete;
+  UdpIoThread& operator=(const UdpIoThread&) = delete;
+
+  // The io_uring backend when configured and the ring can be set up, epoll
+  // otherwise. Returns nullptr if neither can watch the socket.
+  static std::unique_ptr<UdpIoThread> Create(const UdpIoContext& context);
+
+  // Runs until the runtime stops.
+  void Run();
+
+ protected:
+  explicit UdpIoThread(const UdpIoContext& context);
+
+  // Registers the socket and the notifier. Returns false on failure.
+  virtual bool Init() = 0;
+  // Waits up to timeout_ms, unparks the notifier, then hands every datagram
+  // that arrived to HandleDatagram.
+  virtual void Poll(int timeout_ms) = 0;
+  // Queues a datagram; it may go out before FlushSends.
+  virtual void SendDatagram(const sockaddr_in& addr, std::string&& payload) = 0;
+  // A payload string whose capacity is left over from an earlier send, so
+  // forwarding copies packets without allocating.
+  virtual std::string SparePayload() = 0;
+  // Sends what is still queued at the end of a pass.
+  virtual void FlushSends() = 0;
+
+  // STUN goes to Lua like any other datagram that is not RTP or RTCP.
+  void HandleDatagram(const char* data, std::size_t len, const sockaddr_in& addr,
+                      PacketClass kind, const RtpHeader& header);
+
+  const AppConfig& config_;
+  const int index_;
+  const int udp_fd_;
+  EventNotifier& notifier_;
+  UdpIoCounters& counters_;
+  std::shared_ptr<spdlog::logger> logger_;
+
+ private:
+  // Reception state of one RTP stream, private to the thread receiving it.
+  struct RtpStreamState {
+    RtpStreamState(std::uint32_t ssrc, std::uint64_t depth_ms, std::uint32_t clock_rate,
+                   std::uint64_t segment_bytes, std::uint64_t segment_ms)
+        : buffer(depth_ms, clock_rate),
+          index(ssrc),
+          segments(segment_bytes, segment_ms) {
+    }
+
+    RtpJitterBuffer buffer;
+    RtpIndexWriter index;
+    RecordingSegmenter segments;
+    // The RTP session being recorded and the disk queue its current segment
+    // goes to, -1 when none is open. Paths are built once per segment rather
+    // than per packet.
+    std::uint64_t record_id = 0;
+    int record_worker = -1;
+    std::string bin_path;
+    std::string index_path;
+    sockaddr_in last_addr{};
+    // Where the stream's RTCP comes from; reports go to last_addr until then,
+    // as with RTP and RTCP multiplexed on one port.
+    sockaddr_in rtcp_addr{};
+    bool has_rtcp_addr = false;
+    // Counts at the previous receiver report.
+    std::uint64_t expected_prior = 0;
+    std::uint64_t received_prior = 0;
+    // Listed for a release and stats publish this loop iteration.
+    bool touched = false;
+  };
+
+  // Recording state of a UDP session on the thread that receives it.
+  struct UdpRecording {
+    UdpRecording(std::uint64_t segment_bytes, std::uint64_t segment_ms)
+        : segments(segment_bytes, segment_ms) {
+    }
+
+    RecordingSegmenter segments;
+    std::uint64_t bytes = 0;
+    int worker = -1;
+    std::string path;
+  };
+
+  void ForwardRtp(const RtpForwardTarget& target, const char* data, std::size_t len);
+  void SealRecording(int worker, const std::string& part_path);
+  void SealRtpSegment(RtpStreamState& stream);
+  void DeliverRtp(RtpStreamState& stream, const RtpHeader& header, const char* data,
+                  std::size_t len, std::uint64_t now, std::uint32_t flags);
+  void CloseRtp(std::uint32_t ssrc, EventKind kind, std::uint64_t now);
+  void ApplyRtcp(std::uint32_t ssrc, bool bye, const sockaddr_in& addr, std::uint64_t now);
+  void RouteRtcp(std::uint32_t ssrc, bool bye, const sockaddr_in& addr, std::uint64_t now);
+  void HandleRtcp(const char* data, std::size_t len, const sockaddr_in& addr,
+                  std::uint64_t now);
+  void RecordUdp(std::uint64_t session_id, int worker, const char* data, std::size_t len,
+                 std::uint64_t now);
+  void ReleaseStream(std::uint32_t ssrc, RtpStreamState& stream, std::uint64_t now);
+  void SendReports(std::uint64_t now);
+  void ExpireUdpSessions(std::uint64_t now);
+  void ExpireRtpStreams(std::uint64_t now);
+  void DrainRtcpQueue(std::uint64_t now);
+  void DrainOutbound();
+
+  const std::atomic<bool>& running_;
+  MpscQueue<GenericTask>& inbound_;
+  std::vector<std::unique_ptr<MpscQueue<RtcpTask>>>& rtcp_queues_;
+  std::vector<std::unique_ptr<MpscQueue<Event>>>& to_workers_;
+  std::vector<std::unique_ptr<MpscQueue<DiskTask>>>& to_disk_;
+  UdpSessionDirectory& udp_sessions_;
+  RtpSessionDirectory& rtp_sessions_;
+  RtpForwardTable& rtp_forwards_;
+  const std::uint32_t rtcp_ssrc_;
+  TimingWheel udp_idle_wheel_;
+  TimingWheel rtp_idle_wheel_;
+  std::vector<std::uint64_t> expired_;
+  std::vector<std::vector<Event>> pending_events_;
+  std::vector<GenericTask> outbound_;
+  std::vector<RtcpTask> rtcp_tasks_;
+  std::vector<RtpForwardTarget> forward_targets_;
+  // Steering keeps a stream on one thread, so its jitter buffer and
+  // statistics live here; the directory only gets a published copy.
+  std::unordered_map<std::uint32_t, std::unique_ptr<RtpStreamState>> rtp_streams_;
+  std::vector<std::uint32_t> touched_streams_;
+  std::unordered_map<std::uint64_t, UdpRecording> udp_recordings_;
+  std::uint64_t next_release_ms_ = std::numeric_limits<std::uint64_t>::max();
+  RtcpCompound rtcp_;
+  std::minstd_rand report_random_;
+  // Never reached when reports are off.
+  std::uint64_t next_report_ms_;
+};
+
+// The backends, in udp_io_epoll.cpp and udp_io_uring.cpp. The io_uring one
+// is nullptr when io_uring is not configured or not usable.
+std::unique_ptr<UdpIoThread> MakeEpollUdpIoThread(const UdpIoContext& context);
+std::unique_ptr<UdpIoThread> MakeUringUdpIoThread(const UdpIoContext& context);
+
+}  // namespace backend
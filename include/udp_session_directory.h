@@ -0,0 +1,123 @@
+#pragma once
+
+#include "conn.h"
+#include "rtp_jitter_buffer.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace backend {
+
+// UDP sessions shared by every UDP IO thread, so a peer keeps one session id
+// whichever thread receives its datagrams. The table is split into shards
+// by address, each behind a reader-writer lock: datagrams of known peers
+// only take a shared lock and refresh the activity time atomically, while
+// creation and removal lock one shard exclusively. The slot index inside an
+// id carries the shard in its low bits, so FindById goes straight to it.
+// Lookups return copies, since another thread may remove the session.
+class UdpSessionDirectory {
+ public:
+  UdpSessionDirectory();
+
+  // New sessions record owner, the IO thread that replies are routed to.
+  UdpSession FindOrCreate(std::uint32_t remote_addr,
+                          std::uint16_t remote_port,
+                          ProtocolType protocol,
+                          int owner,
+                          std::uint64_t now_ms,
+                          bool* created = nullptr);
+  bool FindById(std::uint64_t id, UdpSession& out) const;
+  bool Remove(std::uint64_t id);
+  std::size_t Size() const;
+
+ private:
+  static constexpr std::uint32_t kShardBits = 4;
+  static constexpr std::uint32_t kShardCount = 1u << kShardBits;
+
+  struct Slot {
+    std::uint32_t remote_addr = 0;
+    std::uint16_t remote_port = 0;
+    std::uint64_t id = 0;
+    ProtocolType protocol = ProtocolType::Unknown;
+    std::uint32_t generation = 0;
+    bool live = false;
+    std::atomic<std::uint64_t> last_active_ms{0};
+  };
+
+  struct Shard {
+    mutable std::shared_mutex mutex;
+    std::deque<Slot> slots;
+    std::vector<std::uint32_t> free_slots;
+    std::unordered_map<std::uint64_t, std::uint32_t> by_address;
+  };
+
+  static void Copy(const Slot& slot, UdpSession& out);
+
+  Shard shards_[kShardCount];
+};
+
+// RTP streams shared by every UDP IO thread, keyed on SSRC. Ids are unique
+// across threads, and the recording offset of each stream is reserved
+// atomically so datagrams received by any thread land at distinct offsets.
+class RtpSessionDirectory {
+ public:
+  RtpSessionDirectory();
+
+  // Reserves record_bytes at the end of the stream's recording and stores
+  // where they start in record_offset. New sessions record owner.
+  RtpSession FindOrCreate(std::uint32_t ssrc,
+                          int owner,
+                          std::uint64_t now_ms,
+                          std::uint64_t record_bytes,
+                          std::uint64_t* record_offset,
+                          bool* created = nullptr);
+  bool Find(std::uint32_t ssrc, RtpSession& out) const;
+  void Remove(std::uint32_t ssrc);
+  // Gives back a reservation whose bytes were never recorded, so the
+  // offsets after it stay exact. Fails once a later reservation was made.
+  bool ReturnRecordBytes(std::uint32_t ssrc, std::uint64_t record_offset,
+                         std::uint64_t record_bytes);
+  // Reception statistics, published by the IO thread that tracks the stream.
+  void PublishStats(std::uint32_t ssrc, const RtpStreamStats& stats);
+  bool GetStats(std::uint32_t ssrc, RtpStreamStats& out) const;
+  // The middle 32 bits of the NTP timestamp of the last RTCP SR, and when it
+  // arrived, for the LSR and DLSR fields of reports about the stream.
+  void NoteSenderReport(std::uint32_t ssrc, std::uint64_t ntp_timestamp, std::uint64_t now_ms);
+  bool LastSenderReport(std::uint32_t ssrc, std::uint32_t* last_sr,
+                        std::uint64_t* received_ms) const;
+  void SetCname(std::uint32_t ssrc, const std::string& cname);
+  bool GetCname(std::uint32_t ssrc, std::string& out) const;
+
+ private:
+  static constexpr std::uint32_t kShardCount = 16;
+
+  struct Entry {
+    std::uint64_t id = 0;
+    int owner = 0;
+    std::atomic<std::uint64_t> last_active_ms{0};
+    std::atomic<std::uint64_t> record_bytes{0};
+    std::atomic<std::uint32_t> last_sr{0};
+    std::atomic<std::uint64_t> last_sr_ms{0};
+    // Guards stats and cname.
+    mutable std::mutex stats_mutex;
+    RtpStreamStats stats;
+    std::string cname;
+  };
+
+  struct Shard {
+    mutable std::shared_mutex mutex;
+    std::unordered_map<std::uint32_t, Entry> entries;
+  };
+
+  std::atomic<std::uint64_t> next_id_;
+  Shard shards_[kShardCount];
+};
+
+}  // namespace backend
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include <sys/socket.h>
+
+namespace backend {
+
+struct UringCompletion {
+  std::uint64_t user_data;
+  std::int32_t res;
+  std::uint32_t flags;
+
+  // The operation stays armed and will complete again.
+  bool More() const;
+  // res bytes were placed in the provided buffer BufferId().
+  bool HasBuffer() const;
+  unsigned BufferId() const;
+};
+
+// One datagram delivered by a multishot recvmsg, pointing into its buffer.
+struct UringRecvMsg {
+  const sockaddr* name;
+  socklen_t name_len;
+  const char* payload;
+  std::size_t payload_len;
+  bool truncated;
+};
+
+// Minimal io_uring wrapper for the IO threads: one submission/completion ring
+// plus one ring of provided receive buffers, driven through the raw syscalls.
+// Operations are queued with the Prepare calls and handed to the kernel in a
+// single io_uring_enter by SubmitAndWait.
+class UringReactor {
+ public:
+  UringReactor();
+  ~UringReactor();
+
+  UringReactor(const UringReactor&) = delete;
+  UringReactor& operator=(const UringReactor&) = delete;
+
+  // Returns false if the kernel lacks io_uring or any feature used here
+  // (multishot accept/recv, provided buffer rings, timed waits). Multishot
+  // recv is tried on a socketpair, as only using it tells.
+  bool Init(unsigned entries, unsigned buffer_count, unsigned buffer_size);
+
+  void PrepareMultishotAccept(int fd, std::uint64_t user_data);
+  void PrepareMultishotRecv(int fd, std::uint64_t user_data);
+  // msg supplies the name and control lengths of every datagram received.
+  void PrepareMultishotRecvMsg(int fd, msghdr* msg, std::uint64_t user_data);
+  void PrepareSendMsg(int fd, const msghdr* msg, std::uint64_t user_data);
+  void PrepareMultishotPoll(int fd, std::uint64_t user_data);
+  void PrepareCancel(std::uint64_t target_user_data, std::uint64_t user_data);
+
+  // Submits everything prepared and waits up to timeout_ms for a completion.
+  void SubmitAndWait(int timeout_ms);
+
+  // Calls fn(const UringCompletion&) for each ready completion.
+  template <typename Fn>
+  std::size_t ForEachCompletion(Fn&& fn) {
+    std::size_t count = 0;
+    UringCompletion completion;
+    while (PeekCompletion(completion)) {
+      fn(completion);
+      AdvanceCompletion();
+      ++count;
+    }
+    return count;
+  }
+
+  // Splits a recvmsg completion buffer laid out for msg into address and
+  // payload. Returns false if the buffer is too short to hold the header.
+  static bool ParseRecvMsg(const msghdr& msg, const char* buffer, std::size_t len,
+                           UringRecvMsg& out);
+
+  const char* Buffer(unsigned id) const;
+  unsigned BufferSize() const;
+  void RecycleBuffer(unsigned id);
+
+  // io_uring_enter calls made so far.
+  std::uint64_t EnterCalls() const {
+    return enter_calls_;
+  }
+
+ private:
+  struct Rings;
+
+  bool ProbeMultishotRecv();
+  // Never fails: when the kernel does not take a full ring, the entry is
+  // kept aside until a later submit.
+  void* NextSqe();
+  void Submit(unsigned wait_nr, int timeout_ms);
+  bool PeekCompletion(UringCompletion& out);
+  void AdvanceCompletion();
+
+  std::unique_ptr<Rings> rings_;
+  std::uint64_t enter_calls_;
+};
+
+}  // namespace backend
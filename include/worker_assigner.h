@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace backend {
+
+enum class WorkerAssignment {
+  RoundRobin = 0,
+  LeastLoaded = 1,
+  ConsistentHash = 2
+};
+
+// Accepts "round_robin", "least_loaded" and "consistent_hash".
+bool ParseWorkerAssignment(const std::string& name, WorkerAssignment& out);
+
+// Picks the worker a new TCP connection is pinned to. Each IO thread owns
+// one. Least-loaded asks load(worker) for the current depth of every worker
+// and breaks ties in round-robin order; consistent hash maps the remote
+// address onto a ring of virtual nodes, so a client keeps its worker across
+// reconnects and only 1/n of clients move if the worker count changes.
+class WorkerAssigner {
+ public:
+  WorkerAssigner(WorkerAssignment policy, int worker_count, int start = 0,
+                 std::function<std::size_t(int)> load = {});
+
+  // remote_addr is the IPv4 address in network byte order.
+  int Assign(std::uint32_t remote_addr);
+
+  WorkerAssignment Policy() const {
+    return policy_;
+  }
+
+ private:
+  static constexpr int kVirtualNodes = 64;
+
+  int NextRoundRobin();
+
+  WorkerAssignment policy_;
+  int worker_count_;
+  int next_;
+  std::function<std::size_t(int)> load_;
+  std::vector<std::pair<std::uint64_t, int>> ring_;
+};
+
+}  // namespace backend
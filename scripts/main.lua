@@ -5,10 +5,27 @@ function lua_on_tcp_message(event)
     cpp_send_tcp(event.session_id, event.payload)
 end
 
+function lua_on_tcp_send_blocked(event)
+    cpp_log("warn", "tcp peer is slow session=" .. tostring(event.session_id))
+end
+
+function lua_on_tcp_send_drained(event)
+end
+
+function lua_on_tcp_close(event)
+end
+
+function lua_on_tcp_expire(event)
+    cpp_log("info", "tcp idle timeout session=" .. tostring(event.session_id))
+end
+
 function lua_register_rtp_forward(ssrc, udp_session_id)
     rtp_forward_by_ssrc[ssrc] = udp_session_id
+    cpp_add_rtp_forward(ssrc, udp_session_id)
 end
 
+-- Anyone can forge the source of a datagram, so nothing here starts a
+-- replay: cpp_replay_rtp is for handlers that know who they are talking to.
 function lua_on_udp_signal(event)
     if event.payload == "register_rtp_forward" then
         rtp_forward_udp_session = event.session_id
@@ -29,12 +46,15 @@ function lua_on_udp_signal(event)
     cpp_send_udp(event.session_id, event.payload)
 end
 
+-- Only packets without a forwarding rule get here; installing one hands the
+-- rest of the stream to the UDP IO threads.
 function lua_on_rtp(event)
     local target = rtp_forward_by_ssrc[event.session_id]
     if target == nil then
         target = rtp_forward_udp_session
     end
     if target ~= nil then
+        cpp_add_rtp_forward(event.session_id, target)
         cpp_send_udp(target, event.payload)
     end
     cpp_log("info", "rtp bytes=" .. tostring(#event.payload)
@@ -42,6 +62,30 @@ function lua_on_rtp(event)
         .. " from=" .. tostring(event.remote_ip) .. ":" .. tostring(event.remote_port))
 end
 
+function lua_on_rtp_sample(event)
+end
+
+function lua_on_udp_expire(event)
+    if rtp_forward_udp_session == event.session_id then
+        rtp_forward_udp_session = nil
+    end
+    for ssrc, target in pairs(rtp_forward_by_ssrc) do
+        if target == event.session_id then
+            rtp_forward_by_ssrc[ssrc] = nil
+        end
+    end
+end
+
+function lua_on_rtp_expire(event)
+    cpp_remove_rtp_forward(event.session_id)
+    cpp_log("info", "rtp idle timeout ssrc_id=" .. tostring(event.session_id))
+end
+
+-- RTCP BYE; the forwarding rules are already gone.
+function lua_on_rtp_close(event)
+    cpp_log("info", "rtp bye ssrc_id=" .. tostring(event.session_id))
+end
+
 function lua_on_timer(event)
 end
 
@@ -73,6 +73,16 @@ int ToInt(const std::string& value, int fallback) {
   return result;
 }
 
+bool ToBool(const std::string& value, bool fallback) {
+  if (value == "true" || value == "1" || value == "yes" || value == "on") {
+    return true;
+  }
+  if (value == "false" || value == "0" || value == "no" || value == "off") {
+    return false;
+  }
+  return fallback;
+}
+
 std::size_t ToSize(const std::string& value, std::size_t fallback) {
   if (value.empty()) {
     return fallback;
@@ -89,6 +99,42 @@ std::size_t ToSize(const std::string& value, std::size_t fallback) {
   return result;
 }
 
+// Like ToSize, but for keys where 0 turns something off.
+std::size_t ToSizeOrZero(const std::string& value, std::size_t fallback) {
+  if (value.empty()) {
+    return fallback;
+  }
+  std::size_t result = 0;
+  std::istringstream iss(value);
+  iss >> result;
+  if (!iss) {
+    return fallback;
+  }
+  return result;
+}
+
+// Turns \n, \r, \t and \\ into the characters they name.
+std::string Unescape(const std::string& value) {
+  std::string result;
+  for (std::size_t i = 0; i < value.size(); ++i) {
+    if (value[i] != '\\' || i + 1 == value.size()) {
+      result.push_back(value[i]);
+      continue;
+    }
+    char next = value[++i];
+    if (next == 'n') {
+      result.push_back('\n');
+    } else if (next == 'r') {
+      result.push_back('\r');
+    } else if (next == 't') {
+      result.push_back('\t');
+    } else {
+      result.push_back(next);
+    }
+  }
+  return result;
+}
+
 }  // namespace
 
 AppConfig AppConfig::LoadFromFile(const std::string& path) {
@@ -106,12 +152,78 @@ AppConfig AppConfig::LoadFromFile(const std::string& path) {
   } else {
     config.log_level = "info";
   }
+  config.io_backend = values["io_backend"];
+  if (config.io_backend != "io_uring") {
+    config.io_backend = "epoll";
+  }
+  config.io_uring_entries =
+      static_cast<unsigned>(ToSize(values["io_uring_entries"], 256));
+  config.io_uring_buffer_count =
+      static_cast<unsigned>(ToSize(values["io_uring_buffer_count"], 1024));
+  config.io_uring_buffer_size =
+      static_cast<unsigned>(ToSize(values["io_uring_buffer_size"], 4096));
   auto port_iter = values.find("tcp_port");
   if (port_iter != values.end()) {
     config.tcp_port = ToPort(port_iter->second, 9000);
   } else {
     config.tcp_port = 9000;
   }
+  config.tcp_listen_backlog = ToInt(values["tcp_listen_backlog"], 1024);
+  config.tcp_accept_batch = ToInt(values["tcp_accept_batch"], 64);
+  config.tcp_edge_triggered = ToBool(values["tcp_edge_triggered"], false);
+  config.tcp_accept_mode = values["tcp_accept_mode"];
+  if (config.tcp_accept_mode != "exclusive") {
+    config.tcp_accept_mode = "reuseport";
+  }
+  config.tcp_worker_assignment = values["tcp_worker_assignment"];
+  if (config.tcp_worker_assignment != "least_loaded" &&
+      config.tcp_worker_assignment != "consistent_hash") {
+    config.tcp_worker_assignment = "round_robin";
+  }
+  config.tcp_send_high_watermark =
+      ToSize(values["tcp_send_high_watermark"], 1024 * 1024);
+  config.tcp_send_low_watermark =
+      ToSize(values["tcp_send_low_watermark"], 256 * 1024);
+  if (config.tcp_send_low_watermark >= config.tcp_send_high_watermark) {
+    config.tcp_send_low_watermark = config.tcp_send_high_watermark / 2;
+  }
+  config.tcp_framing = values["tcp_framing"];
+  if (config.tcp_framing.empty()) {
+    config.tcp_framing = "raw";
+  }
+  config.tcp_frame_length_bytes = ToInt(values["tcp_frame_length_bytes"], 4);
+  if (config.tcp_frame_length_bytes != 1 && config.tcp_frame_length_bytes != 2) {
+    config.tcp_frame_length_bytes = 4;
+  }
+  config.tcp_frame_delimiter = Unescape(values["tcp_frame_delimiter"]);
+  if (config.tcp_frame_delimiter.empty()) {
+    config.tcp_frame_delimiter = "\n";
+  }
+  config.tcp_max_message_size = ToSize(values["tcp_max_message_size"], 64 * 1024);
+  config.tcp_idle_timeout_ms = ToSize(values["tcp_idle_timeout_ms"], 300000);
+  config.udp_idle_timeout_ms = ToSize(values["udp_idle_timeout_ms"], 60000);
+  config.udp_batch_size = ToSize(values["udp_batch_size"], 32);
+  if (config.udp_batch_size == 0) {
+    config.udp_batch_size = 1;
+  }
+  config.udp_max_datagram_size = ToSize(values["udp_max_datagram_size"], 65536);
+  if (config.udp_max_datagram_size < 512) {
+    config.udp_max_datagram_size = 512;
+  }
+  config.udp_gso = ToBool(values["udp_gso"], true);
+  config.udp_gro = ToBool(values["udp_gro"], true);
+  config.rtp_idle_timeout_ms = ToSize(values["rtp_idle_timeout_ms"], 30000);
+  config.rtp_forward_sample_every =
+      static_cast<std::uint32_t>(ToSize(values["rtp_forward_sample_every"], 1000));
+  config.rtp_jitter_buffer_ms = ToSize(values["rtp_jitter_buffer_ms"], 0);
+  config.rtp_clock_rate = static_cast<std::uint32_t>(ToSize(values["rtp_clock_rate"], 90000));
+  config.rtcp_report_interval_ms = ToSizeOrZero(values["rtcp_report_interval_ms"], 5000);
+  config.recorder_max_open_files = ToSize(values["recorder_max_open_files"], 64);
+  config.recorder_block_size = ToSize(values["recorder_block_size"], 65536);
+  config.recorder_flush_interval_ms = ToSizeOrZero(values["recorder_flush_interval_ms"], 1000);
+  config.recording_segment_bytes = ToSizeOrZero(values["recording_segment_bytes"], 16777216);
+  config.recording_segment_ms = ToSizeOrZero(values["recording_segment_ms"], 300000);
+  config.recording_retention_bytes = ToSize(values["recording_retention_bytes"], 0);
   config.tcp_io_threads = ToInt(values["tcp_io_threads"], 4);
   config.udp_io_threads = ToInt(values["udp_io_threads"], 2);
   config.worker_threads = ToInt(values["worker_threads"], 8);
@@ -122,6 +234,13 @@ AppConfig AppConfig::LoadFromFile(const std::string& path) {
   config.queue_size_worker_to_io = ToSize(values["queue_size_worker_to_io"], 65536);
   config.queue_size_worker_to_disk = ToSize(values["queue_size_worker_to_disk"], 16384);
   config.queue_size_worker_to_log = ToSize(values["queue_size_worker_to_log"], 16384);
+  config.tcp_read_pause_watermark = ToSize(values["tcp_read_pause_watermark"],
+                                           config.queue_size_io_to_worker / 4 * 3);
+  if (config.tcp_read_pause_watermark > config.queue_size_io_to_worker) {
+    config.tcp_read_pause_watermark = config.queue_size_io_to_worker;
+  }
+  config.queue_batch_size = ToSize(values["queue_batch_size"], 64);
+  config.queue_spin_iterations = ToInt(values["queue_spin_iterations"], 200);
   auto lua_script_iter = values.find("lua_main_script");
   if (lua_script_iter != values.end()) {
     config.lua_main_script = lua_script_iter->second;
@@ -1,70 +1,183 @@
 #include "conn.h"
 
+#include <algorithm>
+#include <utility>
+
 namespace backend {
 
-bool TcpConnTable::Add(const Conn& conn) {
-  auto it = conns_.find(conn.fd);
-  if (it != conns_.end()) {
-    return false;
+void SendQueue::Append(std::string&& chunk) {
+  if (chunk.empty()) {
+    return;
+  }
+  pending_bytes_ += chunk.size();
+  chunks_.push_back(std::move(chunk));
+}
+
+int SendQueue::FillIov(iovec* iov, int max_iov) const {
+  int count = 0;
+  for (std::size_t i = 0; i < chunks_.size() && count < max_iov; ++i) {
+    std::size_t skip = i == 0 ? head_offset_ : 0;
+    iov[count].iov_base = const_cast<char*>(chunks_[i].data()) + skip;
+    iov[count].iov_len = chunks_[i].size() - skip;
+    ++count;
+  }
+  return count;
+}
+
+void SendQueue::Consume(std::size_t bytes) {
+  pending_bytes_ -= bytes;
+  while (bytes > 0) {
+    std::size_t available = chunks_.front().size() - head_offset_;
+    if (bytes < available) {
+      head_offset_ += bytes;
+      return;
+    }
+    bytes -= available;
+    chunks_.pop_front();
+    head_offset_ = 0;
+  }
+}
+
+RecvRing::RecvRing(std::size_t capacity)
+    : data_(new char[capacity]),
+      capacity_(capacity),
+      head_(0),
+      size_(0) {
+}
+
+int RecvRing::FillIov(iovec* iov) {
+  std::size_t free = capacity_ - size_;
+  if (free == 0) {
+    return 0;
+  }
+  std::size_t tail = head_ + size_;
+  if (tail >= capacity_) {
+    tail -= capacity_;
+  }
+  std::size_t first = capacity_ - tail < free ? capacity_ - tail : free;
+  iov[0].iov_base = data_.get() + tail;
+  iov[0].iov_len = first;
+  if (first == free) {
+    return 1;
+  }
+  iov[1].iov_base = data_.get();
+  iov[1].iov_len = free - first;
+  return 2;
+}
+
+void RecvRing::Commit(std::size_t bytes) {
+  size_ += bytes;
+}
+
+const char* RecvRing::Data() {
+  if (head_ + size_ > capacity_) {
+    std::rotate(data_.get(), data_.get() + head_, data_.get() + capacity_);
+    head_ = 0;
+  }
+  return data_.get() + head_;
+}
+
+void RecvRing::Consume(std::size_t bytes) {
+  size_ -= bytes;
+  head_ = size_ == 0 ? 0 : head_ + bytes;
+  if (head_ >= capacity_) {
+    head_ -= capacity_;
+  }
+}
+
+TcpConnTable::TcpConnTable()
+    : page_count_(0),
+      size_(0) {
+}
+
+TcpConnTable::~TcpConnTable() = default;
+
+Conn* TcpConnTable::Add(int fd) {
+  if (fd < 0) {
+    return nullptr;
+  }
+  std::size_t page_index = static_cast<std::size_t>(fd) >> kPageBits;
+  if (page_index >= pages_.size()) {
+    pages_.resize(page_index + 1);
+  }
+  auto& page = pages_[page_index];
+  if (!page) {
+    page = std::make_unique<Page>();
+    for (std::size_t i = 0; i < kPageSize; ++i) {
+      page->conns[i].fd = -1;
+      page->conns[i].state = ConnState::Closed;
+      page->conns[i].generation = 0;
+    }
+    ++page_count_;
   }
-  conns_.emplace(conn.fd, conn);
-  return true;
+  std::size_t slot = static_cast<std::size_t>(fd) & (kPageSize - 1);
+  Conn& conn = page->conns[slot];
+  if (conn.state != ConnState::Closed) {
+    return nullptr;
+  }
+  conn.fd = fd;
+  conn.state = ConnState::Connecting;
+  conn.generation = (conn.generation + 1) & kSessionGenerationMask;
+  conn.worker_index = 0;
+  conn.protocol = ProtocolType::Tcp;
+  conn.write_armed = false;
+  conn.send_blocked = false;
+  conn.send_scheduled = false;
+  conn.read_paused = false;
+  conn.recv_ring.reset();
+  conn.send_queue.reset();
+  ConnInfo& info = page->infos[slot];
+  info.remote_addr = 0;
+  info.remote_port = 0;
+  info.idle_timer = 0xFFFFFFFFu;
+  info.accepted_ms = 0;
+  info.last_active_ms = 0;
+  ++size_;
+  return &conn;
 }
 
 void TcpConnTable::Remove(int fd) {
-  conns_.erase(fd);
+  Conn* conn = Find(fd);
+  if (!conn) {
+    return;
+  }
+  conn->state = ConnState::Closed;
+  conn->recv_ring.reset();
+  conn->send_queue.reset();
+  --size_;
 }
 
 Conn* TcpConnTable::Find(int fd) {
-  auto it = conns_.find(fd);
-  if (it == conns_.end()) {
+  if (fd < 0) {
     return nullptr;
   }
-  return &it->second;
+  std::size_t page_index = static_cast<std::size_t>(fd) >> kPageBits;
+  if (page_index >= pages_.size() || !pages_[page_index]) {
+    return nullptr;
+  }
+  Conn& conn =
+      pages_[page_index]->conns[static_cast<std::size_t>(fd) & (kPageSize - 1)];
+  if (conn.state == ConnState::Closed) {
+    return nullptr;
+  }
+  return &conn;
 }
 
-UdpSession* UdpSessionTable::FindOrCreate(const std::string& ip,
-                                          std::uint16_t port,
-                                          ProtocolType protocol,
-                                          std::uint64_t now_ms) {
-  std::string key = ip + ":" + std::to_string(port);
-  auto it = sessions_.find(key);
-  if (it != sessions_.end()) {
-    it->second.last_active_ms = now_ms;
-    return &it->second;
-  }
-  UdpSession session;
-  session.remote_ip = ip;
-  session.remote_port = port;
-  session.id = sessions_.size() + 1;
-  session.protocol = protocol;
-  session.last_active_ms = now_ms;
-  auto result = sessions_.emplace(key, session);
-  return &result.first->second;
+Conn* TcpConnTable::Find(int fd, std::uint32_t generation) {
+  Conn* conn = Find(fd);
+  if (!conn || conn->generation != (generation & kSessionGenerationMask)) {
+    return nullptr;
+  }
+  return conn;
 }
 
-UdpSession* UdpSessionTable::FindById(std::uint64_t id) {
-  for (auto& kv : sessions_) {
-    if (kv.second.id == id) {
-      return &kv.second;
-    }
-  }
-  return nullptr;
+ConnInfo& TcpConnTable::Info(int fd) {
+  std::size_t page_index = static_cast<std::size_t>(fd) >> kPageBits;
+  return pages_[page_index]->infos[static_cast<std::size_t>(fd) & (kPageSize - 1)];
 }
 
-RtpSession* RtpSessionTable::FindOrCreate(std::uint32_t ssrc,
-                                          std::uint64_t now_ms) {
-  auto it = sessions_.find(ssrc);
-  if (it != sessions_.end()) {
-    it->second.last_active_ms = now_ms;
-    return &it->second;
-  }
-  RtpSession session;
-  session.ssrc = ssrc;
-  session.id = sessions_.size() + 1;
-  session.last_active_ms = now_ms;
-  auto result = sessions_.emplace(ssrc, session);
-  return &result.first->second;
+std::size_t TcpConnTable::MemoryUsage() const {
+  return pages_.capacity() * sizeof(pages_[0]) + page_count_ * sizeof(Page);
 }
 
 }  // namespace backend
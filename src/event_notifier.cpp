@@ -0,0 +1,46 @@
+#include "event_notifier.h"
+
+#include <cstdint>
+#include <stdexcept>
+
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace backend {
+
+EventNotifier::EventNotifier()
+    : fd_(::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)),
+      parked_(false) {
+  if (fd_ < 0) {
+    throw std::runtime_error("failed to create eventfd");
+  }
+}
+
+EventNotifier::~EventNotifier() {
+  if (fd_ >= 0) {
+    ::close(fd_);
+  }
+}
+
+void EventNotifier::Signal() {
+  std::uint64_t one = 1;
+  (void)::write(fd_, &one, sizeof(one));
+}
+
+void EventNotifier::Wait(int timeout_ms) {
+  pollfd pfd;
+  pfd.fd = fd_;
+  pfd.events = POLLIN;
+  pfd.revents = 0;
+  if (::poll(&pfd, 1, timeout_ms) > 0) {
+    Drain();
+  }
+}
+
+void EventNotifier::Drain() {
+  std::uint64_t value = 0;
+  (void)::read(fd_, &value, sizeof(value));
+}
+
+}  // namespace backend
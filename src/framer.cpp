@@ -0,0 +1,30 @@
+#include "framer.h"
+
+#include <utility>
+
+namespace backend {
+
+Framer::Framer(std::shared_ptr<ProtocolHandler> handler)
+    : handler_(std::move(handler)) {
+}
+
+std::size_t Framer::Feed(const char* data, std::size_t length, std::vector<Event>& out) {
+  std::size_t offset = 0;
+  while (offset < length) {
+    std::size_t frame = handler_->Frame(data + offset, length - offset);
+    if (frame == ProtocolHandler::kFrameError) {
+      return ProtocolHandler::kFrameError;
+    }
+    if (frame == 0) {
+      break;
+    }
+    Event event;
+    if (handler_->Parse(data + offset, frame, event)) {
+      out.push_back(std::move(event));
+    }
+    offset += frame;
+  }
+  return offset;
+}
+
+}  // namespace backend
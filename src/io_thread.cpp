@@ -0,0 +1,105 @@
+#include "io_thread.h"
+
+#include "conn.h"
+#include "logger.h"
+
+#include <chrono>
+
+#include <arpa/inet.h>
+
+namespace backend {
+
+std::uint64_t NowMs() {
+  auto now = std::chrono::steady_clock::now();
+  auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch());
+  return static_cast<std::uint64_t>(ms.count());
+}
+
+std::uint64_t NowUs() {
+  auto now = std::chrono::steady_clock::now();
+  auto us = std::chrono::duration_cast<std::chrono::microseconds>(now.time_since_epoch());
+  return static_cast<std::uint64_t>(us.count());
+}
+
+std::uint64_t WallMs() {
+  auto now = std::chrono::system_clock::now();
+  auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch());
+  return static_cast<std::uint64_t>(ms.count());
+}
+
+std::string IpFromSockaddr(const sockaddr_in& addr) {
+  char buffer[64];
+  const char* result = ::inet_ntop(AF_INET, &addr.sin_addr, buffer, sizeof(buffer));
+  if (!result) {
+    return {};
+  }
+  return std::string(result);
+}
+
+std::string IpFromAddress(std::uint32_t address) {
+  in_addr addr;
+  addr.s_addr = address;
+  char buffer[INET_ADDRSTRLEN];
+  const char* result = ::inet_ntop(AF_INET, &addr, buffer, sizeof(buffer));
+  if (!result) {
+    return {};
+  }
+  return std::string(result);
+}
+
+bool FlushPendingEvents(std::vector<std::vector<Event>>& pending,
+                        std::vector<std::unique_ptr<MpscQueue<Event>>>& queues) {
+  bool left = false;
+  for (std::size_t i = 0; i < pending.size(); ++i) {
+    auto& batch = pending[i];
+    if (batch.empty()) {
+      continue;
+    }
+    std::size_t sent = 0;
+    while (sent < batch.size()) {
+      std::size_t pushed = queues[i]->PushBatch(batch.data() + sent, batch.size() - sent);
+      if (pushed == 0) {
+        break;
+      }
+      sent += pushed;
+    }
+    batch.erase(batch.begin(), batch.begin() + static_cast<std::ptrdiff_t>(sent));
+    left = left || !batch.empty();
+  }
+  return left;
+}
+
+std::uint64_t UringData(UringOp op, int fd, std::uint32_t generation) {
+  return (static_cast<std::uint64_t>(op) << 56) |
+         (static_cast<std::uint64_t>(generation & kSessionGenerationMask) << 32) |
+         static_cast<std::uint32_t>(fd);
+}
+
+UringOp UringDataOp(std::uint64_t user_data) {
+  return static_cast<UringOp>(user_data >> 56);
+}
+
+int UringDataFd(std::uint64_t user_data) {
+  return static_cast<int>(user_data & 0xFFFFFFFFu);
+}
+
+std::uint32_t UringDataGeneration(std::uint64_t user_data) {
+  return static_cast<std::uint32_t>(user_data >> 32) & kSessionGenerationMask;
+}
+
+std::unique_ptr<UringReactor> MakeUringReactor(const AppConfig& config, const char* kind,
+                                               int index, unsigned buffer_count,
+                                               unsigned buffer_size) {
+  if (config.io_backend != "io_uring") {
+    return nullptr;
+  }
+  auto reactor = std::make_unique<UringReactor>();
+  if (!reactor->Init(config.io_uring_entries, buffer_count, buffer_size)) {
+    GetLogger()->warn("{} io thread {} cannot use io_uring, falling back to epoll", kind,
+                      index);
+    return nullptr;
+  }
+  return reactor;
+}
+
+}  // namespace backend
@@ -1,11 +1,16 @@
 #include "lua_vm.h"
 
+#include "conn.h"
 #include "logger.h"
+#include "rtp_replay.h"
 
 #include <cstdint>
 #include <string>
+#include <utility>
 #include <zlib.h>
 
+#include <arpa/inet.h>
+
 extern "C" {
 #include <lua.h>
 #include <lauxlib.h>
@@ -15,15 +20,21 @@ extern "C" {
 namespace backend {
 
 LuaVm::LuaVm(const std::string& script_path,
-             MpscQueue<GenericTask>* to_io,
+             std::vector<MpscQueue<GenericTask>*> to_tcp_io,
+             std::vector<MpscQueue<GenericTask>*> to_udp_io,
              MpscQueue<DiskTask>* to_disk,
              MpscQueue<LogTask>* to_log,
+             MpscQueue<ReplayTask>* to_replay,
+             RtpForwardTable* rtp_forwards,
              int worker_index)
     : script_path_(script_path),
       state_(nullptr),
-      to_io_(to_io),
+      to_tcp_io_(std::move(to_tcp_io)),
+      to_udp_io_(std::move(to_udp_io)),
       to_disk_(to_disk),
       to_log_(to_log),
+      to_replay_(to_replay),
+      rtp_forwards_(rtp_forwards),
       worker_index_(worker_index) {
 }
 
@@ -51,6 +62,26 @@ bool LuaVm::Init() {
   lua_pushcclosure(state_, Lua_SendUdp, 1);
   lua_setglobal(state_, "cpp_send_udp");
 
+  lua_pushlightuserdata(state_, this);
+  lua_pushcclosure(state_, Lua_AddRtpForward, 1);
+  lua_setglobal(state_, "cpp_add_rtp_forward");
+
+  lua_pushlightuserdata(state_, this);
+  lua_pushcclosure(state_, Lua_AddRtpForwardAddr, 1);
+  lua_setglobal(state_, "cpp_add_rtp_forward_addr");
+
+  lua_pushlightuserdata(state_, this);
+  lua_pushcclosure(state_, Lua_RemoveRtpForward, 1);
+  lua_setglobal(state_, "cpp_remove_rtp_forward");
+
+  lua_pushlightuserdata(state_, this);
+  lua_pushcclosure(state_, Lua_ReplayRtp, 1);
+  lua_setglobal(state_, "cpp_replay_rtp");
+
+  lua_pushlightuserdata(state_, this);
+  lua_pushcclosure(state_, Lua_ReplayRtpAddr, 1);
+  lua_setglobal(state_, "cpp_replay_rtp_addr");
+
   lua_pushlightuserdata(state_, this);
   lua_pushcclosure(state_, Lua_PostDiskTask, 1);
   lua_setglobal(state_, "cpp_post_disk_task");
@@ -88,13 +119,31 @@ void LuaVm::HandleEvent(const Event& event) {
   const char* handler = nullptr;
   switch (event.protocol) {
     case ProtocolType::Tcp:
-      handler = "lua_on_tcp_message";
+      if (event.kind == EventKind::SendBlocked) {
+        handler = "lua_on_tcp_send_blocked";
+      } else if (event.kind == EventKind::SendDrained) {
+        handler = "lua_on_tcp_send_drained";
+      } else if (event.kind == EventKind::Closed) {
+        handler = "lua_on_tcp_close";
+      } else if (event.kind == EventKind::Expired) {
+        handler = "lua_on_tcp_expire";
+      } else {
+        handler = "lua_on_tcp_message";
+      }
       break;
     case ProtocolType::Udp:
-      handler = "lua_on_udp_signal";
+      handler = event.kind == EventKind::Expired ? "lua_on_udp_expire" : "lua_on_udp_signal";
       break;
     case ProtocolType::Rtp:
-      handler = "lua_on_rtp";
+      if (event.kind == EventKind::Expired) {
+        handler = "lua_on_rtp_expire";
+      } else if (event.kind == EventKind::Closed) {
+        handler = "lua_on_rtp_close";
+      } else if (event.kind == EventKind::Forwarded) {
+        handler = "lua_on_rtp_sample";
+      } else {
+        handler = "lua_on_rtp";
+      }
       break;
     case ProtocolType::Unknown:
       handler = "lua_on_timer";
@@ -166,13 +215,14 @@ int LuaVm::Lua_SendTcp(lua_State* state) {
   logger->info("lua requested tcp send session_id={} size={}",
                static_cast<std::uint64_t>(session_id),
                static_cast<std::size_t>(length));
-  if (self && self->to_io_) {
+  int owner = SessionOwner(static_cast<std::uint64_t>(session_id));
+  if (self && owner < static_cast<int>(self->to_tcp_io_.size())) {
     GenericTask task;
     task.type = TaskType::Tcp;
     task.protocol = ProtocolType::Tcp;
     task.session_id = static_cast<std::uint64_t>(session_id);
     task.payload.assign(payload, length);
-    self->to_io_->Push(std::move(task));
+    self->to_tcp_io_[owner]->Push(std::move(task));
   }
   return 0;
 }
@@ -193,17 +243,135 @@ int LuaVm::Lua_SendUdp(lua_State* state) {
   logger->info("lua requested udp send session_id={} size={}",
                static_cast<std::uint64_t>(session_id),
                static_cast<std::size_t>(length));
-  if (self && self->to_io_) {
+  int owner = SessionOwner(static_cast<std::uint64_t>(session_id));
+  if (self && owner < static_cast<int>(self->to_udp_io_.size())) {
     GenericTask task;
     task.type = TaskType::Udp;
     task.protocol = ProtocolType::Udp;
     task.session_id = static_cast<std::uint64_t>(session_id);
     task.payload.assign(payload, length);
-    self->to_io_->Push(std::move(task));
+    self->to_udp_io_[owner]->Push(std::move(task));
   }
   return 0;
 }
 
+int LuaVm::Lua_AddRtpForward(lua_State* state) {
+  int argument_count = lua_gettop(state);
+  if (argument_count < 2) {
+    lua_pushstring(state, "cpp_add_rtp_forward expects ssrc and udp session_id");
+    lua_error(state);
+    return 0;
+  }
+  lua_Integer ssrc = luaL_checkinteger(state, 1);
+  lua_Integer session_id = luaL_checkinteger(state, 2);
+  void* userdata = lua_touserdata(state, lua_upvalueindex(1));
+  auto* self = static_cast<LuaVm*>(userdata);
+  bool added = false;
+  if (self && self->rtp_forwards_ && session_id != 0) {
+    RtpForwardTarget target;
+    target.session_id = static_cast<std::uint64_t>(session_id);
+    target.remote_addr = 0;
+    target.remote_port = 0;
+    added = self->rtp_forwards_->Add(static_cast<std::uint32_t>(ssrc), target);
+  }
+  lua_pushboolean(state, added ? 1 : 0);
+  return 1;
+}
+
+int LuaVm::Lua_AddRtpForwardAddr(lua_State* state) {
+  int argument_count = lua_gettop(state);
+  if (argument_count < 3) {
+    lua_pushstring(state, "cpp_add_rtp_forward_addr expects ssrc, ip and port");
+    lua_error(state);
+    return 0;
+  }
+  lua_Integer ssrc = luaL_checkinteger(state, 1);
+  const char* ip = luaL_checkstring(state, 2);
+  lua_Integer port = luaL_checkinteger(state, 3);
+  void* userdata = lua_touserdata(state, lua_upvalueindex(1));
+  auto* self = static_cast<LuaVm*>(userdata);
+  RtpForwardTarget target;
+  target.session_id = 0;
+  target.remote_port = static_cast<std::uint16_t>(port);
+  bool added = false;
+  if (self && self->rtp_forwards_ && port > 0 && port <= 65535 &&
+      ::inet_pton(AF_INET, ip, &target.remote_addr) == 1) {
+    added = self->rtp_forwards_->Add(static_cast<std::uint32_t>(ssrc), target);
+  }
+  lua_pushboolean(state, added ? 1 : 0);
+  return 1;
+}
+
+int LuaVm::Lua_RemoveRtpForward(lua_State* state) {
+  int argument_count = lua_gettop(state);
+  if (argument_count < 1) {
+    lua_pushstring(state, "cpp_remove_rtp_forward expects ssrc");
+    lua_error(state);
+    return 0;
+  }
+  lua_Integer ssrc = luaL_checkinteger(state, 1);
+  void* userdata = lua_touserdata(state, lua_upvalueindex(1));
+  auto* self = static_cast<LuaVm*>(userdata);
+  if (self && self->rtp_forwards_) {
+    self->rtp_forwards_->Remove(static_cast<std::uint32_t>(ssrc));
+  }
+  return 0;
+}
+
+int LuaVm::Lua_ReplayRtp(lua_State* state) {
+  int argument_count = lua_gettop(state);
+  if (argument_count < 2) {
+    lua_pushstring(state, "cpp_replay_rtp expects recording, udp session_id and optional speed");
+    lua_error(state);
+    return 0;
+  }
+  const char* recording = luaL_checkstring(state, 1);
+  lua_Integer session_id = luaL_checkinteger(state, 2);
+  lua_Number speed = luaL_optnumber(state, 3, 1.0);
+  void* userdata = lua_touserdata(state, lua_upvalueindex(1));
+  auto* self = static_cast<LuaVm*>(userdata);
+  bool queued = false;
+  if (self && self->to_replay_ && session_id != 0 && speed > 0 &&
+      speed <= kMaxSessionReplaySpeed) {
+    ReplayTask task;
+    task.recording = recording;
+    task.session_id = static_cast<std::uint64_t>(session_id);
+    task.remote_addr = 0;
+    task.remote_port = 0;
+    task.speed = static_cast<double>(speed);
+    queued = self->to_replay_->Push(std::move(task));
+  }
+  lua_pushboolean(state, queued ? 1 : 0);
+  return 1;
+}
+
+int LuaVm::Lua_ReplayRtpAddr(lua_State* state) {
+  int argument_count = lua_gettop(state);
+  if (argument_count < 3) {
+    lua_pushstring(state, "cpp_replay_rtp_addr expects recording, ip, port and optional speed");
+    lua_error(state);
+    return 0;
+  }
+  const char* recording = luaL_checkstring(state, 1);
+  const char* ip = luaL_checkstring(state, 2);
+  lua_Integer port = luaL_checkinteger(state, 3);
+  lua_Number speed = luaL_optnumber(state, 4, 1.0);
+  void* userdata = lua_touserdata(state, lua_upvalueindex(1));
+  auto* self = static_cast<LuaVm*>(userdata);
+  ReplayTask task;
+  task.recording = recording;
+  task.session_id = 0;
+  task.remote_port = static_cast<std::uint16_t>(port);
+  task.speed = static_cast<double>(speed);
+  bool queued = false;
+  if (self && self->to_replay_ && port > 0 && port <= 65535 && speed >= 0 &&
+      ::inet_pton(AF_INET, ip, &task.remote_addr) == 1) {
+    queued = self->to_replay_->Push(std::move(task));
+  }
+  lua_pushboolean(state, queued ? 1 : 0);
+  return 1;
+}
+
 int LuaVm::Lua_PostDiskTask(lua_State* state) {
   int argument_count = lua_gettop(state);
   if (argument_count < 1) {
@@ -1,14 +1,20 @@
 #include "protocol.h"
 
+#include <cstring>
 #include <memory>
+#include <mutex>
+#include <string>
 #include <unordered_map>
+#include <utility>
 
 namespace backend {
 
 namespace {
 
 struct RegistryStorage {
+  mutable std::mutex mutex;
   std::unordered_map<ProtocolType, std::shared_ptr<ProtocolHandler>> handlers;
+  std::unordered_map<std::string, std::shared_ptr<ProtocolHandler>> named_handlers;
 };
 
 RegistryStorage& GetStorage() {
@@ -26,11 +32,13 @@ ProtocolRegistry& ProtocolRegistry::Instance() {
 void ProtocolRegistry::RegisterHandler(ProtocolType type,
                                        std::shared_ptr<ProtocolHandler> handler) {
   auto& storage = GetStorage();
+  std::lock_guard<std::mutex> lock(storage.mutex);
   storage.handlers[type] = std::move(handler);
 }
 
 std::shared_ptr<ProtocolHandler> ProtocolRegistry::GetHandler(ProtocolType type) const {
   const auto& storage = GetStorage();
+  std::lock_guard<std::mutex> lock(storage.mutex);
   auto it = storage.handlers.find(type);
   if (it == storage.handlers.end()) {
     return nullptr;
@@ -38,5 +46,103 @@ std::shared_ptr<ProtocolHandler> ProtocolRegistry::GetHandler(ProtocolType type)
   return it->second;
 }
 
+void ProtocolRegistry::RegisterHandler(const std::string& name,
+                                       std::shared_ptr<ProtocolHandler> handler) {
+  auto& storage = GetStorage();
+  std::lock_guard<std::mutex> lock(storage.mutex);
+  storage.named_handlers[name] = std::move(handler);
+}
+
+std::shared_ptr<ProtocolHandler> ProtocolRegistry::GetHandler(const std::string& name) const {
+  const auto& storage = GetStorage();
+  std::lock_guard<std::mutex> lock(storage.mutex);
+  auto it = storage.named_handlers.find(name);
+  if (it == storage.named_handlers.end()) {
+    return nullptr;
+  }
+  return it->second;
+}
+
+bool RawHandler::Parse(const char* data, std::size_t length, Event& out_event) {
+  out_event.payload.assign(data, length);
+  return true;
+}
+
+bool RawHandler::Encode(const Event& event, std::string& out_bytes) {
+  out_bytes = event.payload;
+  return true;
+}
+
+LengthPrefixHandler::LengthPrefixHandler(int header_bytes, std::size_t max_message_size)
+    : header_bytes_(header_bytes == 1 || header_bytes == 2 ? header_bytes : 4),
+      max_message_size_(max_message_size) {
+}
+
+std::size_t LengthPrefixHandler::Frame(const char* data, std::size_t length) {
+  if (length < header_bytes_) {
+    return 0;
+  }
+  std::size_t body = 0;
+  for (std::size_t i = 0; i < header_bytes_; ++i) {
+    body = (body << 8) | static_cast<unsigned char>(data[i]);
+  }
+  if (body > max_message_size_) {
+    return kFrameError;
+  }
+  if (length - header_bytes_ < body) {
+    return 0;
+  }
+  return header_bytes_ + body;
+}
+
+bool LengthPrefixHandler::Parse(const char* data, std::size_t length, Event& out_event) {
+  out_event.payload.assign(data + header_bytes_, length - header_bytes_);
+  return true;
+}
+
+bool LengthPrefixHandler::Encode(const Event& event, std::string& out_bytes) {
+  std::size_t body = event.payload.size();
+  if (body > max_message_size_ ||
+      (header_bytes_ < 4 && body >> (8 * header_bytes_) != 0)) {
+    return false;
+  }
+  out_bytes.clear();
+  out_bytes.reserve(header_bytes_ + body);
+  for (std::size_t i = header_bytes_; i > 0; --i) {
+    out_bytes.push_back(static_cast<char>((body >> (8 * (i - 1))) & 0xFF));
+  }
+  out_bytes.append(event.payload);
+  return true;
+}
+
+DelimiterHandler::DelimiterHandler(std::string delimiter, std::size_t max_message_size)
+    : delimiter_(delimiter.empty() ? std::string("\n") : std::move(delimiter)),
+      max_message_size_(max_message_size) {
+}
+
+std::size_t DelimiterHandler::Frame(const char* data, std::size_t length) {
+  std::size_t limit = max_message_size_ + delimiter_.size();
+  std::size_t scan = length < limit ? length : limit;
+  const void* found = ::memmem(data, scan, delimiter_.data(), delimiter_.size());
+  if (found == nullptr) {
+    return length >= limit ? kFrameError : 0;
+  }
+  return static_cast<std::size_t>(static_cast<const char*>(found) - data) +
+         delimiter_.size();
+}
+
+bool DelimiterHandler::Parse(const char* data, std::size_t length, Event& out_event) {
+  out_event.payload.assign(data, length - delimiter_.size());
+  return true;
+}
+
+bool DelimiterHandler::Encode(const Event& event, std::string& out_bytes) {
+  out_bytes.clear();
+  out_bytes.reserve(event.payload.size() + delimiter_.size());
+  out_bytes.append(event.payload);
+  out_bytes.append(delimiter_);
+  return true;
+}
+
 }  // namespace backend
 
@@ -0,0 +1,212 @@
+#include "recorder.h"
+
+#include "logger.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace backend {
+
+namespace {
+
+constexpr std::size_t kBlockAlignment = 4096;
+// Preallocated at a time, so a short recording holds little more disk than
+// it writes.
+constexpr std::uint64_t kReserveChunk = 1 << 20;
+
+// mkdir -p for the directories above path.
+void MakeParentDirectories(const std::string& path) {
+  for (std::size_t slash = path.find('/', 1); slash != std::string::npos;
+       slash = path.find('/', slash + 1)) {
+    ::mkdir(path.substr(0, slash).c_str(), 0755);
+  }
+}
+
+}  // namespace
+
+Recorder::Recorder(std::size_t max_open_files, std::size_t block_size,
+                   std::uint64_t flush_interval_ms, RecorderCounters* counters)
+    : max_open_files_(std::max<std::size_t>(max_open_files, 1)),
+      block_size_((std::max<std::size_t>(block_size, 1) + kBlockAlignment - 1) /
+                  kBlockAlignment * kBlockAlignment),
+      flush_interval_ms_(flush_interval_ms),
+      counters_(counters),
+      next_due_ms_(std::numeric_limits<std::uint64_t>::max()) {
+}
+
+Recorder::~Recorder() {
+  CloseAll();
+}
+
+bool Recorder::Append(const std::string& path, const char* data, std::size_t len,
+                      std::uint64_t now_ms, std::uint64_t reserve_bytes) {
+  auto found = by_path_.find(path);
+  FileList::iterator it;
+  if (found != by_path_.end()) {
+    it = found->second;
+    files_.splice(files_.begin(), files_, it);
+  } else {
+    it = Open(path, reserve_bytes);
+    if (it == files_.end()) {
+      AddCounter(counters_->dropped_records, 1);
+      return false;
+    }
+  }
+  File& file = *it;
+  AddCounter(counters_->records, 1);
+  AddCounter(counters_->appended_bytes, len);
+  if (file.used + len > block_size_ && !Flush(file)) {
+    AddCounter(counters_->dropped_records, 1);
+    return false;
+  }
+  if (len > block_size_) {
+    if (!WriteAll(file, data, len)) {
+      AddCounter(counters_->dropped_records, 1);
+      return false;
+    }
+    return true;
+  }
+  if (file.used == 0) {
+    file.dirty_since_ms = now_ms;
+    next_due_ms_ = std::min(next_due_ms_, now_ms + flush_interval_ms_);
+  }
+  std::memcpy(file.block + file.used, data, len);
+  file.used += len;
+  ++file.records;
+  return true;
+}
+
+void Recorder::FlushDue(std::uint64_t now_ms) {
+  if (now_ms < next_due_ms_) {
+    return;
+  }
+  next_due_ms_ = std::numeric_limits<std::uint64_t>::max();
+  for (File& file : files_) {
+    if (file.used == 0) {
+      continue;
+    }
+    if (now_ms >= file.dirty_since_ms + flush_interval_ms_) {
+      Flush(file);
+    } else {
+      next_due_ms_ = std::min(next_due_ms_, file.dirty_since_ms + flush_interval_ms_);
+    }
+  }
+}
+
+void Recorder::Close(const std::string& path) {
+  auto found = by_path_.find(path);
+  if (found != by_path_.end()) {
+    Release(found->second);
+  }
+}
+
+void Recorder::CloseAll() {
+  while (!files_.empty()) {
+    Release(files_.begin());
+  }
+}
+
+Recorder::FileList::iterator Recorder::Open(const std::string& path,
+                                            std::uint64_t reserve_bytes) {
+  if (files_.size() >= max_open_files_) {
+    Release(std::prev(files_.end()));
+    AddCounter(counters_->evictions, 1);
+  }
+  int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+  if (fd < 0 && errno == ENOENT) {
+    MakeParentDirectories(path);
+    fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+  }
+  if (fd < 0) {
+    GetLogger()->warn("recorder failed to open {}: {}", path, std::strerror(errno));
+    return files_.end();
+  }
+  void* block = nullptr;
+  if (::posix_memalign(&block, kBlockAlignment, block_size_) != 0) {
+    ::close(fd);
+    return files_.end();
+  }
+  AddCounter(counters_->opens, 1);
+  files_.emplace_front();
+  File& file = files_.front();
+  file.path = path;
+  file.fd = fd;
+  file.block = static_cast<char*>(block);
+  if (reserve_bytes > 0) {
+    struct stat st;
+    if (::fstat(fd, &st) == 0) {
+      file.size = static_cast<std::uint64_t>(st.st_size);
+      file.reserved = file.size;
+      file.reserve_limit = reserve_bytes;
+      Reserve(file);
+    }
+  }
+  by_path_.emplace(path, files_.begin());
+  return files_.begin();
+}
+
+void Recorder::Reserve(File& file) {
+  if (file.reserved >= file.reserve_limit || file.size + block_size_ <= file.reserved) {
+    return;
+  }
+  // Reserved beyond the end of the file, so appends find their blocks
+  // allocated and contiguous while the size still tracks the data. File
+  // systems without fallocate just allocate as they go.
+  std::uint64_t end = std::min(std::max(file.size, file.reserved) + kReserveChunk,
+                               file.reserve_limit);
+  (void)::fallocate(file.fd, FALLOC_FL_KEEP_SIZE, static_cast<off_t>(file.reserved),
+                    static_cast<off_t>(end - file.reserved));
+  file.reserved = end;
+}
+
+bool Recorder::Flush(File& file) {
+  if (file.used == 0) {
+    return true;
+  }
+  bool ok = WriteAll(file, file.block, file.used);
+  if (!ok) {
+    AddCounter(counters_->dropped_records, file.records);
+  }
+  file.used = 0;
+  file.records = 0;
+  return ok;
+}
+
+bool Recorder::WriteAll(File& file, const char* data, std::size_t len) {
+  std::size_t written = 0;
+  while (written < len) {
+    ssize_t n = ::write(file.fd, data + written, len - written);
+    AddCounter(counters_->write_calls, 1);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      GetLogger()->warn("recorder failed to write {}: {}", file.path,
+                        n < 0 ? std::strerror(errno) : "no progress");
+      return false;
+    }
+    written += static_cast<std::size_t>(n);
+  }
+  AddCounter(counters_->written_bytes, len);
+  file.size += len;
+  Reserve(file);
+  return true;
+}
+
+void Recorder::Release(FileList::iterator it) {
+  Flush(*it);
+  ::close(it->fd);
+  AddCounter(counters_->closes, 1);
+  std::free(it->block);
+  by_path_.erase(it->path);
+  files_.erase(it);
+}
+
+}  // namespace backend
@@ -0,0 +1,175 @@
+#include "recording_segments.h"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <map>
+#include <vector>
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace backend {
+
+namespace {
+
+const std::size_t kSegmentPartSuffixSize = sizeof(kSegmentPartSuffix) - 1;
+
+bool IsPart(const std::string& name) {
+  return name.size() > kSegmentPartSuffixSize &&
+         name.compare(name.size() - kSegmentPartSuffixSize, kSegmentPartSuffixSize,
+                      kSegmentPartSuffix) == 0;
+}
+
+std::uint64_t ModifiedNs(const struct stat& st) {
+  return static_cast<std::uint64_t>(st.st_mtim.tv_sec) * 1000000000u +
+         static_cast<std::uint64_t>(st.st_mtim.tv_nsec);
+}
+
+}  // namespace
+
+RecordingSegmenter::RecordingSegmenter(std::uint64_t max_bytes, std::uint64_t max_ms)
+    : max_bytes_(max_bytes),
+      max_ms_(max_ms),
+      started_(false),
+      segment_(0),
+      base_(0),
+      last_(0),
+      start_ms_(0) {
+}
+
+bool RecordingSegmenter::Place(std::uint64_t offset, std::uint64_t len, std::uint64_t now_ms) {
+  bool start = !started_;
+  if (started_) {
+    // A record too large for any segment still gets an empty one to itself.
+    std::uint64_t used = offset > base_ ? offset - base_ : 0;
+    if (max_bytes_ > 0 && used > 0 && used + len > max_bytes_) {
+      start = true;
+    }
+    if (max_ms_ > 0 && now_ms - start_ms_ >= max_ms_) {
+      start = true;
+    }
+    if (start) {
+      ++segment_;
+    }
+  }
+  if (start) {
+    started_ = true;
+    base_ = offset;
+    start_ms_ = now_ms;
+  }
+  last_ = std::max(offset, base_);
+  return start;
+}
+
+std::string SegmentName(const std::string& prefix, std::uint64_t segment, std::uint64_t wall_ms) {
+  char suffix[48];
+  std::snprintf(suffix, sizeof(suffix), "_%06" PRIu64 "_%" PRIu64, segment, wall_ms);
+  return prefix + suffix;
+}
+
+bool SealSegment(const std::string& part_path) {
+  if (!IsPart(part_path)) {
+    return false;
+  }
+  struct stat st;
+  if (::stat(part_path.c_str(), &st) != 0) {
+    return false;
+  }
+  // Truncating to the current size frees what fallocate kept past the end.
+  (void)::truncate(part_path.c_str(), st.st_size);
+  std::string final_path = part_path.substr(0, part_path.size() - kSegmentPartSuffixSize);
+  return ::rename(part_path.c_str(), final_path.c_str()) == 0;
+}
+
+std::size_t SealLeftoverSegments(const std::string& dir) {
+  DIR* handle = ::opendir(dir.c_str());
+  if (!handle) {
+    return 0;
+  }
+  std::vector<std::string> parts;
+  while (dirent* entry = ::readdir(handle)) {
+    std::string name = entry->d_name;
+    if (IsPart(name)) {
+      parts.push_back(dir + "/" + name);
+    }
+  }
+  ::closedir(handle);
+  std::size_t sealed = 0;
+  for (const std::string& part : parts) {
+    sealed += SealSegment(part) ? 1 : 0;
+  }
+  return sealed;
+}
+
+std::size_t EnforceRetention(const std::string& dir, std::uint64_t budget_bytes,
+                             std::uint64_t* freed_bytes) {
+  if (freed_bytes) {
+    *freed_bytes = 0;
+  }
+  DIR* handle = ::opendir(dir.c_str());
+  if (!handle) {
+    return 0;
+  }
+  struct SegmentFiles {
+    std::uint64_t bytes = 0;
+    std::uint64_t modified_ns = 0;
+    std::vector<std::string> paths;
+  };
+  // Files of one segment share the name up to the first dot.
+  std::map<std::string, SegmentFiles> segments;
+  std::uint64_t total = 0;
+  while (dirent* entry = ::readdir(handle)) {
+    std::string name = entry->d_name;
+    if (name.empty() || name[0] == '.') {
+      continue;
+    }
+    std::string path = dir + "/" + name;
+    struct stat st;
+    if (::lstat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) {
+      continue;
+    }
+    if (IsPart(name)) {
+      // A reservation is freed on sealing; it must not push out sealed data.
+      total += static_cast<std::uint64_t>(st.st_size);
+      continue;
+    }
+    // Allocated blocks, so space a sealed segment still holds is charged.
+    std::uint64_t bytes = static_cast<std::uint64_t>(st.st_blocks) * 512;
+    total += bytes;
+    SegmentFiles& segment = segments[name.substr(0, name.find('.'))];
+    segment.bytes += bytes;
+    segment.modified_ns = std::max(segment.modified_ns, ModifiedNs(st));
+    segment.paths.push_back(path);
+  }
+  ::closedir(handle);
+  if (total <= budget_bytes) {
+    return 0;
+  }
+  std::vector<const SegmentFiles*> oldest;
+  for (const auto& entry : segments) {
+    oldest.push_back(&entry.second);
+  }
+  std::stable_sort(oldest.begin(), oldest.end(),
+                   [](const SegmentFiles* a, const SegmentFiles* b) {
+                     return a->modified_ns < b->modified_ns;
+                   });
+  std::size_t deleted = 0;
+  for (const SegmentFiles* segment : oldest) {
+    if (total <= budget_bytes) {
+      break;
+    }
+    for (const std::string& path : segment->paths) {
+      ::unlink(path.c_str());
+    }
+    total -= std::min(total, segment->bytes);
+    if (freed_bytes) {
+      *freed_bytes += segment->bytes;
+    }
+    ++deleted;
+  }
+  return deleted;
+}
+
+}  // namespace backend
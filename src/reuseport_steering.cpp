@@ -0,0 +1,56 @@
+#include "reuseport_steering.h"
+
+#include <arpa/inet.h>
+#include <linux/filter.h>
+#include <sys/socket.h>
+
+#ifndef SO_ATTACH_REUSEPORT_CBPF
+#define SO_ATTACH_REUSEPORT_CBPF 51
+#endif
+
+namespace backend {
+
+namespace {
+
+const std::uint32_t kSteeringMultiplier = 0x9e3779b1u;
+
+}  // namespace
+
+bool AttachReuseportSteering(int fd, int group_size) {
+  if (group_size <= 1) {
+    return true;
+  }
+  // The program runs with the packet positioned past the UDP header, so both
+  // fields are loaded relative to the IP header; the port offset honours IP
+  // options.
+  sock_filter code[] = {
+      // X = IP header length.
+      BPF_STMT(BPF_LDX | BPF_B | BPF_MSH, static_cast<std::uint32_t>(SKF_NET_OFF)),
+      // A = source port, X = A.
+      BPF_STMT(BPF_LD | BPF_H | BPF_IND, static_cast<std::uint32_t>(SKF_NET_OFF)),
+      BPF_STMT(BPF_MISC | BPF_TAX, 0),
+      // A = (source address ^ port) * multiplier >> 16 % group_size.
+      BPF_STMT(BPF_LD | BPF_W | BPF_ABS, static_cast<std::uint32_t>(SKF_NET_OFF + 12)),
+      BPF_STMT(BPF_ALU | BPF_XOR | BPF_X, 0),
+      BPF_STMT(BPF_ALU | BPF_MUL | BPF_K, kSteeringMultiplier),
+      BPF_STMT(BPF_ALU | BPF_RSH | BPF_K, 16),
+      BPF_STMT(BPF_ALU | BPF_MOD | BPF_K, static_cast<std::uint32_t>(group_size)),
+      BPF_STMT(BPF_RET | BPF_A, 0),
+  };
+  sock_fprog program;
+  program.len = static_cast<unsigned short>(sizeof(code) / sizeof(code[0]));
+  program.filter = code;
+  return ::setsockopt(fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &program,
+                      sizeof(program)) == 0;
+}
+
+int ReuseportSteeringIndex(std::uint32_t remote_addr, std::uint16_t remote_port,
+                           int group_size) {
+  if (group_size <= 1) {
+    return 0;
+  }
+  std::uint32_t hash = (ntohl(remote_addr) ^ remote_port) * kSteeringMultiplier;
+  return static_cast<int>((hash >> 16) % static_cast<std::uint32_t>(group_size));
+}
+
+}  // namespace backend
@@ -0,0 +1,261 @@
+#include "rtcp.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace backend {
+
+namespace {
+
+constexpr std::size_t kRtcpHeaderSize = 4;
+constexpr std::size_t kSenderInfoSize = 20;
+constexpr std::size_t kReportBlockSize = 24;
+constexpr std::size_t kMaxReportBlocks = 31;
+constexpr std::uint8_t kSdesEnd = 0;
+constexpr std::uint8_t kSdesCname = 1;
+
+std::uint32_t Read32(const unsigned char* p) {
+  return (static_cast<std::uint32_t>(p[0]) << 24) | (static_cast<std::uint32_t>(p[1]) << 16) |
+         (static_cast<std::uint32_t>(p[2]) << 8) | static_cast<std::uint32_t>(p[3]);
+}
+
+void Write32(unsigned char* p, std::uint32_t value) {
+  p[0] = static_cast<unsigned char>(value >> 24);
+  p[1] = static_cast<unsigned char>(value >> 16);
+  p[2] = static_cast<unsigned char>(value >> 8);
+  p[3] = static_cast<unsigned char>(value);
+}
+
+RtcpReportBlock ReadReportBlock(const unsigned char* p) {
+  RtcpReportBlock block;
+  block.ssrc = Read32(p);
+  block.fraction_lost = p[4];
+  std::uint32_t lost = (static_cast<std::uint32_t>(p[5]) << 16) |
+                       (static_cast<std::uint32_t>(p[6]) << 8) | static_cast<std::uint32_t>(p[7]);
+  // Sign-extend the 24-bit field.
+  block.cumulative_lost = static_cast<std::int32_t>(lost << 8) >> 8;
+  block.extended_highest_sequence = Read32(p + 8);
+  block.jitter = Read32(p + 12);
+  block.last_sr = Read32(p + 16);
+  block.delay_since_last_sr = Read32(p + 20);
+  return block;
+}
+
+void WriteReportBlock(unsigned char* p, const RtcpReportBlock& block) {
+  Write32(p, block.ssrc);
+  std::int32_t lost = block.cumulative_lost;
+  if (lost > 0x7FFFFF) {
+    lost = 0x7FFFFF;
+  } else if (lost < -0x800000) {
+    lost = -0x800000;
+  }
+  Write32(p + 4, (static_cast<std::uint32_t>(block.fraction_lost) << 24) |
+                     (static_cast<std::uint32_t>(lost) & 0xFFFFFF));
+  Write32(p + 8, block.extended_highest_sequence);
+  Write32(p + 12, block.jitter);
+  Write32(p + 16, block.last_sr);
+  Write32(p + 20, block.delay_since_last_sr);
+}
+
+// Walks the chunks of an SDES packet, keeping CNAME items.
+bool ParseSdes(const unsigned char* p, std::size_t len, unsigned count, RtcpCompound& out) {
+  std::size_t pos = 0;
+  for (unsigned chunk = 0; chunk < count; ++chunk) {
+    if (pos + 4 > len) {
+      return false;
+    }
+    std::uint32_t ssrc = Read32(p + pos);
+    pos += 4;
+    while (true) {
+      if (pos >= len) {
+        return false;
+      }
+      std::uint8_t type = p[pos];
+      if (type == kSdesEnd) {
+        // The item list ends with a null octet, padded to a 32-bit boundary.
+        pos = (pos + 4) & ~std::size_t(3);
+        break;
+      }
+      if (pos + 2 > len || pos + 2 + p[pos + 1] > len) {
+        return false;
+      }
+      std::size_t item_len = p[pos + 1];
+      if (type == kSdesCname) {
+        out.cnames.emplace_back(ssrc,
+                                std::string(reinterpret_cast<const char*>(p + pos + 2), item_len));
+      }
+      pos += 2 + item_len;
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+void RtcpCompound::Clear() {
+  sender_reports.clear();
+  report_blocks.clear();
+  cnames.clear();
+  bye_ssrcs.clear();
+}
+
+bool IsRtcp(const char* data, std::size_t len) {
+  if (len < 8) {
+    return false;
+  }
+  const unsigned char* p = reinterpret_cast<const unsigned char*>(data);
+  return (p[0] >> 6) == 2 && p[1] >= kRtcpSenderReport && p[1] <= kRtcpApp;
+}
+
+bool ParseRtcp(const char* data, std::size_t len, RtcpCompound& out) {
+  const unsigned char* p = reinterpret_cast<const unsigned char*>(data);
+  std::size_t pos = 0;
+  while (pos < len) {
+    if (pos + kRtcpHeaderSize > len || (p[pos] >> 6) != 2) {
+      return false;
+    }
+    bool padding = (p[pos] & 0x20) != 0;
+    unsigned count = p[pos] & 0x1F;
+    std::uint8_t type = p[pos + 1];
+    std::size_t size = (((static_cast<std::size_t>(p[pos + 2]) << 8) | p[pos + 3]) + 1) * 4;
+    if (pos + size > len) {
+      return false;
+    }
+    const unsigned char* body = p + pos + kRtcpHeaderSize;
+    std::size_t body_len = size - kRtcpHeaderSize;
+    if (padding) {
+      std::size_t pad = p[pos + size - 1];
+      if (pad == 0 || pad > body_len) {
+        return false;
+      }
+      body_len -= pad;
+    }
+    switch (type) {
+      case kRtcpSenderReport:
+      case kRtcpReceiverReport: {
+        std::size_t fixed = 4 + (type == kRtcpSenderReport ? kSenderInfoSize : 0);
+        if (body_len < fixed + count * kReportBlockSize) {
+          return false;
+        }
+        std::uint32_t ssrc = Read32(body);
+        if (type == kRtcpSenderReport) {
+          RtcpCompound::SenderReport report;
+          report.ssrc = ssrc;
+          report.info.ntp_timestamp =
+              (static_cast<std::uint64_t>(Read32(body + 4)) << 32) | Read32(body + 8);
+          report.info.rtp_timestamp = Read32(body + 12);
+          report.info.packet_count = Read32(body + 16);
+          report.info.octet_count = Read32(body + 20);
+          out.sender_reports.push_back(report);
+        }
+        for (unsigned i = 0; i < count; ++i) {
+          out.report_blocks.emplace_back(ssrc,
+                                         ReadReportBlock(body + fixed + i * kReportBlockSize));
+        }
+        break;
+      }
+      case kRtcpSourceDescription:
+        if (!ParseSdes(body, body_len, count, out)) {
+          return false;
+        }
+        break;
+      case kRtcpBye:
+        if (body_len < count * 4) {
+          return false;
+        }
+        for (unsigned i = 0; i < count; ++i) {
+          out.bye_ssrcs.push_back(Read32(body + i * 4));
+        }
+        break;
+      default:
+        // APP and types this server has no use for.
+        break;
+    }
+    pos += size;
+  }
+  return true;
+}
+
+std::uint64_t NextRtcpReportMs(std::uint64_t now_ms, std::uint64_t interval_ms,
+                               std::uint32_t random) {
+  if (interval_ms == 0) {
+    return std::numeric_limits<std::uint64_t>::max();
+  }
+  return now_ms + interval_ms / 2 + random % (interval_ms + 1);
+}
+
+RtcpReportBlock MakeRtcpReportBlock(std::uint32_t ssrc, const RtpStreamStats& stats,
+                                    std::uint64_t expected_prior,
+                                    std::uint64_t received_prior) {
+  RtcpReportBlock block;
+  block.ssrc = ssrc;
+  std::int64_t expected_interval = static_cast<std::int64_t>(stats.expected - expected_prior);
+  std::int64_t received_interval = static_cast<std::int64_t>(stats.received - received_prior);
+  std::int64_t lost_interval = expected_interval - received_interval;
+  if (expected_interval > 0 && lost_interval > 0) {
+    block.fraction_lost = static_cast<std::uint8_t>((lost_interval << 8) / expected_interval);
+  }
+  block.cumulative_lost = static_cast<std::int32_t>(
+      std::max<std::int64_t>(-0x800000, std::min<std::int64_t>(0x7FFFFF, stats.lost)));
+  block.extended_highest_sequence = stats.extended_max_sequence;
+  block.jitter = static_cast<std::uint32_t>(stats.jitter);
+  return block;
+}
+
+std::size_t BuildRtcpReport(std::uint32_t ssrc, const RtcpSenderInfo* info,
+                            const RtcpReportBlock* blocks, std::size_t block_count,
+                            char* out, std::size_t capacity) {
+  if (block_count > kMaxReportBlocks) {
+    block_count = kMaxReportBlocks;
+  }
+  std::size_t size = kRtcpHeaderSize + 4 + (info ? kSenderInfoSize : 0) +
+                     block_count * kReportBlockSize;
+  if (size > capacity) {
+    return 0;
+  }
+  unsigned char* p = reinterpret_cast<unsigned char*>(out);
+  p[0] = static_cast<unsigned char>(0x80 | block_count);
+  p[1] = info ? kRtcpSenderReport : kRtcpReceiverReport;
+  std::size_t words = size / 4 - 1;
+  p[2] = static_cast<unsigned char>(words >> 8);
+  p[3] = static_cast<unsigned char>(words);
+  Write32(p + 4, ssrc);
+  unsigned char* next = p + 8;
+  if (info) {
+    Write32(next, static_cast<std::uint32_t>(info->ntp_timestamp >> 32));
+    Write32(next + 4, static_cast<std::uint32_t>(info->ntp_timestamp));
+    Write32(next + 8, info->rtp_timestamp);
+    Write32(next + 12, info->packet_count);
+    Write32(next + 16, info->octet_count);
+    next += kSenderInfoSize;
+  }
+  for (std::size_t i = 0; i < block_count; ++i) {
+    WriteReportBlock(next + i * kReportBlockSize, blocks[i]);
+  }
+  return size;
+}
+
+std::size_t BuildRtcpSdes(std::uint32_t ssrc, const std::string& cname, char* out,
+                          std::size_t capacity) {
+  std::size_t cname_len = std::min<std::size_t>(cname.size(), 255);
+  // Header, SSRC, the CNAME item and the null octet ending the item list,
+  // padded to a 32-bit boundary.
+  std::size_t size = (kRtcpHeaderSize + 4 + 2 + cname_len + 1 + 3) & ~std::size_t(3);
+  if (size > capacity) {
+    return 0;
+  }
+  unsigned char* p = reinterpret_cast<unsigned char*>(out);
+  p[0] = 0x81;
+  p[1] = kRtcpSourceDescription;
+  std::size_t words = size / 4 - 1;
+  p[2] = static_cast<unsigned char>(words >> 8);
+  p[3] = static_cast<unsigned char>(words);
+  Write32(p + 4, ssrc);
+  p[8] = kSdesCname;
+  p[9] = static_cast<unsigned char>(cname_len);
+  std::copy(cname.data(), cname.data() + cname_len, p + 10);
+  std::fill(p + 10 + cname_len, p + size, static_cast<unsigned char>(kSdesEnd));
+  return size;
+}
+
+}  // namespace backend
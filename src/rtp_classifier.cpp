@@ -0,0 +1,223 @@
+#include "rtp_classifier.h"
+
+#include "rtcp.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include <arpa/inet.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace backend {
+
+namespace {
+
+constexpr std::size_t kRtpFixedHeaderSize = 12;
+constexpr std::size_t kRtcpMinSize = 8;
+constexpr std::size_t kStunHeaderSize = 20;
+constexpr std::size_t kLanes = 16;
+
+std::uint16_t LoadBe16(const char* p) {
+  std::uint16_t value;
+  std::memcpy(&value, p, sizeof(value));
+  return ntohs(value);
+}
+
+std::uint32_t LoadBe32(const char* p) {
+  std::uint32_t value;
+  std::memcpy(&value, p, sizeof(value));
+  return ntohl(value);
+}
+
+// Header length including CSRCs and extension, or 0 when the packet is too
+// short for them.
+std::size_t RtpHeaderLength(const char* data, std::size_t len, std::uint8_t first) {
+  std::size_t header_len = kRtpFixedHeaderSize + static_cast<std::size_t>(first & 0x0F) * 4;
+  if (len < header_len) {
+    return 0;
+  }
+  if ((first & 0x10) != 0) {
+    if (len < header_len + 4) {
+      return 0;
+    }
+    header_len += 4 + static_cast<std::size_t>(LoadBe16(data + header_len + 2)) * 4;
+    if (len < header_len) {
+      return 0;
+    }
+  }
+  return header_len;
+}
+
+// STUN: top two bits clear, the magic cookie, and a length that accounts
+// for the whole datagram.
+bool IsStun(const char* data, std::size_t len) {
+  if (len < kStunHeaderSize || (static_cast<unsigned char>(data[0]) & 0xC0) != 0) {
+    return false;
+  }
+  std::size_t body = LoadBe16(data + 2);
+  return (body & 3) == 0 && kStunHeaderSize + body == len &&
+         LoadBe32(data + 4) == kStunMagicCookie;
+}
+
+struct LaneMasks {
+  std::uint32_t rtcp;
+  std::uint32_t rtp;
+  std::uint32_t stun;
+};
+
+// Bit i is set where lane i may be of that class. Unused lanes have length
+// 0 and match nothing.
+LaneMasks HeaderMasks(const std::uint8_t* first, const std::uint8_t* second,
+                      const std::uint8_t* lens) {
+  LaneMasks masks;
+#if defined(__SSE2__)
+  __m128i b0 = _mm_load_si128(reinterpret_cast<const __m128i*>(first));
+  __m128i b1 = _mm_load_si128(reinterpret_cast<const __m128i*>(second));
+  __m128i len = _mm_load_si128(reinterpret_cast<const __m128i*>(lens));
+  __m128i version = _mm_and_si128(b0, _mm_set1_epi8(static_cast<char>(0xC0)));
+  __m128i v2 = _mm_cmpeq_epi8(version, _mm_set1_epi8(static_cast<char>(0x80)));
+  __m128i v0 = _mm_cmpeq_epi8(version, _mm_setzero_si128());
+  // Unsigned a >= b as max(a, b) == a, and a <= b as min(a, b) == a.
+  auto at_least = [&](std::size_t size) {
+    return _mm_cmpeq_epi8(_mm_max_epu8(len, _mm_set1_epi8(static_cast<char>(size))), len);
+  };
+  __m128i type = _mm_sub_epi8(b1, _mm_set1_epi8(static_cast<char>(kRtcpSenderReport)));
+  __m128i rtcp_type = _mm_cmpeq_epi8(
+      _mm_min_epu8(type, _mm_set1_epi8(static_cast<char>(kRtcpApp - kRtcpSenderReport))), type);
+  __m128i rtcp = _mm_and_si128(_mm_and_si128(v2, rtcp_type), at_least(kRtcpMinSize));
+  __m128i rtp = _mm_andnot_si128(rtcp, _mm_and_si128(v2, at_least(kRtpFixedHeaderSize)));
+  __m128i stun = _mm_and_si128(v0, at_least(kStunHeaderSize));
+  masks.rtcp = static_cast<std::uint32_t>(_mm_movemask_epi8(rtcp));
+  masks.rtp = static_cast<std::uint32_t>(_mm_movemask_epi8(rtp));
+  masks.stun = static_cast<std::uint32_t>(_mm_movemask_epi8(stun));
+#else
+  masks.rtcp = 0;
+  masks.rtp = 0;
+  masks.stun = 0;
+  for (std::size_t i = 0; i < kLanes; ++i) {
+    unsigned version = first[i] >> 6;
+    bool rtcp = version == 2 && second[i] >= kRtcpSenderReport && second[i] <= kRtcpApp &&
+                lens[i] >= kRtcpMinSize;
+    masks.rtcp |= (rtcp ? 1u : 0u) << i;
+    masks.rtp |= (version == 2 && !rtcp && lens[i] >= kRtpFixedHeaderSize ? 1u : 0u) << i;
+    masks.stun |= (version == 0 && lens[i] >= kStunHeaderSize ? 1u : 0u) << i;
+  }
+#endif
+  return masks;
+}
+
+}  // namespace
+
+bool ParseRtpHeader(const char* data, std::size_t len, RtpHeader& out) {
+  if (len < kRtpFixedHeaderSize) {
+    return false;
+  }
+  std::uint8_t b0 = static_cast<std::uint8_t>(data[0]);
+  out.version = static_cast<std::uint8_t>(b0 >> 6);
+  if (out.version != 2) {
+    return false;
+  }
+  out.padding = (b0 & 0x20) != 0;
+  out.extension = (b0 & 0x10) != 0;
+  out.csrc_count = static_cast<std::uint8_t>(b0 & 0x0F);
+  std::uint8_t b1 = static_cast<std::uint8_t>(data[1]);
+  out.marker = (b1 & 0x80) != 0;
+  out.payload_type = static_cast<std::uint8_t>(b1 & 0x7F);
+  out.sequence_number = LoadBe16(data + 2);
+  out.timestamp = LoadBe32(data + 4);
+  out.ssrc = LoadBe32(data + 8);
+  out.header_length = RtpHeaderLength(data, len, b0);
+  return out.header_length != 0;
+}
+
+void PacketBatch::Resize(std::size_t count) {
+  kind.resize(count);
+  first_byte.resize(count);
+  payload_type.resize(count);
+  marker.resize(count);
+  sequence_number.resize(count);
+  timestamp.resize(count);
+  ssrc.resize(count);
+  header_length.resize(count);
+}
+
+RtpHeader PacketBatch::Header(std::size_t i) const {
+  RtpHeader header;
+  header.version = static_cast<std::uint8_t>(first_byte[i] >> 6);
+  header.padding = (first_byte[i] & 0x20) != 0;
+  header.extension = (first_byte[i] & 0x10) != 0;
+  header.csrc_count = static_cast<std::uint8_t>(first_byte[i] & 0x0F);
+  header.marker = marker[i] != 0;
+  header.payload_type = payload_type[i];
+  header.sequence_number = sequence_number[i];
+  header.timestamp = timestamp[i];
+  header.ssrc = ssrc[i];
+  header.header_length = header_length[i];
+  return header;
+}
+
+PacketClass ClassifyPacket(const char* data, std::size_t len, RtpHeader& header) {
+  if (IsRtcp(data, len)) {
+    return PacketClass::Rtcp;
+  }
+  if (ParseRtpHeader(data, len, header)) {
+    return PacketClass::Rtp;
+  }
+  return IsStun(data, len) ? PacketClass::Stun : PacketClass::Other;
+}
+
+void ClassifyPackets(const char* const* data, const std::size_t* len, std::size_t count,
+                     PacketBatch& out) {
+  out.Resize(count);
+  alignas(16) std::uint8_t first[kLanes];
+  alignas(16) std::uint8_t second[kLanes];
+  alignas(16) std::uint8_t lens[kLanes];
+  for (std::size_t base = 0; base < count; base += kLanes) {
+    std::size_t lanes = std::min(kLanes, count - base);
+    // Gather the two leading bytes and the length, capped to a byte, which
+    // is all the class checks need.
+    for (std::size_t lane = 0; lane < kLanes; ++lane) {
+      std::size_t size = lane < lanes ? len[base + lane] : 0;
+      first[lane] = size > 0 ? static_cast<std::uint8_t>(data[base + lane][0]) : 0;
+      second[lane] = size > 1 ? static_cast<std::uint8_t>(data[base + lane][1]) : 0;
+      lens[lane] = static_cast<std::uint8_t>(std::min<std::size_t>(size, 255));
+    }
+    LaneMasks masks = HeaderMasks(first, second, lens);
+    std::uint32_t used = (1u << lanes) - 1;
+    for (std::size_t lane = 0; lane < lanes; ++lane) {
+      out.first_byte[base + lane] = first[lane];
+      out.kind[base + lane] =
+          ((masks.rtcp >> lane) & 1) != 0 ? PacketClass::Rtcp : PacketClass::Other;
+    }
+    // Only the candidate lanes are visited; a mixed batch costs no
+    // mispredicted branch per packet.
+    for (std::uint32_t rtp = masks.rtp & used; rtp != 0; rtp &= rtp - 1) {
+      std::size_t lane = static_cast<std::size_t>(__builtin_ctz(rtp));
+      std::size_t i = base + lane;
+      std::size_t header_len = (first[lane] & 0x1F) == 0
+                                   ? kRtpFixedHeaderSize
+                                   : RtpHeaderLength(data[i], len[i], first[lane]);
+      if (header_len == 0) {
+        continue;
+      }
+      out.kind[i] = PacketClass::Rtp;
+      out.marker[i] = static_cast<std::uint8_t>(second[lane] >> 7);
+      out.payload_type[i] = static_cast<std::uint8_t>(second[lane] & 0x7F);
+      out.sequence_number[i] = LoadBe16(data[i] + 2);
+      out.timestamp[i] = LoadBe32(data[i] + 4);
+      out.ssrc[i] = LoadBe32(data[i] + 8);
+      out.header_length[i] = static_cast<std::uint32_t>(header_len);
+    }
+    for (std::uint32_t stun = masks.stun & used; stun != 0; stun &= stun - 1) {
+      std::size_t i = base + static_cast<std::size_t>(__builtin_ctz(stun));
+      if (IsStun(data[i], len[i])) {
+        out.kind[i] = PacketClass::Stun;
+      }
+    }
+  }
+}
+
+}  // namespace backend
@@ -0,0 +1,79 @@
+#include "rtp_forward_table.h"
+
+#include <algorithm>
+#include <mutex>
+
+namespace backend {
+
+RtpForwardTable::RtpForwardTable(std::uint32_t sample_every)
+    : sample_every_(sample_every),
+      size_(0) {
+}
+
+bool RtpForwardTable::Add(std::uint32_t ssrc, const RtpForwardTarget& target) {
+  Shard& shard = ShardOf(ssrc);
+  std::unique_lock<std::shared_mutex> lock(shard.mutex);
+  auto result = shard.rules.try_emplace(ssrc);
+  std::vector<RtpForwardTarget>& targets = result.first->second.targets;
+  if (std::find(targets.begin(), targets.end(), target) != targets.end()) {
+    return false;
+  }
+  targets.push_back(target);
+  if (result.second) {
+    size_.fetch_add(1, std::memory_order_relaxed);
+  }
+  return true;
+}
+
+void RtpForwardTable::Remove(std::uint32_t ssrc) {
+  Shard& shard = ShardOf(ssrc);
+  std::unique_lock<std::shared_mutex> lock(shard.mutex);
+  if (shard.rules.erase(ssrc) > 0) {
+    size_.fetch_sub(1, std::memory_order_relaxed);
+  }
+}
+
+void RtpForwardTable::RemoveSession(std::uint64_t session_id) {
+  for (Shard& shard : shards_) {
+    std::unique_lock<std::shared_mutex> lock(shard.mutex);
+    for (auto it = shard.rules.begin(); it != shard.rules.end();) {
+      auto& targets = it->second.targets;
+      targets.erase(std::remove_if(targets.begin(), targets.end(),
+                                   [&](const RtpForwardTarget& target) {
+                                     return target.session_id == session_id;
+                                   }),
+                    targets.end());
+      if (targets.empty()) {
+        it = shard.rules.erase(it);
+        size_.fetch_sub(1, std::memory_order_relaxed);
+      } else {
+        ++it;
+      }
+    }
+  }
+}
+
+bool RtpForwardTable::Lookup(std::uint32_t ssrc, std::vector<RtpForwardTarget>& out,
+                             bool* sampled) {
+  out.clear();
+  if (sampled) {
+    *sampled = false;
+  }
+  if (size_.load(std::memory_order_relaxed) == 0) {
+    return false;
+  }
+  Shard& shard = ShardOf(ssrc);
+  std::shared_lock<std::shared_mutex> lock(shard.mutex);
+  auto it = shard.rules.find(ssrc);
+  if (it == shard.rules.end()) {
+    return false;
+  }
+  out.assign(it->second.targets.begin(), it->second.targets.end());
+  std::uint64_t packet = it->second.packets.fetch_add(1, std::memory_order_relaxed);
+  if (sampled) {
+    *sampled = sample_every_ > 0 && packet % sample_every_ == 0;
+  }
+  return true;
+}
+
+}  // namespace backend
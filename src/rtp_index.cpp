@@ -0,0 +1,213 @@
+#include "rtp_index.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <sstream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace backend {
+
+namespace {
+
+RtpIndexHeader MakeHeader(std::uint32_t ssrc) {
+  RtpIndexHeader header;
+  std::memcpy(header.magic, kRtpIndexMagic, sizeof(header.magic));
+  header.version = kRtpIndexVersion;
+  header.byte_order = kRtpIndexByteOrder;
+  header.header_size = sizeof(RtpIndexHeader);
+  header.record_size = sizeof(RtpIndexRecord);
+  header.ssrc = ssrc;
+  header.reserved = 0;
+  return header;
+}
+
+}  // namespace
+
+std::uint64_t RtpTimestampExtender::Extend(std::uint32_t timestamp) {
+  if (!started_) {
+    started_ = true;
+    highest_ = (std::uint64_t(1) << 32) + timestamp;
+    return highest_;
+  }
+  std::int32_t delta = static_cast<std::int32_t>(timestamp - static_cast<std::uint32_t>(highest_));
+  std::uint64_t extended = static_cast<std::uint64_t>(static_cast<std::int64_t>(highest_) + delta);
+  if (delta > 0) {
+    highest_ = extended;
+  }
+  return extended;
+}
+
+RtpIndexWriter::RtpIndexWriter(std::uint32_t ssrc, std::uint64_t checkpoint_interval_ms)
+    : ssrc_(ssrc),
+      checkpoint_interval_ms_(checkpoint_interval_ms),
+      has_previous_(false),
+      previous_timestamp_(0),
+      has_checkpoint_(false),
+      last_checkpoint_ms_(0) {
+}
+
+void RtpIndexWriter::Append(std::uint16_t sequence, std::uint32_t timestamp,
+                            std::uint8_t payload_type, bool marker, std::uint64_t wall_ms,
+                            std::uint64_t offset, std::uint32_t length, std::string& out) {
+  if (offset == 0) {
+    RtpIndexHeader header = MakeHeader(ssrc_);
+    out.append(reinterpret_cast<const char*>(&header), sizeof(header));
+  }
+  RtpIndexRecord record;
+  record.wall_ms = wall_ms;
+  record.extended_timestamp = timestamps_.Extend(timestamp);
+  record.offset = offset;
+  record.length = length;
+  record.sequence = sequence;
+  record.payload_type = payload_type;
+  record.flags = marker ? kRtpIndexMarker : 0;
+  if (!has_previous_ || record.extended_timestamp != previous_timestamp_) {
+    record.flags |= kRtpIndexFrameStart;
+    if (!has_checkpoint_ || wall_ms >= last_checkpoint_ms_ + checkpoint_interval_ms_) {
+      record.flags |= kRtpIndexCheckpoint;
+      has_checkpoint_ = true;
+      last_checkpoint_ms_ = wall_ms;
+    }
+  }
+  has_previous_ = true;
+  previous_timestamp_ = record.extended_timestamp;
+  out.append(reinterpret_cast<const char*>(&record), sizeof(record));
+}
+
+RtpIndexReader::RtpIndexReader()
+    : map_(nullptr),
+      map_size_(0),
+      header_(nullptr),
+      records_(nullptr),
+      size_(0) {
+}
+
+RtpIndexReader::~RtpIndexReader() {
+  Close();
+}
+
+bool RtpIndexReader::Open(const std::string& path) {
+  Close();
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat st;
+  if (::fstat(fd, &st) != 0 || static_cast<std::size_t>(st.st_size) < sizeof(RtpIndexHeader)) {
+    ::close(fd);
+    return false;
+  }
+  std::size_t size = static_cast<std::size_t>(st.st_size);
+  void* map = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (map == MAP_FAILED) {
+    return false;
+  }
+  const RtpIndexHeader* header = static_cast<const RtpIndexHeader*>(map);
+  if (std::memcmp(header->magic, kRtpIndexMagic, sizeof(header->magic)) != 0 ||
+      header->version != kRtpIndexVersion || header->byte_order != kRtpIndexByteOrder ||
+      header->header_size != sizeof(RtpIndexHeader) ||
+      header->record_size != sizeof(RtpIndexRecord)) {
+    ::munmap(map, size);
+    return false;
+  }
+  ::madvise(map, size, MADV_RANDOM);
+  map_ = map;
+  map_size_ = size;
+  header_ = header;
+  records_ = reinterpret_cast<const RtpIndexRecord*>(static_cast<const char*>(map) +
+                                                     sizeof(RtpIndexHeader));
+  size_ = (size - sizeof(RtpIndexHeader)) / sizeof(RtpIndexRecord);
+  return true;
+}
+
+void RtpIndexReader::Close() {
+  if (map_) {
+    ::munmap(map_, map_size_);
+  }
+  map_ = nullptr;
+  map_size_ = 0;
+  header_ = nullptr;
+  records_ = nullptr;
+  size_ = 0;
+}
+
+std::size_t RtpIndexReader::SeekWallClock(std::uint64_t wall_ms) const {
+  const RtpIndexRecord* it =
+      std::lower_bound(records_, records_ + size_, wall_ms,
+                       [](const RtpIndexRecord& record, std::uint64_t key) {
+                         return record.wall_ms < key;
+                       });
+  return static_cast<std::size_t>(it - records_);
+}
+
+std::size_t RtpIndexReader::SeekTimestamp(std::uint64_t extended_timestamp) const {
+  const RtpIndexRecord* it =
+      std::lower_bound(records_, records_ + size_, extended_timestamp,
+                       [](const RtpIndexRecord& record, std::uint64_t key) {
+                         return record.extended_timestamp < key;
+                       });
+  return static_cast<std::size_t>(it - records_);
+}
+
+std::size_t RtpIndexReader::CheckpointBefore(std::size_t i) const {
+  if (size_ == 0) {
+    return 0;
+  }
+  for (std::size_t pos = std::min(i, size_ - 1) + 1; pos-- > 0;) {
+    if ((records_[pos].flags & kRtpIndexCheckpoint) != 0) {
+      return pos;
+    }
+  }
+  return 0;
+}
+
+bool ConvertRtpTextIndex(const std::string& text_path, const std::string& binary_path) {
+  std::ifstream input(text_path);
+  if (!input) {
+    return false;
+  }
+  std::string out;
+  std::string line;
+  std::unique_ptr<RtpIndexWriter> writer;
+  while (std::getline(input, line)) {
+    if (line.empty()) {
+      continue;
+    }
+    std::istringstream fields(line);
+    std::uint32_t sequence = 0;
+    std::uint32_t timestamp = 0;
+    std::uint32_t ssrc = 0;
+    std::uint64_t offset = 0;
+    std::uint32_t length = 0;
+    if (!(fields >> sequence >> timestamp >> ssrc >> offset >> length)) {
+      return false;
+    }
+    if (!writer) {
+      writer = std::make_unique<RtpIndexWriter>(ssrc);
+      // The header goes first even if the text index starts mid-recording.
+      if (offset != 0) {
+        RtpIndexHeader header = MakeHeader(ssrc);
+        out.append(reinterpret_cast<const char*>(&header), sizeof(header));
+      }
+    }
+    // No wall time in the text format; checkpoints fall on the first frame.
+    writer->Append(static_cast<std::uint16_t>(sequence), timestamp, 0, false, 0, offset, length,
+                   out);
+  }
+  if (!writer) {
+    RtpIndexHeader header = MakeHeader(0);
+    out.append(reinterpret_cast<const char*>(&header), sizeof(header));
+  }
+  std::ofstream output(binary_path, std::ios::binary | std::ios::trunc);
+  output.write(out.data(), static_cast<std::streamsize>(out.size()));
+  return static_cast<bool>(output);
+}
+
+}  // namespace backend
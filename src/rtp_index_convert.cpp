@@ -0,0 +1,33 @@
+#include "rtp_index.h"
+
+#include <iostream>
+#include <string>
+
+// Converts text RTP indexes (rtp/session_N.idx) into the binary format:
+//   backend_rtp_index_convert rtp/session_1.idx [rtp/session_1.ridx]
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    std::cerr << "usage: " << argv[0] << " <text index> [binary index]" << std::endl;
+    return 2;
+  }
+  std::string input = argv[1];
+  std::string output = argc > 2 ? argv[2] : input;
+  if (argc <= 2) {
+    std::size_t dot = output.find_last_of('.');
+    if (dot != std::string::npos && output.find('/', dot) == std::string::npos) {
+      output.erase(dot);
+    }
+    output += ".ridx";
+  }
+  if (!backend::ConvertRtpTextIndex(input, output)) {
+    std::cerr << "failed to convert " << input << std::endl;
+    return 1;
+  }
+  backend::RtpIndexReader reader;
+  if (!reader.Open(output)) {
+    std::cerr << "failed to read back " << output << std::endl;
+    return 1;
+  }
+  std::cout << output << ": " << reader.Size() << " records" << std::endl;
+  return 0;
+}
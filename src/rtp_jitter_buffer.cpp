@@ -0,0 +1,151 @@
+#include "rtp_jitter_buffer.h"
+
+#include <cstdlib>
+#include <limits>
+
+namespace backend {
+
+RtpJitterBuffer::RtpJitterBuffer(std::uint64_t depth_ms, std::uint32_t clock_rate)
+    : depth_ms_(depth_ms),
+      clock_rate_(clock_rate),
+      started_(false),
+      base_(0),
+      highest_(0),
+      last_transit_(0),
+      bad_sequence_(0x10000),
+      next_out_(0),
+      held_highest_(0),
+      held_(0) {
+  if (depth_ms_ > 0) {
+    slots_.resize(kSlotCount);
+  }
+}
+
+std::uint64_t RtpJitterBuffer::Track(std::uint16_t sequence, std::uint32_t timestamp,
+                                     std::uint64_t arrival_ms) {
+  // Arrival time in timestamp units; only differences matter, so it may wrap.
+  std::uint32_t arrival = static_cast<std::uint32_t>(arrival_ms * clock_rate_ / 1000);
+  std::uint32_t transit = arrival - timestamp;
+  std::uint64_t extended;
+  if (!started_) {
+    started_ = true;
+    Restart(sequence);
+    extended = highest_;
+  } else {
+    std::uint16_t delta = static_cast<std::uint16_t>(sequence - static_cast<std::uint16_t>(highest_));
+    if (delta < kMaxDropout) {
+      extended = highest_ + delta;
+      highest_ = extended;
+    } else if (delta <= 0xFFFF - kMaxMisorder) {
+      if (sequence != bad_sequence_) {
+        bad_sequence_ = static_cast<std::uint16_t>(sequence + 1);
+        ++stats_.rejected;
+        return kRejected;
+      }
+      // Two packets in a row: the sender restarted.
+      ++stats_.resyncs;
+      Restart(sequence);
+      extended = highest_;
+    } else {
+      extended = highest_ - (0x10000 - delta);
+      ++stats_.reordered;
+      if (extended < base_) {
+        base_ = extended;
+      }
+    }
+    std::int32_t d = static_cast<std::int32_t>(transit - last_transit_);
+    stats_.jitter += (std::abs(static_cast<double>(d)) - stats_.jitter) / 16.0;
+  }
+  last_transit_ = transit;
+  bad_sequence_ = 0x10000;
+
+  ++stats_.received;
+  stats_.expected = highest_ - base_ + 1;
+  stats_.lost = static_cast<std::int64_t>(stats_.expected) -
+                static_cast<std::int64_t>(stats_.received);
+  stats_.extended_max_sequence = static_cast<std::uint32_t>(highest_ - (std::uint64_t(1) << 16));
+  return extended;
+}
+
+void RtpJitterBuffer::Restart(std::uint16_t sequence) {
+  if (held_ > 0) {
+    for (Slot& slot : slots_) {
+      slot.filled = false;
+    }
+    stats_.late += held_;
+    held_ = 0;
+  }
+  // Start one cycle up so packets from before the first stay positive.
+  base_ = (std::uint64_t(1) << 16) + sequence;
+  highest_ = base_;
+  next_out_ = base_;
+  stats_.received = 0;
+}
+
+bool RtpJitterBuffer::Hold(std::uint64_t extended_sequence, std::uint64_t arrival_ms,
+                           const char* data, std::size_t len, std::uint32_t tag) {
+  if (extended_sequence < next_out_) {
+    ++stats_.late;
+    return false;
+  }
+  if (extended_sequence >= next_out_ + kSlotCount) {
+    // A jump past the whole ring: give up on what is held and restart there.
+    std::uint64_t dropped = held_;
+    for (std::uint64_t seq = next_out_; held_ > 0 && seq <= held_highest_; ++seq) {
+      Slot& slot = SlotOf(seq);
+      if (slot.filled && slot.extended_sequence == seq) {
+        slot.filled = false;
+        --held_;
+      }
+    }
+    stats_.late += dropped;
+    stats_.skipped += extended_sequence - next_out_ - dropped;
+    next_out_ = extended_sequence;
+  }
+  Slot& slot = SlotOf(extended_sequence);
+  if (slot.filled) {
+    ++stats_.duplicates;
+    return false;
+  }
+  slot.filled = true;
+  slot.extended_sequence = extended_sequence;
+  slot.arrival_ms = arrival_ms;
+  slot.tag = tag;
+  slot.data.assign(data, len);
+  if (held_ == 0 || extended_sequence > held_highest_) {
+    held_highest_ = extended_sequence;
+  }
+  ++held_;
+  return true;
+}
+
+std::uint64_t RtpJitterBuffer::NextDueMs() const {
+  if (held_ == 0) {
+    return std::numeric_limits<std::uint64_t>::max();
+  }
+  const Slot& head = slots_[next_out_ & (kSlotCount - 1)];
+  if (head.filled && head.extended_sequence == next_out_) {
+    return head.arrival_ms;
+  }
+  std::uint64_t lowest = 0;
+  std::uint64_t earliest_arrival_ms = 0;
+  ScanHeld(&lowest, &earliest_arrival_ms);
+  return earliest_arrival_ms + depth_ms_;
+}
+
+void RtpJitterBuffer::ScanHeld(std::uint64_t* lowest,
+                               std::uint64_t* earliest_arrival_ms) const {
+  *lowest = held_highest_;
+  *earliest_arrival_ms = std::numeric_limits<std::uint64_t>::max();
+  for (std::uint64_t seq = held_highest_ + 1; seq-- > next_out_;) {
+    const Slot& slot = slots_[seq & (kSlotCount - 1)];
+    if (slot.filled && slot.extended_sequence == seq) {
+      *lowest = seq;
+      if (slot.arrival_ms < *earliest_arrival_ms) {
+        *earliest_arrival_ms = slot.arrival_ms;
+      }
+    }
+  }
+}
+
+}  // namespace backend
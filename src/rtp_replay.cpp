@@ -0,0 +1,169 @@
+#include "rtp_replay.h"
+
+#include <cerrno>
+#include <cstring>
+#include <limits>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace backend {
+
+RtpReplay::RtpReplay()
+    : data_(nullptr),
+      data_size_(0),
+      next_(0),
+      end_(0),
+      start_us_(0),
+      base_timestamp_(0),
+      us_per_tick_(0),
+      sent_(0),
+      send_calls_(0) {
+  std::memset(&to_, 0, sizeof(to_));
+}
+
+RtpReplay::~RtpReplay() {
+  Close();
+}
+
+bool RtpReplay::Open(const std::string& recording) {
+  Close();
+  if (!index_.Open(recording + ".ridx")) {
+    return false;
+  }
+  int fd = ::open((recording + ".bin").c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    index_.Close();
+    return false;
+  }
+  struct stat st;
+  if (::fstat(fd, &st) != 0) {
+    ::close(fd);
+    index_.Close();
+    return false;
+  }
+  std::size_t size = static_cast<std::size_t>(st.st_size);
+  if (size > 0) {
+    void* map = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+      ::close(fd);
+      index_.Close();
+      return false;
+    }
+    // Played front to back: let the kernel read ahead aggressively.
+    ::madvise(map, size, MADV_SEQUENTIAL);
+    data_ = static_cast<const char*>(map);
+    data_size_ = size;
+  }
+  ::close(fd);
+  // The index can run ahead of the payload file while the recorder still
+  // buffers the tail of a live recording.
+  end_ = 0;
+  while (end_ < index_.Size()) {
+    const RtpIndexRecord& record = index_.Record(end_);
+    if (record.offset > data_size_ || record.length > data_size_ - record.offset) {
+      break;
+    }
+    ++end_;
+  }
+  return true;
+}
+
+void RtpReplay::Close() {
+  if (data_) {
+    ::munmap(const_cast<char*>(data_), data_size_);
+  }
+  data_ = nullptr;
+  data_size_ = 0;
+  index_.Close();
+  next_ = 0;
+  end_ = 0;
+  sent_ = 0;
+  send_calls_ = 0;
+}
+
+void RtpReplay::Start(std::uint64_t now_us, double speed, std::uint32_t clock_rate,
+                      std::uint64_t skip_ms) {
+  next_ = 0;
+  if (end_ > 0 && skip_ms > 0 && clock_rate > 0) {
+    std::uint64_t target =
+        index_.Record(0).extended_timestamp + skip_ms * clock_rate / 1000;
+    next_ = index_.CheckpointBefore(index_.SeekTimestamp(target));
+    if (next_ >= end_) {
+      next_ = end_;
+    }
+  }
+  start_us_ = now_us;
+  base_timestamp_ = next_ < end_ ? index_.Record(next_).extended_timestamp : 0;
+  us_per_tick_ = speed > 0 && clock_rate > 0 ? 1e6 / (clock_rate * speed) : 0;
+}
+
+std::uint64_t RtpReplay::NextDueUs() const {
+  if (Done()) {
+    return std::numeric_limits<std::uint64_t>::max();
+  }
+  return DueUs(next_);
+}
+
+std::uint64_t RtpReplay::DueUs(std::size_t i) const {
+  std::uint64_t timestamp = index_.Record(i).extended_timestamp;
+  // Timestamps that go back, as with B-frames, are due at once.
+  if (timestamp <= base_timestamp_) {
+    return start_us_;
+  }
+  return start_us_ +
+         static_cast<std::uint64_t>(static_cast<double>(timestamp - base_timestamp_) *
+                                    us_per_tick_);
+}
+
+std::size_t RtpReplay::SendDue(int fd, const sockaddr_in& to, std::uint64_t now_us,
+                               std::size_t batch_size) {
+  if (batch_size == 0) {
+    batch_size = 1;
+  }
+  if (msgs_.size() < batch_size) {
+    msgs_.resize(batch_size);
+    iov_.resize(batch_size);
+  }
+  to_ = to;
+  std::size_t total = 0;
+  while (next_ < end_ && DueUs(next_) <= now_us) {
+    std::size_t count = 0;
+    while (count < batch_size && next_ + count < end_ && DueUs(next_ + count) <= now_us) {
+      const RtpIndexRecord& record = index_.Record(next_ + count);
+      iov_[count].iov_base = const_cast<char*>(data_ + record.offset);
+      iov_[count].iov_len = record.length;
+      mmsghdr& msg = msgs_[count];
+      std::memset(&msg, 0, sizeof(msg));
+      msg.msg_hdr.msg_name = &to_;
+      msg.msg_hdr.msg_namelen = sizeof(to_);
+      msg.msg_hdr.msg_iov = &iov_[count];
+      msg.msg_hdr.msg_iovlen = 1;
+      ++count;
+    }
+    int n = ::sendmmsg(fd, msgs_.data(), static_cast<unsigned>(count), 0);
+    ++send_calls_;
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      break;
+    }
+    if (n <= 0) {
+      // Any other error loses the first packet, as a network would.
+      ++next_;
+      continue;
+    }
+    next_ += static_cast<std::size_t>(n);
+    sent_ += static_cast<std::size_t>(n);
+    total += static_cast<std::size_t>(n);
+    if (static_cast<std::size_t>(n) < count) {
+      break;
+    }
+  }
+  return total;
+}
+
+}  // namespace backend
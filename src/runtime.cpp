@@ -1,18 +1,28 @@
 #include "runtime.h"
 
 #include "conn.h"
+#include "io_thread.h"
 #include "logger.h"
 #include "lua_vm.h"
-
+#include "recording_segments.h"
+#include "reuseport_steering.h"
+#include "rtp_replay.h"
+#include "tcp_io_thread.h"
+#include "udp_io_thread.h"
+
+#include <algorithm>
+#include <cerrno>
 #include <chrono>
+#include <limits>
+#include <cstring>
 #include <memory>
+#include <random>
 #include <thread>
 #include <utility>
 #include <vector>
 
 #include <arpa/inet.h>
 #include <netinet/in.h>
-#include <sys/epoll.h>
 #include <sys/socket.h>
 #include <unistd.h>
 #include <fcntl.h>
@@ -20,79 +30,14 @@
 #include <sys/stat.h>
 #include <dirent.h>
 #include <fstream>
-#include <unordered_map>
 #include <zlib.h>
 
 namespace backend {
 
 namespace {
 
-std::uint64_t NowMs() {
-  auto now = std::chrono::steady_clock::now();
-  auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch());
-  return static_cast<std::uint64_t>(ms.count());
-}
-
-struct RtpHeader {
-  std::uint8_t version;
-  bool padding;
-  bool extension;
-  std::uint8_t csrc_count;
-  bool marker;
-  std::uint8_t payload_type;
-  std::uint16_t sequence_number;
-  std::uint32_t timestamp;
-  std::uint32_t ssrc;
-  std::size_t header_length;
-};
-
-bool ParseRtpHeader(const char* data, std::size_t len, RtpHeader& out) {
-  if (len < 12) {
-    return false;
-  }
-  unsigned char b0 = static_cast<unsigned char>(data[0]);
-  out.version = static_cast<std::uint8_t>(b0 >> 6);
-  if (out.version != 2) {
-    return false;
-  }
-  out.padding = ((b0 >> 5) & 0x1) != 0;
-  out.extension = ((b0 >> 4) & 0x1) != 0;
-  out.csrc_count = static_cast<std::uint8_t>(b0 & 0x0F);
-  unsigned char b1 = static_cast<unsigned char>(data[1]);
-  out.marker = ((b1 >> 7) & 0x1) != 0;
-  out.payload_type = static_cast<std::uint8_t>(b1 & 0x7F);
-  out.sequence_number =
-      static_cast<std::uint16_t>((static_cast<std::uint16_t>(static_cast<unsigned char>(data[2])) << 8) |
-                                 static_cast<std::uint16_t>(static_cast<unsigned char>(data[3])));
-  out.timestamp =
-      (static_cast<std::uint32_t>(static_cast<unsigned char>(data[4])) << 24) |
-      (static_cast<std::uint32_t>(static_cast<unsigned char>(data[5])) << 16) |
-      (static_cast<std::uint32_t>(static_cast<unsigned char>(data[6])) << 8) |
-      (static_cast<std::uint32_t>(static_cast<unsigned char>(data[7])));
-  out.ssrc =
-      (static_cast<std::uint32_t>(static_cast<unsigned char>(data[8])) << 24) |
-      (static_cast<std::uint32_t>(static_cast<unsigned char>(data[9])) << 16) |
-      (static_cast<std::uint32_t>(static_cast<unsigned char>(data[10])) << 8) |
-      (static_cast<std::uint32_t>(static_cast<unsigned char>(data[11])));
-  std::size_t header_len = 12 + static_cast<std::size_t>(out.csrc_count) * 4;
-  if (len < header_len) {
-    return false;
-  }
-  if (out.extension) {
-    if (len < header_len + 4) {
-      return false;
-    }
-    std::uint16_t ext_len =
-        static_cast<std::uint16_t>((static_cast<std::uint16_t>(static_cast<unsigned char>(data[header_len + 2])) << 8) |
-                                   static_cast<std::uint16_t>(static_cast<unsigned char>(data[header_len + 3])));
-    header_len += 4 + static_cast<std::size_t>(ext_len) * 4;
-    if (len < header_len) {
-      return false;
-    }
-  }
-  out.header_length = header_len;
-  return true;
-}
+// Replays the replay thread plays at once; requests beyond are refused.
+const std::size_t kMaxActiveReplays = 16;
 
 void LoadStateFilesFromDir(LuaVm& vm, const std::string& base, bool v2_encoded) {
   DIR* dir = ::opendir(base.c_str());
@@ -179,14 +124,16 @@ int SetNonBlocking(int fd) {
   return 0;
 }
 
-int CreateTcpListenSocket(std::uint16_t port) {
-  int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+int CreateTcpListenSocket(std::uint16_t port, int backlog, bool reuse_port) {
+  int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
   if (fd < 0) {
     return -1;
   }
   int on = 1;
   ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
-  ::setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on));
+  if (reuse_port) {
+    ::setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on));
+  }
   sockaddr_in addr;
   addr.sin_family = AF_INET;
   addr.sin_addr.s_addr = htonl(INADDR_ANY);
@@ -195,7 +142,7 @@ int CreateTcpListenSocket(std::uint16_t port) {
     ::close(fd);
     return -1;
   }
-  if (::listen(fd, 128) < 0) {
+  if (::listen(fd, backlog) < 0) {
     ::close(fd);
     return -1;
   }
@@ -229,39 +176,92 @@ int CreateUdpSocket(std::uint16_t port) {
   return fd;
 }
 
-std::string IpFromSockaddr(const sockaddr_in& addr) {
-  char buffer[64];
-  const char* result = ::inet_ntop(AF_INET, &addr.sin_addr, buffer, sizeof(buffer));
-  if (!result) {
-    return {};
+std::shared_ptr<ProtocolHandler> MakeTcpFramingHandler(const AppConfig& config) {
+  std::shared_ptr<ProtocolHandler> handler =
+      ProtocolRegistry::Instance().GetHandler(config.tcp_framing);
+  if (handler) {
+    return handler;
+  }
+  if (config.tcp_framing == "raw") {
+    return std::make_shared<RawHandler>();
+  }
+  if (config.tcp_framing == "length_prefix") {
+    return std::make_shared<LengthPrefixHandler>(config.tcp_frame_length_bytes,
+                                                 config.tcp_max_message_size);
+  }
+  if (config.tcp_framing == "delimiter") {
+    return std::make_shared<DelimiterHandler>(config.tcp_frame_delimiter,
+                                              config.tcp_max_message_size);
   }
-  return std::string(result);
+  throw std::runtime_error("unknown tcp framing: " + config.tcp_framing);
 }
 
 }  // namespace
 
 Runtime::Runtime(const AppConfig& config)
     : config_(config),
-      running_(false) {
+      running_(false),
+      shared_listen_fd_(-1),
+      rtp_forwards_(config.rtp_forward_sample_every),
+      rtcp_ssrc_(std::random_device()()) {
+  tcp_framing_ = MakeTcpFramingHandler(config_);
+  worker_to_log_ =
+      std::make_unique<MpscQueue<LogTask>>(config_.queue_size_worker_to_log);
+  log_notifier_ = std::make_unique<EventNotifier>();
+  worker_to_log_->SetNotifier(log_notifier_.get());
+  worker_to_replay_ =
+      std::make_unique<MpscQueue<ReplayTask>>(config_.queue_size_worker_to_io);
+  replay_notifier_ = std::make_unique<EventNotifier>();
+  worker_to_replay_->SetNotifier(replay_notifier_.get());
+  replay_counters_ = std::make_unique<UdpIoCounters>();
+  for (int i = 0; i < config_.disk_threads; ++i) {
+    disk_notifiers_.push_back(std::make_unique<EventNotifier>());
+    recorder_counters_.push_back(std::make_unique<RecorderCounters>());
+  }
+  std::vector<MpscQueue<GenericTask>*> to_tcp_io;
+  for (int i = 0; i < config_.tcp_io_threads; ++i) {
+    worker_to_tcp_io_.push_back(
+        std::make_unique<MpscQueue<GenericTask>>(config_.queue_size_worker_to_io));
+    tcp_io_notifiers_.push_back(std::make_unique<EventNotifier>());
+    tcp_io_counters_.push_back(std::make_unique<TcpIoCounters>());
+    worker_to_tcp_io_.back()->SetNotifier(tcp_io_notifiers_.back().get());
+    to_tcp_io.push_back(worker_to_tcp_io_.back().get());
+  }
+  std::vector<MpscQueue<GenericTask>*> to_udp_io;
+  for (int i = 0; i < config_.udp_io_threads; ++i) {
+    worker_to_udp_io_.push_back(
+        std::make_unique<MpscQueue<GenericTask>>(config_.queue_size_worker_to_io));
+    udp_io_notifiers_.push_back(std::make_unique<EventNotifier>());
+    udp_io_counters_.push_back(std::make_unique<UdpIoCounters>());
+    worker_to_udp_io_.back()->SetNotifier(udp_io_notifiers_.back().get());
+    to_udp_io.push_back(worker_to_udp_io_.back().get());
+    rtcp_to_udp_io_.push_back(
+        std::make_unique<MpscQueue<RtcpTask>>(config_.queue_size_worker_to_io));
+    rtcp_to_udp_io_.back()->SetNotifier(udp_io_notifiers_.back().get());
+  }
   for (int i = 0; i < config_.worker_threads; ++i) {
     io_to_worker_.push_back(
         std::make_unique<MpscQueue<Event>>(config_.queue_size_io_to_worker));
-    worker_to_io_.push_back(
-        std::make_unique<MpscQueue<GenericTask>>(config_.queue_size_worker_to_io));
+    worker_notifiers_.push_back(std::make_unique<EventNotifier>());
+    worker_counters_.push_back(std::make_unique<WorkerCounters>());
+    io_to_worker_.back()->SetNotifier(worker_notifiers_.back().get());
     worker_to_disk_.push_back(
         std::make_unique<MpscQueue<DiskTask>>(config_.queue_size_worker_to_disk));
+    worker_to_disk_.back()->SetNotifier(
+        disk_notifiers_[static_cast<std::size_t>(i % config_.disk_threads)].get());
     auto vm = std::make_unique<LuaVm>(config_.lua_main_script,
-                                      worker_to_io_.back().get(),
+                                      to_tcp_io,
+                                      to_udp_io,
                                       worker_to_disk_.back().get(),
                                       worker_to_log_.get(),
+                                      worker_to_replay_.get(),
+                                      &rtp_forwards_,
                                       i);
     if (!vm->Init()) {
       throw std::runtime_error("failed to initialize lua vm");
     }
     lua_vms_.push_back(std::move(vm));
   }
-  worker_to_log_ =
-      std::make_unique<MpscQueue<LogTask>>(config_.queue_size_worker_to_log);
   if (!lua_vms_.empty()) {
     LoadStateFiles(*lua_vms_[0]);
   }
@@ -276,16 +276,46 @@ void Runtime::Start() {
   if (running_.exchange(true)) {
     return;
   }
+  // Segments a stop or crash left unfinished are complete as far as they go.
+  for (const char* dir : {kRtpRecordingDir, kUdpRecordingDir}) {
+    std::size_t sealed = SealLeftoverSegments(dir);
+    if (sealed > 0) {
+      GetLogger()->info("sealed {} unfinished recording segments in {}", sealed, dir);
+    }
+    if (config_.recording_retention_bytes > 0) {
+      std::uint64_t freed = 0;
+      EnforceRetention(dir, config_.recording_retention_bytes, &freed);
+    }
+  }
   StartTcpIoThreads();
   StartUdpIoThreads();
   StartWorkerThreads();
   StartDiskThreads();
   StartLogThreads();
   StartTimerThreads();
+  StartReplayThread();
 }
 
 void Runtime::Stop() {
   running_.store(false);
+  for (auto& notifier : worker_notifiers_) {
+    notifier->Signal();
+  }
+  for (auto& notifier : disk_notifiers_) {
+    notifier->Signal();
+  }
+  for (auto& notifier : tcp_io_notifiers_) {
+    notifier->Signal();
+  }
+  for (auto& notifier : udp_io_notifiers_) {
+    notifier->Signal();
+  }
+  if (log_notifier_) {
+    log_notifier_->Signal();
+  }
+  if (replay_notifier_) {
+    replay_notifier_->Signal();
+  }
 }
 
 void Runtime::Join() {
@@ -319,15 +349,142 @@ void Runtime::Join() {
       t.join();
     }
   }
+  if (replay_thread_.joinable()) {
+    replay_thread_.join();
+  }
+  if (shared_listen_fd_ >= 0) {
+    ::close(shared_listen_fd_);
+    shared_listen_fd_ = -1;
+  }
+}
+
+TcpIoStats Runtime::GetTcpIoStats() const {
+  TcpIoStats stats;
+  stats.accepted = 0;
+  stats.send_messages = 0;
+  stats.send_syscalls = 0;
+  stats.received_messages = 0;
+  stats.io_syscalls = 0;
+  for (const auto& counters : tcp_io_counters_) {
+    stats.accepted += counters->accepted.load(std::memory_order_relaxed);
+    stats.send_messages += counters->send_messages.load(std::memory_order_relaxed);
+    stats.send_syscalls += counters->send_syscalls.load(std::memory_order_relaxed);
+    stats.received_messages += counters->received_messages.load(std::memory_order_relaxed);
+    stats.io_syscalls += counters->io_syscalls.load(std::memory_order_relaxed);
+  }
+  return stats;
+}
+
+UdpIoStats Runtime::GetUdpIoStats() const {
+  UdpIoStats stats;
+  stats.received_datagrams = 0;
+  stats.recv_syscalls = 0;
+  stats.sent_datagrams = 0;
+  stats.send_syscalls = 0;
+  stats.truncated_datagrams = 0;
+  stats.recv_buffers = 0;
+  stats.send_buffers = 0;
+  stats.send_drops = 0;
+  stats.forwarded_rtp = 0;
+  stats.rtcp_packets = 0;
+  stats.rtcp_reports = 0;
+  for (const auto& counters : udp_io_counters_) {
+    stats.received_datagrams += counters->received_datagrams.load(std::memory_order_relaxed);
+    stats.recv_syscalls += counters->recv_syscalls.load(std::memory_order_relaxed);
+    stats.sent_datagrams += counters->sent_datagrams.load(std::memory_order_relaxed);
+    stats.send_syscalls += counters->send_syscalls.load(std::memory_order_relaxed);
+    stats.truncated_datagrams +=
+        counters->truncated_datagrams.load(std::memory_order_relaxed);
+    stats.recv_buffers += counters->recv_buffers.load(std::memory_order_relaxed);
+    stats.send_buffers += counters->send_buffers.load(std::memory_order_relaxed);
+    stats.send_drops += counters->send_drops.load(std::memory_order_relaxed);
+    stats.forwarded_rtp += counters->forwarded_rtp.load(std::memory_order_relaxed);
+    stats.rtcp_packets += counters->rtcp_packets.load(std::memory_order_relaxed);
+    stats.rtcp_reports += counters->rtcp_reports.load(std::memory_order_relaxed);
+  }
+  // The replay thread only sends.
+  stats.sent_datagrams += replay_counters_->sent_datagrams.load(std::memory_order_relaxed);
+  stats.send_syscalls += replay_counters_->send_syscalls.load(std::memory_order_relaxed);
+  stats.send_buffers += replay_counters_->send_buffers.load(std::memory_order_relaxed);
+  stats.replayed_rtp = replay_counters_->replayed_rtp.load(std::memory_order_relaxed);
+  return stats;
+}
+
+bool Runtime::GetRtpStreamStats(std::uint32_t ssrc, RtpStreamStats& out) const {
+  return rtp_sessions_.GetStats(ssrc, out);
+}
+
+bool Runtime::GetRtpStreamCname(std::uint32_t ssrc, std::string& out) const {
+  return rtp_sessions_.GetCname(ssrc, out);
+}
+
+RecorderStats Runtime::GetRecorderStats() const {
+  RecorderStats stats;
+  stats.records = 0;
+  stats.appended_bytes = 0;
+  stats.written_bytes = 0;
+  stats.write_calls = 0;
+  stats.opens = 0;
+  stats.closes = 0;
+  stats.evictions = 0;
+  stats.dropped_records = 0;
+  stats.sealed_segments = 0;
+  stats.expired_segments = 0;
+  stats.expired_bytes = 0;
+  for (const auto& counters : recorder_counters_) {
+    stats.records += counters->records.load(std::memory_order_relaxed);
+    stats.appended_bytes += counters->appended_bytes.load(std::memory_order_relaxed);
+    stats.written_bytes += counters->written_bytes.load(std::memory_order_relaxed);
+    stats.write_calls += counters->write_calls.load(std::memory_order_relaxed);
+    stats.opens += counters->opens.load(std::memory_order_relaxed);
+    stats.closes += counters->closes.load(std::memory_order_relaxed);
+    stats.evictions += counters->evictions.load(std::memory_order_relaxed);
+    stats.dropped_records += counters->dropped_records.load(std::memory_order_relaxed);
+    stats.sealed_segments += counters->sealed_segments.load(std::memory_order_relaxed);
+    stats.expired_segments += counters->expired_segments.load(std::memory_order_relaxed);
+    stats.expired_bytes += counters->expired_bytes.load(std::memory_order_relaxed);
+  }
+  for (const auto& counters : udp_io_counters_) {
+    stats.dropped_records += counters->recording_drops.load(std::memory_order_relaxed);
+  }
+  return stats;
+}
+
+std::vector<WorkerStats> Runtime::GetWorkerStats() const {
+  std::vector<WorkerStats> stats;
+  for (const auto& counters : worker_counters_) {
+    WorkerStats worker;
+    worker.connections = counters->connections.load(std::memory_order_relaxed);
+    worker.events = counters->events.load(std::memory_order_relaxed);
+    stats.push_back(worker);
+  }
+  return stats;
 }
 
 void Runtime::StartTcpIoThreads() {
+  if (config_.tcp_accept_mode == "exclusive") {
+    // One listener shared by every TCP IO thread; EPOLLEXCLUSIVE wakes only
+    // one of them per incoming connection.
+    shared_listen_fd_ = CreateTcpListenSocket(config_.tcp_port,
+                                              config_.tcp_listen_backlog, false);
+    if (shared_listen_fd_ < 0) {
+      GetLogger()->error("failed to create shared tcp listen socket");
+      return;
+    }
+  }
   for (int i = 0; i < config_.tcp_io_threads; ++i) {
     tcp_io_threads_.push_back(std::thread([this, i]() { RunTcpIoThread(i); }));
   }
 }
 
 void Runtime::StartUdpIoThreads() {
+  for (int i = 0; i < config_.udp_io_threads; ++i) {
+    udp_fds_.push_back(CreateUdpSocket(config_.tcp_port));
+  }
+  if (!udp_fds_.empty() && udp_fds_[0] >= 0 &&
+      !AttachReuseportSteering(udp_fds_[0], config_.udp_io_threads)) {
+    GetLogger()->warn("udp reuseport steering unavailable, peers may move between threads");
+  }
   for (int i = 0; i < config_.udp_io_threads; ++i) {
     udp_io_threads_.push_back(std::thread([this, i]() { RunUdpIoThread(i); }));
   }
@@ -360,319 +517,103 @@ void Runtime::StartTimerThreads() {
 void Runtime::RunTcpIoThread(int index) {
   auto logger = GetLogger();
   logger->info("tcp io thread {} started", index);
-  int listen_fd = CreateTcpListenSocket(config_.tcp_port);
-  if (listen_fd < 0) {
+  TcpIoContext context;
+  context.config = &config_;
+  context.running = &running_;
+  context.index = index;
+  context.shared_listener = shared_listen_fd_ >= 0;
+  context.listen_fd = context.shared_listener
+                          ? shared_listen_fd_
+                          : CreateTcpListenSocket(config_.tcp_port,
+                                                  config_.tcp_listen_backlog, true);
+  if (context.listen_fd < 0) {
     logger->error("tcp io thread {} failed to create listen socket", index);
     return;
   }
-  int epoll_fd = ::epoll_create1(0);
-  if (epoll_fd < 0) {
-    ::close(listen_fd);
-    logger->error("tcp io thread {} failed to create epoll", index);
-    return;
-  }
-  epoll_event ev;
-  ev.events = EPOLLIN;
-  ev.data.fd = listen_fd;
-  if (::epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &ev) < 0) {
-    ::close(epoll_fd);
-    ::close(listen_fd);
-    logger->error("tcp io thread {} failed to add listen fd to epoll", index);
+  context.notifier = tcp_io_notifiers_[index].get();
+  context.inbound = worker_to_tcp_io_[index].get();
+  context.to_workers = &io_to_worker_;
+  context.worker_counters = &worker_counters_;
+  context.counters = tcp_io_counters_[index].get();
+  context.framing = tcp_framing_;
+  std::unique_ptr<TcpIoThread> thread = TcpIoThread::Create(context);
+  if (!thread) {
+    if (!context.shared_listener) {
+      ::close(context.listen_fd);
+    }
     return;
   }
-  TcpConnTable conn_table;
-  const int max_events = 64;
-  std::vector<epoll_event> events(max_events);
-  while (running_.load()) {
-    int n = ::epoll_wait(epoll_fd, events.data(), max_events, 1000);
-    if (n < 0) {
-      continue;
-    }
-    for (int i_event = 0; i_event < n; ++i_event) {
-      int fd = events[i_event].data.fd;
-      if (fd == listen_fd) {
-        while (true) {
-          sockaddr_in addr;
-          socklen_t addr_len = sizeof(addr);
-          int client_fd =
-              ::accept(listen_fd, reinterpret_cast<sockaddr*>(&addr), &addr_len);
-          if (client_fd < 0) {
-            break;
-          }
-          if (SetNonBlocking(client_fd) != 0) {
-            ::close(client_fd);
-            continue;
-          }
-          epoll_event client_ev;
-          client_ev.events = EPOLLIN | EPOLLRDHUP;
-          client_ev.data.fd = client_fd;
-          if (::epoll_ctl(epoll_fd, EPOLL_CTL_ADD, client_fd, &client_ev) < 0) {
-            ::close(client_fd);
-            continue;
-          }
-          Conn conn;
-          conn.fd = client_fd;
-          conn.state = ConnState::Established;
-          conn.worker_index = client_fd % config_.worker_threads;
-          conn.protocol = ProtocolType::Tcp;
-          conn.remote_ip = IpFromSockaddr(addr);
-          conn.remote_port = ntohs(addr.sin_port);
-          conn.last_active_ms = NowMs();
-          conn_table.Add(conn);
-          logger->info("tcp connection accepted fd={} worker={}", client_fd,
-                       conn.worker_index);
-        }
-      } else {
-        Conn* conn = conn_table.Find(fd);
-        if (!conn) {
-          continue;
-        }
-        bool closed = false;
-        char buffer[4096];
-        while (true) {
-          ssize_t received = ::recv(fd, buffer, sizeof(buffer), 0);
-          if (received > 0) {
-            conn->last_active_ms = NowMs();
-            conn->recv_buffer.append(buffer, static_cast<std::size_t>(received));
-          } else if (received == 0) {
-            closed = true;
-            break;
-          } else {
-            if (errno == EAGAIN || errno == EWOULDBLOCK) {
-              break;
-            }
-            closed = true;
-            break;
-          }
-        }
-        if (!conn->recv_buffer.empty()) {
-          Event event;
-          event.protocol = ProtocolType::Tcp;
-          event.session_id = static_cast<std::uint64_t>(fd);
-          event.context.timestamp_ms = NowMs();
-          event.context.remote_ip = conn->remote_ip;
-          event.context.remote_port = conn->remote_port;
-          event.payload = conn->recv_buffer;
-          conn->recv_buffer.clear();
-          int worker_index = conn->worker_index % config_.worker_threads;
-          io_to_worker_[worker_index]->Push(std::move(event));
-        }
-        if (closed) {
-          ::epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
-          ::close(fd);
-          conn_table.Remove(fd);
-          logger->info("tcp connection closed fd={}", fd);
-        }
-      }
-    }
-    GenericTask outbound;
-    bool has_task = false;
-    for (auto& queue : worker_to_io_) {
-      if (queue->Pop(outbound)) {
-        has_task = true;
-        break;
-      }
-    }
-    if (has_task) {
-      if (outbound.type == TaskType::Tcp) {
-        int fd = static_cast<int>(outbound.session_id);
-        Conn* target = conn_table.Find(fd);
-        if (target) {
-          const char* data = outbound.payload.data();
-          std::size_t remaining = outbound.payload.size();
-          while (remaining > 0) {
-            ssize_t sent = ::send(fd, data, remaining, 0);
-            if (sent > 0) {
-              data += sent;
-              remaining -= static_cast<std::size_t>(sent);
-            } else {
-              if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                break;
-              }
-              break;
-            }
-          }
-        }
-      }
-    }
+  thread->Run();
+  thread.reset();
+  if (!context.shared_listener) {
+    ::close(context.listen_fd);
   }
-  ::close(epoll_fd);
-  ::close(listen_fd);
-  logger->info("tcp io thread {} stopped", index);
+  TcpIoCounters& counters = *tcp_io_counters_[index];
+  logger->info("tcp io thread {} stopped send_messages={} send_syscalls={}", index,
+               counters.send_messages.load(std::memory_order_relaxed),
+               counters.send_syscalls.load(std::memory_order_relaxed));
 }
 
 void Runtime::RunUdpIoThread(int index) {
   auto logger = GetLogger();
   logger->info("udp io thread {} started", index);
-  int udp_fd = CreateUdpSocket(config_.tcp_port);
+  int udp_fd = udp_fds_[static_cast<std::size_t>(index)];
   if (udp_fd < 0) {
     logger->error("udp io thread {} failed to create udp socket", index);
     return;
   }
-  int epoll_fd = ::epoll_create1(0);
-  if (epoll_fd < 0) {
+  UdpIoContext context;
+  context.config = &config_;
+  context.running = &running_;
+  context.index = index;
+  context.udp_fd = udp_fd;
+  context.notifier = udp_io_notifiers_[index].get();
+  context.inbound = worker_to_udp_io_[index].get();
+  context.rtcp_queues = &rtcp_to_udp_io_;
+  context.to_workers = &io_to_worker_;
+  context.to_disk = &worker_to_disk_;
+  context.counters = udp_io_counters_[index].get();
+  context.udp_sessions = &udp_sessions_;
+  context.rtp_sessions = &rtp_sessions_;
+  context.rtp_forwards = &rtp_forwards_;
+  context.rtcp_ssrc = rtcp_ssrc_;
+  std::unique_ptr<UdpIoThread> thread = UdpIoThread::Create(context);
+  if (!thread) {
     ::close(udp_fd);
-    logger->error("udp io thread {} failed to create epoll", index);
     return;
   }
-  epoll_event ev;
-  ev.events = EPOLLIN;
-  ev.data.fd = udp_fd;
-  if (::epoll_ctl(epoll_fd, EPOLL_CTL_ADD, udp_fd, &ev) < 0) {
-    ::close(epoll_fd);
-    ::close(udp_fd);
-    logger->error("udp io thread {} failed to add udp fd to epoll", index);
-    return;
-  }
-  UdpSessionTable session_table;
-  RtpSessionTable rtp_table;
-  std::unordered_map<std::uint64_t, std::uint64_t> rtp_offsets;
-  const int max_events = 64;
-  std::vector<epoll_event> events(max_events);
-  while (running_.load()) {
-    int n = ::epoll_wait(epoll_fd, events.data(), max_events, 1000);
-    if (n < 0) {
-      continue;
-    }
-    for (int i_event = 0; i_event < n; ++i_event) {
-      int fd = events[i_event].data.fd;
-      if (fd != udp_fd) {
-        continue;
-      }
-      while (true) {
-        sockaddr_in addr;
-        socklen_t addr_len = sizeof(addr);
-        char buffer[4096];
-        ssize_t received =
-            ::recvfrom(fd, buffer, sizeof(buffer), 0,
-                       reinterpret_cast<sockaddr*>(&addr), &addr_len);
-        if (received > 0) {
-          std::string ip = IpFromSockaddr(addr);
-          std::uint16_t port = ntohs(addr.sin_port);
-          std::uint64_t now = NowMs();
-          RtpHeader header;
-          bool is_rtp = ParseRtpHeader(buffer,
-                                       static_cast<std::size_t>(received),
-                                       header);
-          if (is_rtp) {
-            RtpSession* rtp_session = rtp_table.FindOrCreate(header.ssrc, now);
-            Event event;
-            event.protocol = ProtocolType::Rtp;
-            event.session_id = static_cast<std::uint64_t>(header.ssrc);
-            event.context.timestamp_ms = now;
-            event.context.remote_ip = ip;
-            event.context.remote_port = port;
-            event.payload.assign(buffer, static_cast<std::size_t>(received));
-            int worker_index =
-                static_cast<int>(rtp_session->id %
-                                 static_cast<std::uint64_t>(config_.worker_threads));
-            io_to_worker_[worker_index]->Push(std::move(event));
-            if (worker_index >= 0 &&
-                worker_index < static_cast<int>(worker_to_disk_.size())) {
-              DiskTask record;
-              record.op = DiskOp::Append;
-              record.path =
-                  "rtp/session_" + std::to_string(rtp_session->id) + ".bin";
-              record.data.assign(buffer, static_cast<std::size_t>(received));
-              worker_to_disk_[worker_index]->Push(std::move(record));
-              DiskTask index_task;
-              index_task.op = DiskOp::Append;
-              index_task.path =
-                  "rtp/session_" + std::to_string(rtp_session->id) + ".idx";
-              std::uint64_t& offset = rtp_offsets[rtp_session->id];
-              std::size_t length =
-                  static_cast<std::size_t>(received);
-              std::string line;
-              line.append(std::to_string(header.sequence_number));
-              line.push_back(' ');
-              line.append(std::to_string(header.timestamp));
-              line.push_back(' ');
-              line.append(std::to_string(header.ssrc));
-              line.push_back(' ');
-              line.append(std::to_string(offset));
-              line.push_back(' ');
-              line.append(std::to_string(length));
-              line.push_back('\n');
-              offset += static_cast<std::uint64_t>(length);
-              index_task.data = std::move(line);
-              worker_to_disk_[worker_index]->Push(std::move(index_task));
-            }
-          } else {
-            UdpSession* session =
-                session_table.FindOrCreate(ip, port, ProtocolType::Udp, now);
-            Event event;
-            event.protocol = ProtocolType::Udp;
-            event.session_id = session->id;
-            event.context.timestamp_ms = now;
-            event.context.remote_ip = ip;
-            event.context.remote_port = port;
-            event.payload.assign(buffer, static_cast<std::size_t>(received));
-            int worker_index =
-                static_cast<int>(session->id %
-                                 static_cast<std::uint64_t>(config_.worker_threads));
-            io_to_worker_[worker_index]->Push(std::move(event));
-            if (worker_index >= 0 &&
-                worker_index < static_cast<int>(worker_to_disk_.size())) {
-              DiskTask record;
-              record.op = DiskOp::Append;
-              record.path = "recordings/udp_session_" +
-                            std::to_string(session->id) + ".bin";
-              record.data.assign(buffer, static_cast<std::size_t>(received));
-              worker_to_disk_[worker_index]->Push(std::move(record));
-            }
-          }
-        } else if (received < 0) {
-          if (errno == EAGAIN || errno == EWOULDBLOCK) {
-            break;
-          }
-          break;
-        } else {
-          break;
-        }
-      }
-    }
-    GenericTask outbound;
-    bool has_task = false;
-    for (auto& queue : worker_to_io_) {
-      if (queue->Pop(outbound)) {
-        has_task = true;
-        break;
-      }
-    }
-    if (has_task) {
-      if (outbound.type == TaskType::Udp) {
-        UdpSession* s = session_table.FindById(outbound.session_id);
-        if (s) {
-          sockaddr_in addr;
-          addr.sin_family = AF_INET;
-          addr.sin_port = htons(s->remote_port);
-          ::inet_pton(AF_INET, s->remote_ip.c_str(), &addr.sin_addr);
-          const char* data = outbound.payload.data();
-          std::size_t len = outbound.payload.size();
-          ::sendto(udp_fd, data, len, 0,
-                   reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
-        }
-      }
-    }
-  }
-  ::close(epoll_fd);
+  thread->Run();
+  thread.reset();
   ::close(udp_fd);
   logger->info("udp io thread {} stopped", index);
 }
 
+void Runtime::StartReplayThread() {
+  replay_thread_ = std::thread([this]() { RunReplayThread(); });
+}
+
 void Runtime::RunWorkerThread(int index) {
   auto logger = GetLogger();
   logger->info("worker thread {} started", index);
   auto& from_io = io_to_worker_[index];
-  Event inbound;
-  while (running_.load()) {
-    if (!from_io->Pop(inbound)) {
-      std::this_thread::sleep_for(std::chrono::milliseconds(1));
-      continue;
-    }
+  WorkerCounters& counters = *worker_counters_[index];
+  std::vector<Event> inbound(config_.queue_batch_size);
+  auto drain = [&]() {
+    std::size_t count = from_io->PopBatch(inbound.data(), inbound.size());
+    std::uint64_t handled = 0;
     if (index >= 0 && index < static_cast<int>(lua_vms_.size())) {
-      lua_vms_[index]->HandleEvent(inbound);
+      for (std::size_t i = 0; i < count; ++i) {
+        // Timer ticks go to every worker and say nothing about balance.
+        handled += inbound[i].protocol != ProtocolType::Unknown ? 1 : 0;
+        lua_vms_[index]->HandleEvent(inbound[i]);
+      }
     }
+    AddCounter(counters.events, handled);
+    return count > 0;
+  };
+  while (running_.load()) {
+    worker_notifiers_[index]->Await(drain, config_.queue_spin_iterations,
+                                    kParkTimeoutMs);
   }
   logger->info("worker thread {} stopped", index);
 }
@@ -680,62 +621,129 @@ void Runtime::RunWorkerThread(int index) {
 void Runtime::RunDiskThread(int index) {
   auto logger = GetLogger();
   logger->info("disk thread {} started", index);
-  DiskTask inbound;
-  while (running_.load()) {
+  // Each worker queue has exactly one consumer: queue i belongs to disk
+  // thread i % disk_threads.
+  std::vector<MpscQueue<DiskTask>*> owned;
+  for (std::size_t i = static_cast<std::size_t>(index); i < worker_to_disk_.size();
+       i += static_cast<std::size_t>(config_.disk_threads)) {
+    owned.push_back(worker_to_disk_[i].get());
+  }
+  std::vector<DiskTask> inbound(config_.queue_batch_size);
+  Recorder recorder(config_.recorder_max_open_files, config_.recorder_block_size,
+                    config_.recorder_flush_interval_ms, recorder_counters_[index].get());
+  auto drain = [&]() {
     bool has_task = false;
-    for (auto& queue : worker_to_disk_) {
-      if (queue->Pop(inbound)) {
+    for (auto* queue : owned) {
+      std::size_t count = queue->PopBatch(inbound.data(), inbound.size());
+      if (count > 0) {
         has_task = true;
-        if (inbound.op == DiskOp::Read) {
-        } else if (inbound.op == DiskOp::Write || inbound.op == DiskOp::Append) {
-          try {
-            std::size_t slash = inbound.path.find_last_of('/');
-            if (slash != std::string::npos) {
-              std::string dir = inbound.path.substr(0, slash);
-              ::mkdir(dir.c_str(), 0755);
-            }
-            const char* mode =
-                inbound.op == DiskOp::Append ? "ab" : "wb";
-            FILE* f = ::fopen(inbound.path.c_str(), mode);
-            if (f) {
-              (void)::fwrite(inbound.data.data(), 1, inbound.data.size(), f);
-              ::fclose(f);
-            } else {
-              logger->warn("disk thread {} failed to open {}", index,
-                           inbound.path);
-            }
-          } catch (...) {
-            logger->error("disk thread {} unexpected error during disk task",
-                          index);
-          }
-        }
-        break;
+      }
+      for (std::size_t i = 0; i < count; ++i) {
+        ExecuteDiskTask(inbound[i], index, recorder);
       }
     }
-    if (!has_task) {
-      std::this_thread::sleep_for(std::chrono::milliseconds(1));
-    }
+    recorder.FlushDue(NowMs());
+    return has_task;
+  };
+  // Wake up often enough to honour the flush interval when idle. With no
+  // interval every pass flushes what it appended, so nothing is left to wait.
+  int timeout_ms = kParkTimeoutMs;
+  if (config_.recorder_flush_interval_ms > 0) {
+    timeout_ms = static_cast<int>(std::min<std::uint64_t>(
+        static_cast<std::uint64_t>(kParkTimeoutMs), config_.recorder_flush_interval_ms));
   }
+  while (running_.load()) {
+    disk_notifiers_[index]->Await(drain, config_.queue_spin_iterations, timeout_ms);
+  }
+  // What was queued before the stop is still recorded.
+  drain();
+  recorder.CloseAll();
   logger->info("disk thread {} stopped", index);
 }
 
+void Runtime::ExecuteDiskTask(const DiskTask& task, int index, Recorder& recorder) {
+  if (task.op == DiskOp::Read) {
+    return;
+  }
+  if (task.op == DiskOp::Append) {
+    recorder.Append(task.path, task.data.data(), task.data.size(), NowMs(), task.reserve_bytes);
+    return;
+  }
+  if (task.op == DiskOp::Seal) {
+    RecorderCounters& counters = *recorder_counters_[static_cast<std::size_t>(index)];
+    recorder.Close(task.path);
+    if (!SealSegment(task.path)) {
+      // Nothing was written when every append of the segment was dropped.
+      if (errno != ENOENT) {
+        GetLogger()->warn("disk thread {} failed to seal {}: {}", index, task.path,
+                          std::strerror(errno));
+      }
+      return;
+    }
+    AddCounter(counters.sealed_segments, 1);
+    if (config_.recording_retention_bytes == 0) {
+      return;
+    }
+    // Disk threads share the directories; one of them trims at a time.
+    std::size_t slash = task.path.find_last_of('/');
+    std::string dir = slash == std::string::npos ? "." : task.path.substr(0, slash);
+    std::uint64_t freed = 0;
+    std::size_t expired = 0;
+    {
+      std::lock_guard<std::mutex> lock(retention_mutex_);
+      expired = EnforceRetention(dir, config_.recording_retention_bytes, &freed);
+    }
+    AddCounter(counters.expired_segments, expired);
+    AddCounter(counters.expired_bytes, freed);
+    return;
+  }
+  // A rewrite must not be followed by appends still buffered from before.
+  recorder.Close(task.path);
+  auto logger = GetLogger();
+  try {
+    std::size_t slash = task.path.find_last_of('/');
+    if (slash != std::string::npos) {
+      std::string dir = task.path.substr(0, slash);
+      ::mkdir(dir.c_str(), 0755);
+    }
+    FILE* f = ::fopen(task.path.c_str(), "wb");
+    if (f) {
+      (void)::fwrite(task.data.data(), 1, task.data.size(), f);
+      ::fclose(f);
+    } else {
+      logger->warn("disk thread {} failed to open {}", index, task.path);
+    }
+  } catch (...) {
+    logger->error("disk thread {} unexpected error during disk task", index);
+  }
+}
+
 void Runtime::RunLogThread(int index) {
   auto logger = GetLogger();
   logger->info("log thread {} started", index);
-  LogTask inbound;
-  while (running_.load()) {
-    if (!worker_to_log_->Pop(inbound)) {
-      std::this_thread::sleep_for(std::chrono::milliseconds(1));
-      continue;
-    }
-    switch (inbound.level) {
-      case LogTask::Level::Trace: logger->trace("{}", inbound.message); break;
-      case LogTask::Level::Debug: logger->debug("{}", inbound.message); break;
-      case LogTask::Level::Info: logger->info("{}", inbound.message); break;
-      case LogTask::Level::Warn: logger->warn("{}", inbound.message); break;
-      case LogTask::Level::Error: logger->error("{}", inbound.message); break;
-      case LogTask::Level::Critical: logger->critical("{}", inbound.message); break;
+  if (index != 0) {
+    // The log queue has a single consumer.
+    logger->info("log thread {} stopped", index);
+    return;
+  }
+  std::vector<LogTask> inbound(config_.queue_batch_size);
+  auto drain = [&]() {
+    std::size_t count = worker_to_log_->PopBatch(inbound.data(), inbound.size());
+    for (std::size_t i = 0; i < count; ++i) {
+      const LogTask& task = inbound[i];
+      switch (task.level) {
+        case LogTask::Level::Trace: logger->trace("{}", task.message); break;
+        case LogTask::Level::Debug: logger->debug("{}", task.message); break;
+        case LogTask::Level::Info: logger->info("{}", task.message); break;
+        case LogTask::Level::Warn: logger->warn("{}", task.message); break;
+        case LogTask::Level::Error: logger->error("{}", task.message); break;
+        case LogTask::Level::Critical: logger->critical("{}", task.message); break;
+      }
     }
+    return count > 0;
+  };
+  while (running_.load()) {
+    log_notifier_->Await(drain, config_.queue_spin_iterations, kParkTimeoutMs);
   }
   logger->info("log thread {} stopped", index);
 }
@@ -760,4 +768,95 @@ void Runtime::RunTimerThread(int index) {
   logger->info("timer thread {} stopped", index);
 }
 
+// Replays run on their own thread so that page faults on the mapped
+// recordings and the pacing waits never stall the UDP IO threads. Packets go
+// out through the IO threads' sockets, so peers see the server's port.
+void Runtime::RunReplayThread() {
+  auto logger = GetLogger();
+  logger->info("replay thread started");
+  UdpIoCounters& counters = *replay_counters_;
+  struct ActiveReplay {
+    std::unique_ptr<RtpReplay> replay;
+    std::string recording;
+    int fd;
+    sockaddr_in to;
+  };
+  std::vector<ActiveReplay> active;
+  std::vector<ReplayTask> inbound(config_.queue_batch_size);
+  auto start_replays = [&]() {
+    std::size_t count = worker_to_replay_->PopBatch(inbound.data(), inbound.size());
+    for (std::size_t i = 0; i < count; ++i) {
+      const ReplayTask& task = inbound[i];
+      if (active.size() >= kMaxActiveReplays) {
+        logger->warn("replay of {} refused, {} replays running", task.recording, active.size());
+        continue;
+      }
+      ActiveReplay entry;
+      entry.recording = task.recording;
+      entry.fd = -1;
+      std::memset(&entry.to, 0, sizeof(entry.to));
+      entry.to.sin_family = AF_INET;
+      if (task.session_id != 0) {
+        UdpSession session;
+        std::size_t owner = static_cast<std::size_t>(SessionOwner(task.session_id));
+        if (owner < udp_fds_.size() && udp_sessions_.FindById(task.session_id, session)) {
+          entry.fd = udp_fds_[owner];
+          entry.to.sin_addr.s_addr = session.remote_addr;
+          entry.to.sin_port = htons(session.remote_port);
+        }
+      } else if (!udp_fds_.empty()) {
+        entry.fd = udp_fds_[0];
+        entry.to.sin_addr.s_addr = task.remote_addr;
+        entry.to.sin_port = htons(task.remote_port);
+      }
+      if (entry.fd < 0) {
+        logger->warn("replay of {} has no udp destination", task.recording);
+        continue;
+      }
+      entry.replay = std::make_unique<RtpReplay>();
+      if (!entry.replay->Open(task.recording)) {
+        logger->warn("replay of {} failed to open the recording", task.recording);
+        continue;
+      }
+      entry.replay->Start(NowUs(), task.speed, config_.rtp_clock_rate);
+      logger->info("replaying {} packets of {} at {}x", entry.replay->Packets(), task.recording,
+                   task.speed);
+      active.push_back(std::move(entry));
+    }
+    return count > 0;
+  };
+  while (running_.load()) {
+    std::uint64_t now = NowUs();
+    std::uint64_t next_due = std::numeric_limits<std::uint64_t>::max();
+    for (auto it = active.begin(); it != active.end();) {
+      RtpReplay& replay = *it->replay;
+      std::uint64_t calls = replay.SendCalls();
+      std::size_t sent = replay.SendDue(it->fd, it->to, now, config_.udp_batch_size);
+      AddCounter(counters.send_syscalls, replay.SendCalls() - calls);
+      AddCounter(counters.sent_datagrams, sent);
+      AddCounter(counters.send_buffers, sent);
+      AddCounter(counters.replayed_rtp, sent);
+      if (replay.Done()) {
+        logger->info("replay of {} finished after {} packets", it->recording, replay.Sent());
+        it = active.erase(it);
+        continue;
+      }
+      next_due = std::min(next_due, replay.NextDueUs());
+      ++it;
+    }
+    int timeout_ms = kParkTimeoutMs;
+    if (next_due <= now) {
+      // Still due after sending: the socket buffer is full.
+      timeout_ms = kBackpressurePollMs;
+    } else if (!active.empty()) {
+      std::uint64_t current = NowUs();
+      std::uint64_t wait_ms = next_due > current ? (next_due - current + 999) / 1000 : 0;
+      timeout_ms = static_cast<int>(
+          std::min<std::uint64_t>(wait_ms, static_cast<std::uint64_t>(kParkTimeoutMs)));
+    }
+    replay_notifier_->Await(start_replays, config_.queue_spin_iterations, timeout_ms);
+  }
+  logger->info("replay thread stopped with {} replays unfinished", active.size());
+}
+
 }  // namespace backend
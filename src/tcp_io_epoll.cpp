@@ -0,0 +1,289 @@
+#include "tcp_io_thread.h"
+
+#include "io_thread.h"
+
+#include <cerrno>
+#include <climits>
+#include <cstring>
+
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace backend {
+
+namespace {
+
+const int kMaxEpollEvents = 64;
+
+// Readiness through epoll, level- or edge-triggered, with readv and sendmsg
+// on the thread.
+class EpollTcpIoThread : public TcpIoThread {
+ public:
+  explicit EpollTcpIoThread(const TcpIoContext& context)
+      : TcpIoThread(context),
+        edge_triggered_(context.config->tcp_edge_triggered),
+        events_(kMaxEpollEvents),
+        iov_(IOV_MAX) {
+  }
+
+  ~EpollTcpIoThread() override {
+    if (epoll_fd_ >= 0) {
+      ::close(epoll_fd_);
+    }
+  }
+
+ protected:
+  bool Init() override;
+  void Poll(int timeout_ms) override;
+  bool AcceptPending() const override {
+    return accept_pending_;
+  }
+  bool FlushSendQueue(Conn& conn) override;
+  void StopReads(Conn& conn) override {
+    UpdateConnEvents(conn);
+  }
+  bool ResumeReads(Conn& conn) override {
+    UpdateConnEvents(conn);
+    return ReadConn(conn);
+  }
+  void CloseSocket(Conn& conn) override;
+
+ private:
+  void UpdateConnEvents(const Conn& conn);
+  bool ReadConn(Conn& conn);
+  bool AcceptBatch();
+
+  const bool edge_triggered_;
+  int epoll_fd_ = -1;
+  std::vector<epoll_event> events_;
+  std::vector<iovec> iov_;
+  bool accept_pending_ = false;
+};
+
+bool EpollTcpIoThread::Init() {
+  epoll_fd_ = ::epoll_create1(EPOLL_CLOEXEC);
+  if (epoll_fd_ < 0) {
+    logger_->error("tcp io thread {} failed to create epoll", index_);
+    return false;
+  }
+  epoll_event ev;
+  ev.events = EPOLLIN;
+  if (edge_triggered_) {
+    ev.events |= EPOLLET;
+  }
+  if (shared_listener_) {
+    ev.events |= EPOLLEXCLUSIVE;
+  }
+  ev.data.fd = listen_fd_;
+  if (::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, listen_fd_, &ev) < 0) {
+    logger_->error("tcp io thread {} failed to add listen fd to epoll", index_);
+    return false;
+  }
+  ev.events = EPOLLIN;
+  ev.data.fd = notifier_.Fd();
+  if (::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, notifier_.Fd(), &ev) < 0) {
+    logger_->error("tcp io thread {} failed to add notifier to epoll", index_);
+    return false;
+  }
+  return true;
+}
+
+void EpollTcpIoThread::UpdateConnEvents(const Conn& conn) {
+  epoll_event conn_ev;
+  conn_ev.events = conn.read_paused ? 0u : EPOLLIN | EPOLLRDHUP;
+  if (edge_triggered_) {
+    conn_ev.events |= EPOLLOUT | EPOLLET;
+  } else if (conn.write_armed) {
+    conn_ev.events |= EPOLLOUT;
+  }
+  conn_ev.data.fd = conn.fd;
+  ::epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, conn.fd, &conn_ev);
+  AddCounter(counters_.io_syscalls, 1);
+}
+
+void EpollTcpIoThread::CloseSocket(Conn& conn) {
+  int fd = conn.fd;
+  ::epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+  AddCounter(counters_.io_syscalls, 1);
+  ::close(fd);
+  conn_table_.Remove(fd);
+  logger_->debug("tcp connection closed fd={}", fd);
+}
+
+// Writes as much of the send queue as the socket takes, up to IOV_MAX
+// chunks per sendmsg, and keeps EPOLLOUT armed exactly while bytes are
+// left.
+bool EpollTcpIoThread::FlushSendQueue(Conn& conn) {
+  SendQueue* queue = conn.send_queue.get();
+  while (queue && !queue->Empty()) {
+    msghdr msg;
+    std::memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov_.data();
+    msg.msg_iovlen =
+        static_cast<std::size_t>(queue->FillIov(iov_.data(), static_cast<int>(iov_.size())));
+    ssize_t sent = ::sendmsg(conn.fd, &msg, MSG_NOSIGNAL);
+    AddCounter(counters_.send_syscalls, 1);
+    AddCounter(counters_.io_syscalls, 1);
+    if (sent > 0) {
+      queue->Consume(static_cast<std::size_t>(sent));
+    } else if (sent < 0 && errno == EINTR) {
+      continue;
+    } else if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      break;
+    } else {
+      return false;
+    }
+  }
+  bool want_write = queue && !queue->Empty();
+  if (edge_triggered_) {
+    // EPOLLOUT stays registered; the next writable edge resumes the flush.
+    conn.write_armed = want_write;
+  } else if (want_write != conn.write_armed) {
+    conn.write_armed = want_write;
+    UpdateConnEvents(conn);
+  }
+  UpdateSendWatermarks(conn);
+  return true;
+}
+
+// Reads with readv straight into the connection's ring and frames what
+// arrived, until the socket is drained or the worker queue crosses the
+// pause watermark; a paused connection has EPOLLIN off until the worker
+// catches up. Returns false if the connection has to be closed.
+bool EpollTcpIoThread::ReadConn(Conn& conn) {
+  bool ok = true;
+  bool active = false;
+  while (true) {
+    if (WorkerBacklogged(conn)) {
+      PauseReads(conn);
+      break;
+    }
+    RecvRing& ring = AcquireRing(conn);
+    iovec parts[2];
+    int part_count = ring.FillIov(parts);
+    if (part_count == 0) {
+      logger_->warn("tcp connection fd={} sent a message over {} bytes", conn.fd,
+                    config_.tcp_max_message_size);
+      ok = false;
+      break;
+    }
+    ssize_t received = ::readv(conn.fd, parts, part_count);
+    AddCounter(counters_.io_syscalls, 1);
+    if (received > 0) {
+      active = true;
+      ring.Commit(static_cast<std::size_t>(received));
+      std::size_t consumed = framer_.Feed(ring.Data(), ring.Size(), framed_);
+      if (consumed == ProtocolHandler::kFrameError) {
+        logger_->warn("tcp connection fd={} sent an unframeable stream", conn.fd);
+        ok = false;
+        break;
+      }
+      ring.Consume(consumed);
+      PostFramed(conn);
+    } else if (received == 0) {
+      ok = false;
+      break;
+    } else if (errno == EINTR) {
+      continue;
+    } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+      break;
+    } else {
+      ok = false;
+      break;
+    }
+  }
+  if (active) {
+    conn_table_.Info(conn.fd).last_active_ms = NowMs();
+  }
+  ReleaseRing(conn);
+  return ok;
+}
+
+// Accepts at most tcp_accept_batch connections so one busy listener cannot
+// starve established connections. Returns true while more may be waiting.
+bool EpollTcpIoThread::AcceptBatch() {
+  for (int i = 0; i < config_.tcp_accept_batch; ++i) {
+    sockaddr_in addr;
+    socklen_t addr_len = sizeof(addr);
+    int client_fd = ::accept4(listen_fd_, reinterpret_cast<sockaddr*>(&addr), &addr_len,
+                              SOCK_NONBLOCK | SOCK_CLOEXEC);
+    AddCounter(counters_.io_syscalls, 1);
+    if (client_fd < 0) {
+      if (errno == EINTR || errno == ECONNABORTED) {
+        continue;
+      }
+      if (errno != EAGAIN && errno != EWOULDBLOCK) {
+        logger_->warn("tcp io thread {} accept failed errno={}", index_, errno);
+      }
+      return false;
+    }
+    Conn* conn = conn_table_.Add(client_fd);
+    if (!conn) {
+      ::close(client_fd);
+      continue;
+    }
+    epoll_event client_ev;
+    client_ev.events = EPOLLIN | EPOLLRDHUP;
+    if (edge_triggered_) {
+      client_ev.events |= EPOLLOUT | EPOLLET;
+    }
+    client_ev.data.fd = client_fd;
+    AddCounter(counters_.io_syscalls, 1);
+    if (::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, client_fd, &client_ev) < 0) {
+      conn_table_.Remove(client_fd);
+      ::close(client_fd);
+      continue;
+    }
+    SetupConn(*conn, addr);
+  }
+  return true;
+}
+
+void EpollTcpIoThread::Poll(int timeout_ms) {
+  int n = ::epoll_wait(epoll_fd_, events_.data(), static_cast<int>(events_.size()), timeout_ms);
+  AddCounter(counters_.io_syscalls, 1);
+  notifier_.Unpark();
+  for (int i_event = 0; i_event < n; ++i_event) {
+    int fd = events_[i_event].data.fd;
+    if (fd == notifier_.Fd()) {
+      notifier_.Drain();
+    } else if (fd == listen_fd_) {
+      accept_pending_ = true;
+    } else {
+      Conn* conn = conn_table_.Find(fd);
+      if (!conn) {
+        continue;
+      }
+      std::uint32_t ready = events_[i_event].events;
+      if ((ready & EPOLLOUT) != 0 && !FlushSendQueue(*conn)) {
+        CloseConn(fd, EventKind::Closed);
+        continue;
+      }
+      if (conn->read_paused) {
+        if ((ready & (EPOLLHUP | EPOLLERR)) != 0) {
+          CloseConn(fd, EventKind::Closed);
+        }
+        continue;
+      }
+      if ((ready & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) == 0) {
+        continue;
+      }
+      if (!ReadConn(*conn)) {
+        CloseConn(fd, EventKind::Closed);
+      }
+    }
+  }
+  if (accept_pending_) {
+    accept_pending_ = AcceptBatch();
+  }
+}
+
+}  // namespace
+
+std::unique_ptr<TcpIoThread> MakeEpollTcpIoThread(const TcpIoContext& context) {
+  return std::make_unique<EpollTcpIoThread>(context);
+}
+
+}  // namespace backend
@@ -0,0 +1,250 @@
+#include "tcp_io_thread.h"
+
+#include "io_thread.h"
+#include "logger.h"
+
+#include <utility>
+
+#include <arpa/inet.h>
+
+namespace backend {
+
+namespace {
+
+// Room for length headers or delimiters around the largest allowed message.
+const std::size_t kTcpFrameOverhead = 1024;
+const std::size_t kRecvRingPoolSize = 256;
+
+WorkerAssignment AssignmentOf(const AppConfig& config) {
+  WorkerAssignment assignment = WorkerAssignment::RoundRobin;
+  ParseWorkerAssignment(config.tcp_worker_assignment, assignment);
+  return assignment;
+}
+
+}  // namespace
+
+TcpIoThread::TcpIoThread(const TcpIoContext& context)
+    : config_(*context.config),
+      index_(context.index),
+      listen_fd_(context.listen_fd),
+      shared_listener_(context.shared_listener),
+      notifier_(*context.notifier),
+      counters_(*context.counters),
+      logger_(GetLogger()),
+      framer_(context.framing),
+      running_(*context.running),
+      inbound_(*context.inbound),
+      to_workers_(*context.to_workers),
+      worker_counters_(*context.worker_counters),
+      ring_capacity_(context.config->tcp_max_message_size + kTcpFrameOverhead),
+      pause_depth_(context.config->tcp_read_pause_watermark),
+      resume_depth_(context.config->tcp_read_pause_watermark / 2),
+      idle_wheel_(kIdleWheelTickMs, NowMs()),
+      pending_events_(context.to_workers->size()),
+      outbound_(context.config->queue_batch_size),
+      assigner_(AssignmentOf(*context.config), context.config->worker_threads, context.index,
+                [this](int worker) { return WorkerDepth(worker); }) {
+}
+
+TcpIoThread::~TcpIoThread() = default;
+
+std::unique_ptr<TcpIoThread> TcpIoThread::Create(const TcpIoContext& context) {
+  std::unique_ptr<TcpIoThread> thread = MakeUringTcpIoThread(context);
+  if (!thread) {
+    thread = MakeEpollTcpIoThread(context);
+  }
+  if (!thread->Init()) {
+    return nullptr;
+  }
+  return thread;
+}
+
+std::size_t TcpIoThread::WorkerDepth(int worker) const {
+  return to_workers_[static_cast<std::size_t>(worker)]->Size() +
+         pending_events_[static_cast<std::size_t>(worker)].size();
+}
+
+bool TcpIoThread::WorkerBacklogged(const Conn& conn) const {
+  return WorkerDepth(conn.worker_index % config_.worker_threads) >= pause_depth_;
+}
+
+void TcpIoThread::PauseReads(Conn& conn) {
+  conn.read_paused = true;
+  StopReads(conn);
+  paused_.push_back(conn.fd);
+}
+
+RecvRing& TcpIoThread::AcquireRing(Conn& conn) {
+  if (!conn.recv_ring) {
+    if (ring_pool_.empty()) {
+      conn.recv_ring = std::make_unique<RecvRing>(ring_capacity_);
+    } else {
+      conn.recv_ring = std::move(ring_pool_.back());
+      ring_pool_.pop_back();
+    }
+  }
+  return *conn.recv_ring;
+}
+
+void TcpIoThread::ReleaseRing(Conn& conn) {
+  if (!conn.recv_ring || conn.recv_ring->Size() != 0) {
+    return;
+  }
+  if (ring_pool_.size() < kRecvRingPoolSize) {
+    ring_pool_.push_back(std::move(conn.recv_ring));
+  } else {
+    conn.recv_ring.reset();
+  }
+}
+
+void TcpIoThread::PostConnEvent(const Conn& conn, EventKind kind, std::string payload) {
+  const ConnInfo& info = conn_table_.Info(conn.fd);
+  Event event;
+  event.protocol = ProtocolType::Tcp;
+  event.kind = kind;
+  event.session_id = MakeSessionId(index_, static_cast<std::uint32_t>(conn.fd), conn.generation);
+  event.context.timestamp_ms = NowMs();
+  event.context.remote_ip = IpFromAddress(info.remote_addr);
+  event.context.remote_port = info.remote_port;
+  event.payload = std::move(payload);
+  pending_events_[static_cast<std::size_t>(conn.worker_index % config_.worker_threads)]
+      .push_back(std::move(event));
+}
+
+void TcpIoThread::PostFramed(const Conn& conn) {
+  for (Event& message : framed_) {
+    PostConnEvent(conn, EventKind::Message, std::move(message.payload));
+  }
+  AddCounter(counters_.received_messages, framed_.size());
+  framed_.clear();
+}
+
+void TcpIoThread::CloseConn(int fd, EventKind kind) {
+  Conn* conn = conn_table_.Find(fd);
+  if (!conn) {
+    return;
+  }
+  worker_counters_[static_cast<std::size_t>(conn->worker_index)]->connections.fetch_sub(
+      1, std::memory_order_relaxed);
+  idle_wheel_.Cancel(conn_table_.Info(fd).idle_timer);
+  PostConnEvent(*conn, kind, {});
+  if (conn->recv_ring) {
+    conn->recv_ring->Consume(conn->recv_ring->Size());
+    ReleaseRing(*conn);
+  }
+  CloseSocket(*conn);
+}
+
+void TcpIoThread::UpdateSendWatermarks(Conn& conn) {
+  std::size_t pending = conn.PendingSendBytes();
+  if (!conn.send_blocked && pending >= config_.tcp_send_high_watermark) {
+    conn.send_blocked = true;
+    PostConnEvent(conn, EventKind::SendBlocked, {});
+  } else if (conn.send_blocked && pending <= config_.tcp_send_low_watermark) {
+    conn.send_blocked = false;
+    PostConnEvent(conn, EventKind::SendDrained, {});
+  }
+}
+
+void TcpIoThread::SetupConn(Conn& conn, const sockaddr_in& addr) {
+  conn.state = ConnState::Established;
+  conn.worker_index = assigner_.Assign(addr.sin_addr.s_addr);
+  worker_counters_[static_cast<std::size_t>(conn.worker_index)]->connections.fetch_add(
+      1, std::memory_order_relaxed);
+  ConnInfo& info = conn_table_.Info(conn.fd);
+  info.remote_addr = addr.sin_addr.s_addr;
+  info.remote_port = ntohs(addr.sin_port);
+  info.accepted_ms = NowMs();
+  info.last_active_ms = info.accepted_ms;
+  info.idle_timer = idle_wheel_.Schedule(static_cast<std::uint64_t>(conn.fd),
+                                         info.accepted_ms + config_.tcp_idle_timeout_ms);
+  AddCounter(counters_.accepted, 1);
+  logger_->debug("tcp connection accepted fd={} worker={}", conn.fd, conn.worker_index);
+}
+
+void TcpIoThread::Run() {
+  while (running_.load()) {
+    notifier_.Park();
+    int timeout_ms = kParkTimeoutMs;
+    if (!inbound_.Empty() || AcceptPending()) {
+      timeout_ms = 0;
+    } else if (events_left_ || !paused_.empty()) {
+      timeout_ms = kBackpressurePollMs;
+    }
+    Poll(timeout_ms);
+    std::size_t count = inbound_.PopBatch(outbound_.data(), outbound_.size());
+    std::uint64_t now = NowMs();
+    for (std::size_t i_task = 0; i_task < count; ++i_task) {
+      GenericTask& task = outbound_[i_task];
+      if (task.type != TaskType::Tcp) {
+        continue;
+      }
+      int fd = static_cast<int>(SessionIndex(task.session_id));
+      Conn* target = conn_table_.Find(fd, SessionGeneration(task.session_id));
+      if (!target || target->state != ConnState::Established) {
+        continue;
+      }
+      conn_table_.Info(fd).last_active_ms = now;
+      AddCounter(counters_.send_messages, 1);
+      target->Send().Append(std::move(task.payload));
+      if (target->write_armed) {
+        UpdateSendWatermarks(*target);
+      } else if (!target->send_scheduled) {
+        target->send_scheduled = true;
+        send_ready_.push_back(fd);
+      }
+    }
+    for (int fd : send_ready_) {
+      Conn* target = conn_table_.Find(fd);
+      if (!target) {
+        continue;
+      }
+      target->send_scheduled = false;
+      if (target->state == ConnState::Established && !FlushSendQueue(*target)) {
+        CloseConn(fd, EventKind::Closed);
+      }
+    }
+    send_ready_.clear();
+    // Idle timers are not moved on activity; when one fires for a connection
+    // that was active since, it is re-armed from the last activity instead.
+    idle_wheel_.Advance(now, expired_);
+    for (std::uint64_t key : expired_) {
+      int fd = static_cast<int>(key);
+      Conn* conn = conn_table_.Find(fd);
+      if (!conn || conn->state != ConnState::Established) {
+        continue;
+      }
+      ConnInfo& info = conn_table_.Info(fd);
+      if (now - info.last_active_ms >= config_.tcp_idle_timeout_ms) {
+        info.idle_timer = TimingWheel::kInvalidTimer;
+        logger_->debug("tcp connection idle fd={}", fd);
+        CloseConn(fd, EventKind::Expired);
+      } else {
+        info.idle_timer =
+            idle_wheel_.Schedule(key, info.last_active_ms + config_.tcp_idle_timeout_ms);
+      }
+    }
+    expired_.clear();
+    for (std::size_t i = 0; i < paused_.size();) {
+      int fd = paused_[i];
+      Conn* conn = conn_table_.Find(fd);
+      if (conn && conn->read_paused &&
+          WorkerDepth(conn->worker_index % config_.worker_threads) > resume_depth_) {
+        ++i;
+        continue;
+      }
+      paused_[i] = paused_.back();
+      paused_.pop_back();
+      if (!conn || !conn->read_paused || conn->state != ConnState::Established) {
+        continue;
+      }
+      conn->read_paused = false;
+      if (!ResumeReads(*conn)) {
+        CloseConn(fd, EventKind::Closed);
+      }
+    }
+    events_left_ = FlushPendingEvents(pending_events_, to_workers_);
+  }
+}
+
+}  // namespace backend
@@ -0,0 +1,312 @@
+#include "tcp_io_thread.h"
+
+#include "io_thread.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <utility>
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace backend {
+
+namespace {
+
+const int kUringSendIov = 64;
+
+struct UringSend {
+  msghdr msg;
+  iovec iov[kUringSendIov];
+};
+
+// Operations a TCP connection has outstanding in the ring.
+struct UringConnOps {
+  bool recv_armed = false;
+  bool send_in_flight = false;
+  std::unique_ptr<UringSend> send;
+};
+
+// Completions of a multishot accept, multishot recvs into provided buffers
+// and one sendmsg per connection at a time. Everything prepared in a pass
+// goes out with the next io_uring_enter.
+class UringTcpIoThread : public TcpIoThread {
+ public:
+  UringTcpIoThread(const TcpIoContext& context, std::unique_ptr<UringReactor> uring)
+      : TcpIoThread(context), uring_(std::move(uring)) {
+  }
+
+ protected:
+  bool Init() override;
+  void Poll(int timeout_ms) override;
+  bool FlushSendQueue(Conn& conn) override {
+    SubmitSend(conn);
+    return true;
+  }
+  void StopReads(Conn& conn) override {
+    if (OpsOf(conn.fd).recv_armed) {
+      uring_->PrepareCancel(UringData(UringOp::Recv, conn.fd, conn.generation),
+                            UringData(UringOp::Cancel, conn.fd));
+    }
+  }
+  bool ResumeReads(Conn& conn) override {
+    if (!OpsOf(conn.fd).recv_armed) {
+      ArmRecv(conn);
+    }
+    return true;
+  }
+  void CloseSocket(Conn& conn) override;
+
+ private:
+  UringConnOps& OpsOf(int fd);
+  void ArmRecv(const Conn& conn);
+  void SubmitSend(Conn& conn);
+  void FinishClose(int fd);
+  bool FeedConn(Conn& conn, const char* data, std::size_t len);
+  void HandleAccept(const UringCompletion& cqe);
+  void HandleRecv(const UringCompletion& cqe);
+  void HandleSend(const UringCompletion& cqe);
+  void HandleCompletion(const UringCompletion& cqe);
+
+  std::unique_ptr<UringReactor> uring_;
+  std::vector<UringConnOps> ops_;
+  std::uint64_t enter_calls_ = 0;
+};
+
+bool UringTcpIoThread::Init() {
+  uring_->PrepareMultishotAccept(listen_fd_, UringData(UringOp::Accept, listen_fd_));
+  uring_->PrepareMultishotPoll(notifier_.Fd(), UringData(UringOp::Notify, notifier_.Fd()));
+  return true;
+}
+
+UringConnOps& UringTcpIoThread::OpsOf(int fd) {
+  if (static_cast<std::size_t>(fd) >= ops_.size()) {
+    ops_.resize(static_cast<std::size_t>(fd) + 1);
+  }
+  return ops_[static_cast<std::size_t>(fd)];
+}
+
+void UringTcpIoThread::ArmRecv(const Conn& conn) {
+  uring_->PrepareMultishotRecv(conn.fd, UringData(UringOp::Recv, conn.fd, conn.generation));
+  OpsOf(conn.fd).recv_armed = true;
+}
+
+// One sendmsg per connection is in flight at a time; chunks appended
+// meanwhile wait for its completion, which submits the rest.
+void UringTcpIoThread::SubmitSend(Conn& conn) {
+  UringConnOps& ops = OpsOf(conn.fd);
+  SendQueue* queue = conn.send_queue.get();
+  if (!ops.send_in_flight && queue && !queue->Empty()) {
+    if (!ops.send) {
+      ops.send = std::make_unique<UringSend>();
+    }
+    msghdr& msg = ops.send->msg;
+    std::memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = ops.send->iov;
+    msg.msg_iovlen = static_cast<std::size_t>(queue->FillIov(ops.send->iov, kUringSendIov));
+    uring_->PrepareSendMsg(conn.fd, &msg, UringData(UringOp::Send, conn.fd, conn.generation));
+    ops.send_in_flight = true;
+    AddCounter(counters_.send_syscalls, 1);
+  }
+  conn.write_armed = ops.send_in_flight;
+  UpdateSendWatermarks(conn);
+}
+
+// The fd stays open until the kernel is done with every operation on it,
+// so it cannot be reused under an in-flight send or recv.
+void UringTcpIoThread::FinishClose(int fd) {
+  const UringConnOps& ops = OpsOf(fd);
+  if (ops.recv_armed || ops.send_in_flight) {
+    return;
+  }
+  ::close(fd);
+  conn_table_.Remove(fd);
+  logger_->debug("tcp connection closed fd={}", fd);
+}
+
+void UringTcpIoThread::CloseSocket(Conn& conn) {
+  int fd = conn.fd;
+  conn.state = ConnState::Closing;
+  ::shutdown(fd, SHUT_RDWR);
+  AddCounter(counters_.io_syscalls, 1);
+  if (OpsOf(fd).recv_armed) {
+    uring_->PrepareCancel(UringData(UringOp::Recv, fd, conn.generation),
+                          UringData(UringOp::Cancel, fd));
+  }
+  FinishClose(fd);
+}
+
+// Frames bytes the kernel placed in a provided buffer. They are parsed in
+// place when no partial message is pending and only a trailing partial
+// message is copied into the connection's ring.
+bool UringTcpIoThread::FeedConn(Conn& conn, const char* data, std::size_t len) {
+  if (!conn.recv_ring || conn.recv_ring->Size() == 0) {
+    std::size_t consumed = framer_.Feed(data, len, framed_);
+    if (consumed == ProtocolHandler::kFrameError) {
+      logger_->warn("tcp connection fd={} sent an unframeable stream", conn.fd);
+      return false;
+    }
+    PostFramed(conn);
+    data += consumed;
+    len -= consumed;
+  }
+  while (len > 0) {
+    RecvRing& ring = AcquireRing(conn);
+    iovec parts[2];
+    int part_count = ring.FillIov(parts);
+    if (part_count == 0) {
+      logger_->warn("tcp connection fd={} sent a message over {} bytes", conn.fd,
+                    config_.tcp_max_message_size);
+      return false;
+    }
+    std::size_t copied = 0;
+    for (int i = 0; i < part_count && copied < len; ++i) {
+      std::size_t chunk = std::min(parts[i].iov_len, len - copied);
+      std::memcpy(parts[i].iov_base, data + copied, chunk);
+      copied += chunk;
+    }
+    ring.Commit(copied);
+    data += copied;
+    len -= copied;
+    std::size_t consumed = framer_.Feed(ring.Data(), ring.Size(), framed_);
+    if (consumed == ProtocolHandler::kFrameError) {
+      logger_->warn("tcp connection fd={} sent an unframeable stream", conn.fd);
+      return false;
+    }
+    ring.Consume(consumed);
+    PostFramed(conn);
+  }
+  conn_table_.Info(conn.fd).last_active_ms = NowMs();
+  ReleaseRing(conn);
+  return true;
+}
+
+void UringTcpIoThread::HandleAccept(const UringCompletion& cqe) {
+  if (cqe.res >= 0) {
+    int client_fd = cqe.res;
+    Conn* conn = conn_table_.Add(client_fd);
+    if (!conn) {
+      ::close(client_fd);
+    } else {
+      // Multishot accept does not return the peer address.
+      sockaddr_in addr;
+      std::memset(&addr, 0, sizeof(addr));
+      socklen_t addr_len = sizeof(addr);
+      ::getpeername(client_fd, reinterpret_cast<sockaddr*>(&addr), &addr_len);
+      AddCounter(counters_.io_syscalls, 1);
+      SetupConn(*conn, addr);
+      ArmRecv(*conn);
+    }
+  } else if (cqe.res != -EINTR && cqe.res != -ECONNABORTED && cqe.res != -EAGAIN) {
+    logger_->warn("tcp io thread {} accept failed errno={}", index_, -cqe.res);
+  }
+  if (!cqe.More()) {
+    uring_->PrepareMultishotAccept(listen_fd_, cqe.user_data);
+  }
+}
+
+void UringTcpIoThread::HandleRecv(const UringCompletion& cqe) {
+  int fd = UringDataFd(cqe.user_data);
+  Conn* conn = conn_table_.Find(fd, UringDataGeneration(cqe.user_data));
+  if (!cqe.More()) {
+    OpsOf(fd).recv_armed = false;
+  }
+  bool ok = true;
+  if (cqe.HasBuffer()) {
+    unsigned buffer = cqe.BufferId();
+    if (conn && conn->state == ConnState::Established && cqe.res > 0) {
+      ok = FeedConn(*conn, uring_->Buffer(buffer), static_cast<std::size_t>(cqe.res));
+    }
+    uring_->RecycleBuffer(buffer);
+  }
+  if (!conn) {
+    return;
+  }
+  if (conn->state == ConnState::Closing) {
+    FinishClose(fd);
+    return;
+  }
+  if (!ok || cqe.res == 0 || (cqe.res < 0 && cqe.res != -ENOBUFS && cqe.res != -ECANCELED)) {
+    CloseConn(fd, EventKind::Closed);
+    return;
+  }
+  if (conn->read_paused) {
+    return;
+  }
+  // Bytes already received are delivered either way; pausing only stops
+  // the kernel from filling more buffers for this connection.
+  if (WorkerBacklogged(*conn)) {
+    PauseReads(*conn);
+  } else if (!OpsOf(fd).recv_armed) {
+    ArmRecv(*conn);
+  }
+}
+
+void UringTcpIoThread::HandleSend(const UringCompletion& cqe) {
+  int fd = UringDataFd(cqe.user_data);
+  Conn* conn = conn_table_.Find(fd, UringDataGeneration(cqe.user_data));
+  if (!conn) {
+    return;
+  }
+  OpsOf(fd).send_in_flight = false;
+  if (conn->state == ConnState::Closing) {
+    FinishClose(fd);
+    return;
+  }
+  if (cqe.res < 0 && cqe.res != -EINTR && cqe.res != -EAGAIN) {
+    CloseConn(fd, EventKind::Closed);
+    return;
+  }
+  if (cqe.res > 0) {
+    conn->send_queue->Consume(static_cast<std::size_t>(cqe.res));
+  }
+  SubmitSend(*conn);
+}
+
+void UringTcpIoThread::HandleCompletion(const UringCompletion& cqe) {
+  switch (UringDataOp(cqe.user_data)) {
+    case UringOp::Notify:
+      notifier_.Drain();
+      if (!cqe.More()) {
+        uring_->PrepareMultishotPoll(notifier_.Fd(), cqe.user_data);
+      }
+      break;
+    case UringOp::Accept:
+      HandleAccept(cqe);
+      break;
+    case UringOp::Recv:
+      HandleRecv(cqe);
+      break;
+    case UringOp::Send:
+      HandleSend(cqe);
+      break;
+    case UringOp::Cancel:
+      break;
+  }
+}
+
+void UringTcpIoThread::Poll(int timeout_ms) {
+  // Everything prepared during the previous pass goes out with this wait.
+  uring_->SubmitAndWait(timeout_ms);
+  notifier_.Unpark();
+  uring_->ForEachCompletion([this](const UringCompletion& cqe) { HandleCompletion(cqe); });
+  AddCounter(counters_.io_syscalls, uring_->EnterCalls() - enter_calls_);
+  enter_calls_ = uring_->EnterCalls();
+}
+
+}  // namespace
+
+std::unique_ptr<TcpIoThread> MakeUringTcpIoThread(const TcpIoContext& context) {
+  const AppConfig& config = *context.config;
+  std::unique_ptr<UringReactor> uring =
+      MakeUringReactor(config, "tcp", context.index, config.io_uring_buffer_count,
+                       config.io_uring_buffer_size);
+  if (!uring) {
+    return nullptr;
+  }
+  return std::make_unique<UringTcpIoThread>(context, std::move(uring));
+}
+
+}  // namespace backend
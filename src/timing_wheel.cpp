@@ -0,0 +1,130 @@
+#include "timing_wheel.h"
+
+namespace backend {
+
+TimingWheel::TimingWheel(std::uint64_t tick_ms, std::uint64_t now_ms)
+    : tick_ms_(tick_ms > 0 ? tick_ms : 1),
+      current_tick_(now_ms / tick_ms_),
+      slots_(static_cast<std::size_t>(kLevels) * kSlots, kInvalidTimer),
+      free_head_(kInvalidTimer),
+      size_(0) {
+}
+
+std::uint32_t TimingWheel::Schedule(std::uint64_t key, std::uint64_t deadline_ms) {
+  std::uint32_t timer = free_head_;
+  if (timer != kInvalidTimer) {
+    free_head_ = nodes_[timer].next;
+  } else {
+    timer = static_cast<std::uint32_t>(nodes_.size());
+    nodes_.emplace_back();
+  }
+  Node& node = nodes_[timer];
+  node.key = key;
+  node.expire_tick = (deadline_ms + tick_ms_ - 1) / tick_ms_;
+  if (node.expire_tick <= current_tick_) {
+    node.expire_tick = current_tick_ + 1;
+  }
+  Link(timer);
+  ++size_;
+  return timer;
+}
+
+void TimingWheel::Cancel(std::uint32_t timer) {
+  if (timer >= nodes_.size() || nodes_[timer].slot == kInvalidTimer) {
+    return;
+  }
+  Unlink(timer);
+  Release(timer);
+}
+
+void TimingWheel::Advance(std::uint64_t now_ms, std::vector<std::uint64_t>& expired) {
+  std::uint64_t target = now_ms / tick_ms_;
+  if (size_ == 0 && target > current_tick_) {
+    current_tick_ = target;
+    return;
+  }
+  while (current_tick_ < target) {
+    ++current_tick_;
+    // Cascade from the coarsest level that wrapped down to level 1, so timers
+    // that fall through several levels end up in the level 0 slot below.
+    int top = 0;
+    while (top + 1 < kLevels &&
+           (current_tick_ & ((std::uint64_t(1) << (kSlotBits * (top + 1))) - 1)) == 0) {
+      ++top;
+    }
+    for (int level = top; level >= 1; --level) {
+      std::uint32_t slot = static_cast<std::uint32_t>(level) * kSlots +
+                           static_cast<std::uint32_t>(
+                               (current_tick_ >> (kSlotBits * level)) & (kSlots - 1));
+      std::uint32_t timer = TakeSlot(slot);
+      while (timer != kInvalidTimer) {
+        std::uint32_t next = nodes_[timer].next;
+        Link(timer);
+        timer = next;
+      }
+    }
+    std::uint32_t timer =
+        TakeSlot(static_cast<std::uint32_t>(current_tick_ & (kSlots - 1)));
+    while (timer != kInvalidTimer) {
+      std::uint32_t next = nodes_[timer].next;
+      if (nodes_[timer].expire_tick > current_tick_) {
+        Link(timer);
+      } else {
+        expired.push_back(nodes_[timer].key);
+        Release(timer);
+      }
+      timer = next;
+    }
+  }
+}
+
+void TimingWheel::Link(std::uint32_t timer) {
+  Node& node = nodes_[timer];
+  std::uint64_t delta = node.expire_tick - current_tick_;
+  std::uint64_t tick = node.expire_tick;
+  int level = 0;
+  while (level + 1 < kLevels && delta >= (std::uint64_t(1) << (kSlotBits * (level + 1)))) {
+    ++level;
+  }
+  std::uint64_t span = std::uint64_t(1) << (kSlotBits * kLevels);
+  if (delta >= span) {
+    tick = current_tick_ + span - 1;
+  }
+  std::uint32_t slot = static_cast<std::uint32_t>(level) * kSlots +
+                       static_cast<std::uint32_t>((tick >> (kSlotBits * level)) & (kSlots - 1));
+  node.slot = slot;
+  node.prev = kInvalidTimer;
+  node.next = slots_[slot];
+  if (node.next != kInvalidTimer) {
+    nodes_[node.next].prev = timer;
+  }
+  slots_[slot] = timer;
+}
+
+void TimingWheel::Unlink(std::uint32_t timer) {
+  Node& node = nodes_[timer];
+  if (node.prev != kInvalidTimer) {
+    nodes_[node.prev].next = node.next;
+  } else {
+    slots_[node.slot] = node.next;
+  }
+  if (node.next != kInvalidTimer) {
+    nodes_[node.next].prev = node.prev;
+  }
+}
+
+void TimingWheel::Release(std::uint32_t timer) {
+  Node& node = nodes_[timer];
+  node.slot = kInvalidTimer;
+  node.next = free_head_;
+  free_head_ = timer;
+  --size_;
+}
+
+std::uint32_t TimingWheel::TakeSlot(std::uint32_t slot) {
+  std::uint32_t head = slots_[slot];
+  slots_[slot] = kInvalidTimer;
+  return head;
+}
+
+}  // namespace backend
@@ -0,0 +1,338 @@
+#include "udp_io_thread.h"
+
+#include "io_thread.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <netinet/udp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace backend {
+
+namespace {
+
+const int kMaxEpollEvents = 64;
+// Limits of one UDP_SEGMENT send: the kernel's segment count and the
+// largest IPv4 UDP payload.
+const std::size_t kUdpMaxSegments = 64;
+const std::size_t kUdpMaxGsoBytes = 65507;
+// Largest datagram coalesced: an Ethernet MTU less the IPv4 and UDP headers.
+// The socket is not connected, so IP_MTU has no route to report on; a
+// larger segment would be refused or fragmented.
+const std::size_t kUdpMaxGsoSegment = 1472;
+
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+#ifndef UDP_GRO
+#define UDP_GRO 104
+#endif
+
+// Ancillary data of one UDP_SEGMENT send or UDP_GRO receive.
+struct UdpSegmentControl {
+  alignas(cmsghdr) char data[CMSG_SPACE(sizeof(int))];
+};
+
+// Readiness through epoll, a recvmmsg batch per syscall and replies
+// coalesced into sendmmsg batches, with segmentation offload when the
+// kernel has it.
+class EpollUdpIoThread : public UdpIoThread {
+ public:
+  explicit EpollUdpIoThread(const UdpIoContext& context)
+      : UdpIoThread(context),
+        batch_size_(context.config->udp_batch_size),
+        max_datagram_(context.config->udp_max_datagram_size),
+        events_(kMaxEpollEvents),
+        send_msgs_(batch_size_),
+        send_iov_(batch_size_),
+        send_addrs_(batch_size_),
+        send_payloads_(batch_size_),
+        send_controls_(batch_size_),
+        send_first_(batch_size_) {
+  }
+
+  ~EpollUdpIoThread() override {
+    if (epoll_fd_ >= 0) {
+      ::close(epoll_fd_);
+    }
+  }
+
+ protected:
+  bool Init() override;
+  void Poll(int timeout_ms) override;
+  void SendDatagram(const sockaddr_in& addr, std::string&& payload) override;
+  std::string SparePayload() override {
+    return std::move(send_payloads_[send_count_]);
+  }
+  void FlushSends() override;
+
+ private:
+  void ReceiveBatches();
+  std::size_t BuildSendMessages(std::size_t first);
+
+  const std::size_t batch_size_;
+  const std::size_t max_datagram_;
+  int epoll_fd_ = -1;
+  std::vector<epoll_event> events_;
+  bool udp_gso_ = false;
+  bool udp_gro_ = false;
+  // recvmmsg/sendmmsg batches, set up once. Receive buffers are left
+  // uninitialized, so pages are only committed once datagrams that large
+  // actually arrive.
+  std::unique_ptr<char[]> recv_buffers_;
+  std::vector<mmsghdr> recv_msgs_;
+  std::vector<iovec> recv_iov_;
+  std::vector<sockaddr_in> recv_addrs_;
+  std::vector<UdpSegmentControl> recv_controls_;
+  // Datagrams of one recvmmsg call, GRO buffers split, and their classes.
+  std::vector<const char*> batch_data_;
+  std::vector<std::size_t> batch_len_;
+  std::vector<std::size_t> batch_addr_;
+  PacketBatch batch_;
+  std::vector<mmsghdr> send_msgs_;
+  std::vector<iovec> send_iov_;
+  std::vector<sockaddr_in> send_addrs_;
+  std::vector<std::string> send_payloads_;
+  std::vector<UdpSegmentControl> send_controls_;
+  // Index of the first queued datagram of every message built for a flush.
+  std::vector<std::size_t> send_first_;
+  std::size_t send_count_ = 0;
+  // Datagrams before no_gso_end_ go out one per message.
+  std::size_t no_gso_end_ = 0;
+};
+
+bool EpollUdpIoThread::Init() {
+  epoll_fd_ = ::epoll_create1(0);
+  if (epoll_fd_ < 0) {
+    logger_->error("udp io thread {} failed to create epoll", index_);
+    return false;
+  }
+  epoll_event ev;
+  ev.events = EPOLLIN;
+  ev.data.fd = udp_fd_;
+  if (::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, udp_fd_, &ev) < 0) {
+    logger_->error("udp io thread {} failed to add udp fd to epoll", index_);
+    return false;
+  }
+  ev.events = EPOLLIN;
+  ev.data.fd = notifier_.Fd();
+  if (::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, notifier_.Fd(), &ev) < 0) {
+    logger_->error("udp io thread {} failed to add notifier to epoll", index_);
+    return false;
+  }
+  // Segmentation offload is used when the kernel has it. GRO only pays off
+  // when a receive slot can hold a whole coalesced buffer.
+  if (config_.udp_gso) {
+    int segment = 0;
+    socklen_t segment_len = sizeof(segment);
+    udp_gso_ = ::getsockopt(udp_fd_, SOL_UDP, UDP_SEGMENT, &segment, &segment_len) == 0;
+  }
+  if (config_.udp_gro && max_datagram_ >= kUdpMaxGsoBytes) {
+    int on = 1;
+    udp_gro_ = ::setsockopt(udp_fd_, SOL_UDP, UDP_GRO, &on, sizeof(on)) == 0;
+  }
+  if ((config_.udp_gso && !udp_gso_) || (config_.udp_gro && !udp_gro_)) {
+    logger_->info("udp io thread {} gso={} gro={}", index_, udp_gso_, udp_gro_);
+  }
+  recv_buffers_.reset(new char[batch_size_ * max_datagram_]);
+  recv_msgs_.resize(batch_size_);
+  recv_iov_.resize(batch_size_);
+  recv_addrs_.resize(batch_size_);
+  recv_controls_.resize(batch_size_);
+  for (std::size_t i = 0; i < batch_size_; ++i) {
+    recv_iov_[i].iov_base = recv_buffers_.get() + i * max_datagram_;
+    recv_iov_[i].iov_len = max_datagram_;
+    std::memset(&recv_msgs_[i], 0, sizeof(recv_msgs_[i]));
+    recv_msgs_[i].msg_hdr.msg_name = &recv_addrs_[i];
+    recv_msgs_[i].msg_hdr.msg_iov = &recv_iov_[i];
+    recv_msgs_[i].msg_hdr.msg_iovlen = 1;
+  }
+  return true;
+}
+
+void EpollUdpIoThread::Poll(int timeout_ms) {
+  int n = ::epoll_wait(epoll_fd_, events_.data(), static_cast<int>(events_.size()), timeout_ms);
+  notifier_.Unpark();
+  for (int i_event = 0; i_event < n; ++i_event) {
+    int fd = events_[i_event].data.fd;
+    if (fd == notifier_.Fd()) {
+      notifier_.Drain();
+    } else if (fd == udp_fd_) {
+      ReceiveBatches();
+    }
+  }
+}
+
+// Drains the socket a batch per syscall; a short batch means it is empty.
+void EpollUdpIoThread::ReceiveBatches() {
+  while (true) {
+    for (std::size_t i = 0; i < batch_size_; ++i) {
+      recv_msgs_[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+      recv_msgs_[i].msg_hdr.msg_flags = 0;
+      if (udp_gro_) {
+        recv_msgs_[i].msg_hdr.msg_control = recv_controls_[i].data;
+        recv_msgs_[i].msg_hdr.msg_controllen = sizeof(recv_controls_[i].data);
+      }
+    }
+    int received = ::recvmmsg(udp_fd_, recv_msgs_.data(), static_cast<unsigned>(batch_size_),
+                              MSG_DONTWAIT, nullptr);
+    AddCounter(counters_.recv_syscalls, 1);
+    if (received <= 0) {
+      return;
+    }
+    for (int i = 0; i < received; ++i) {
+      mmsghdr& msg = recv_msgs_[static_cast<std::size_t>(i)];
+      AddCounter(counters_.recv_buffers, 1);
+      if ((msg.msg_hdr.msg_flags & MSG_TRUNC) != 0) {
+        AddCounter(counters_.received_datagrams, 1);
+        AddCounter(counters_.truncated_datagrams, 1);
+        continue;
+      }
+      // A GRO buffer holds equal-sized datagrams, the last one shorter.
+      std::size_t segment = msg.msg_len;
+      for (cmsghdr* cmsg = udp_gro_ ? CMSG_FIRSTHDR(&msg.msg_hdr) : nullptr; cmsg;
+           cmsg = CMSG_NXTHDR(&msg.msg_hdr, cmsg)) {
+        if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO) {
+          int gro_size = 0;
+          std::memcpy(&gro_size, CMSG_DATA(cmsg), sizeof(gro_size));
+          if (gro_size > 0) {
+            segment = static_cast<std::size_t>(gro_size);
+          }
+        }
+      }
+      const char* data = static_cast<const char*>(msg.msg_hdr.msg_iov->iov_base);
+      std::size_t offset = 0;
+      do {
+        std::size_t length = std::min(segment, msg.msg_len - offset);
+        batch_data_.push_back(data + offset);
+        batch_len_.push_back(length);
+        batch_addr_.push_back(static_cast<std::size_t>(i));
+        offset += length;
+      } while (offset < msg.msg_len);
+    }
+    // The whole batch is classified before any of it is handled.
+    ClassifyPackets(batch_data_.data(), batch_len_.data(), batch_data_.size(), batch_);
+    for (std::size_t d = 0; d < batch_data_.size(); ++d) {
+      RtpHeader header{};
+      if (batch_.kind[d] == PacketClass::Rtp) {
+        header = batch_.Header(d);
+      }
+      HandleDatagram(batch_data_[d], batch_len_[d], recv_addrs_[batch_addr_[d]],
+                     batch_.kind[d], header);
+      AddCounter(counters_.received_datagrams, 1);
+    }
+    batch_data_.clear();
+    batch_len_.clear();
+    batch_addr_.clear();
+    if (static_cast<std::size_t>(received) < batch_size_) {
+      return;
+    }
+  }
+}
+
+void EpollUdpIoThread::SendDatagram(const sockaddr_in& addr, std::string&& payload) {
+  std::size_t i = send_count_++;
+  send_addrs_[i] = addr;
+  send_payloads_[i] = std::move(payload);
+  send_iov_[i].iov_base = &send_payloads_[i][0];
+  send_iov_[i].iov_len = send_payloads_[i].size();
+  if (send_count_ == batch_size_) {
+    FlushSends();
+  }
+}
+
+// Builds one message per queued datagram, or with GSO one message per run
+// of equal-sized datagrams to the same peer (the last may be shorter),
+// which the kernel splits back into datagrams.
+std::size_t EpollUdpIoThread::BuildSendMessages(std::size_t first) {
+  std::size_t msg_count = 0;
+  for (std::size_t i = first; i < send_count_; ++msg_count) {
+    std::size_t segment = send_iov_[i].iov_len;
+    std::size_t end = i + 1;
+    if (udp_gso_ && i >= no_gso_end_ && segment > 0 && segment <= kUdpMaxGsoSegment) {
+      std::size_t bytes = segment;
+      while (end < send_count_ && end - i < kUdpMaxSegments &&
+             send_addrs_[end].sin_addr.s_addr == send_addrs_[i].sin_addr.s_addr &&
+             send_addrs_[end].sin_port == send_addrs_[i].sin_port &&
+             send_iov_[end].iov_len > 0 && send_iov_[end].iov_len <= segment &&
+             bytes + send_iov_[end].iov_len <= kUdpMaxGsoBytes) {
+        bytes += send_iov_[end].iov_len;
+        ++end;
+        if (send_iov_[end - 1].iov_len < segment) {
+          break;
+        }
+      }
+    }
+    mmsghdr& msg = send_msgs_[msg_count];
+    std::memset(&msg, 0, sizeof(msg));
+    msg.msg_hdr.msg_name = &send_addrs_[i];
+    msg.msg_hdr.msg_namelen = sizeof(sockaddr_in);
+    msg.msg_hdr.msg_iov = &send_iov_[i];
+    msg.msg_hdr.msg_iovlen = end - i;
+    if (end - i > 1) {
+      msg.msg_hdr.msg_control = send_controls_[msg_count].data;
+      msg.msg_hdr.msg_controllen = CMSG_SPACE(sizeof(std::uint16_t));
+      cmsghdr* cmsg = CMSG_FIRSTHDR(&msg.msg_hdr);
+      cmsg->cmsg_level = SOL_UDP;
+      cmsg->cmsg_type = UDP_SEGMENT;
+      cmsg->cmsg_len = CMSG_LEN(sizeof(std::uint16_t));
+      std::uint16_t segment_size = static_cast<std::uint16_t>(segment);
+      std::memcpy(CMSG_DATA(cmsg), &segment_size, sizeof(segment_size));
+    }
+    send_first_[msg_count] = i;
+    i = end;
+  }
+  return msg_count;
+}
+
+void EpollUdpIoThread::FlushSends() {
+  std::size_t sent = 0;
+  while (sent < send_count_) {
+    std::size_t msg_count = BuildSendMessages(sent);
+    int n = ::sendmmsg(udp_fd_, send_msgs_.data(), static_cast<unsigned>(msg_count), 0);
+    AddCounter(counters_.send_syscalls, 1);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n < 0 && send_msgs_[0].msg_hdr.msg_iovlen > 1 && (errno == EIO || errno == EINVAL)) {
+      // No checksum offload on the route or a segment above its MTU:
+      // resend this run without segmentation.
+      no_gso_end_ = msg_count > 1 ? send_first_[1] : send_count_;
+      continue;
+    }
+    if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != ENOBUFS) {
+      // Only the first message failed, for example a peer the route
+      // rejects; drop it and go on with the rest.
+      std::size_t next = msg_count > 1 ? send_first_[1] : send_count_;
+      AddCounter(counters_.send_drops, next - sent);
+      sent = next;
+      continue;
+    }
+    if (n <= 0) {
+      // A full socket buffer drops the rest, as sendto did.
+      break;
+    }
+    std::size_t next = static_cast<std::size_t>(n) < msg_count
+                           ? send_first_[static_cast<std::size_t>(n)]
+                           : send_count_;
+    AddCounter(counters_.sent_datagrams, next - sent);
+    AddCounter(counters_.send_buffers, static_cast<std::uint64_t>(n));
+    sent = next;
+  }
+  AddCounter(counters_.send_drops, send_count_ - sent);
+  send_count_ = 0;
+  no_gso_end_ = 0;
+}
+
+}  // namespace
+
+std::unique_ptr<UdpIoThread> MakeEpollUdpIoThread(const UdpIoContext& context) {
+  return std::make_unique<EpollUdpIoThread>(context);
+}
+
+}  // namespace backend
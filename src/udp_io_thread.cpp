@@ -0,0 +1,560 @@
+#include "udp_io_thread.h"
+
+#include "conn.h"
+#include "io_thread.h"
+#include "logger.h"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+#include <arpa/inet.h>
+
+namespace backend {
+
+namespace {
+
+// Index bytes preallocated per payload byte of a segment: one 32-byte
+// record per packet of about a kilobyte.
+const std::uint64_t kRtpIndexReserveDivisor = 32;
+// Worker queue drains whose replies are coalesced into one send batch.
+const int kUdpOutboundDrains = 8;
+// An RR with one report block and an SDES with a CNAME of up to 255 bytes.
+constexpr std::size_t kRtcpReportMaxSize = 32 + 268;
+
+// Flags kept with an RTP packet from arrival to its in-order delivery.
+constexpr std::uint32_t kRtpToLua = 1;
+constexpr std::uint32_t kRtpForwarded = 2;
+
+}  // namespace
+
+UdpIoThread::UdpIoThread(const UdpIoContext& context)
+    : config_(*context.config),
+      index_(context.index),
+      udp_fd_(context.udp_fd),
+      notifier_(*context.notifier),
+      counters_(*context.counters),
+      logger_(GetLogger()),
+      running_(*context.running),
+      inbound_(*context.inbound),
+      rtcp_queues_(*context.rtcp_queues),
+      to_workers_(*context.to_workers),
+      to_disk_(*context.to_disk),
+      udp_sessions_(*context.udp_sessions),
+      rtp_sessions_(*context.rtp_sessions),
+      rtp_forwards_(*context.rtp_forwards),
+      rtcp_ssrc_(context.rtcp_ssrc),
+      udp_idle_wheel_(kIdleWheelTickMs, NowMs()),
+      rtp_idle_wheel_(kIdleWheelTickMs, NowMs()),
+      pending_events_(context.to_workers->size()),
+      outbound_(context.config->queue_batch_size),
+      rtcp_tasks_(context.config->queue_batch_size),
+      report_random_(static_cast<unsigned>(context.index) + 1) {
+  next_report_ms_ =
+      NextRtcpReportMs(NowMs(), config_.rtcp_report_interval_ms, report_random_());
+}
+
+UdpIoThread::~UdpIoThread() = default;
+
+std::unique_ptr<UdpIoThread> UdpIoThread::Create(const UdpIoContext& context) {
+  std::unique_ptr<UdpIoThread> thread = MakeUringUdpIoThread(context);
+  if (!thread) {
+    thread = MakeEpollUdpIoThread(context);
+  }
+  if (!thread->Init()) {
+    return nullptr;
+  }
+  return thread;
+}
+
+void UdpIoThread::ForwardRtp(const RtpForwardTarget& target, const char* data,
+                             std::size_t len) {
+  sockaddr_in to;
+  std::memset(&to, 0, sizeof(to));
+  to.sin_family = AF_INET;
+  if (target.session_id != 0) {
+    UdpSession session;
+    if (!udp_sessions_.FindById(target.session_id, session)) {
+      return;
+    }
+    to.sin_addr.s_addr = session.remote_addr;
+    to.sin_port = htons(session.remote_port);
+  } else {
+    to.sin_addr.s_addr = target.remote_addr;
+    to.sin_port = htons(target.remote_port);
+  }
+  std::string payload = SparePayload();
+  payload.assign(data, len);
+  SendDatagram(to, std::move(payload));
+  AddCounter(counters_.forwarded_rtp, 1);
+}
+
+// Queued behind the segment's appends on the same disk queue. A segment
+// whose seal is dropped stays unfinished until the next start seals it.
+void UdpIoThread::SealRecording(int worker, const std::string& part_path) {
+  DiskTask seal;
+  seal.op = DiskOp::Seal;
+  seal.path = part_path;
+  if (!to_disk_[static_cast<std::size_t>(worker)]->Push(std::move(seal))) {
+    AddCounter(counters_.recording_drops, 1);
+  }
+}
+
+void UdpIoThread::SealRtpSegment(RtpStreamState& stream) {
+  if (stream.record_worker < 0) {
+    return;
+  }
+  SealRecording(stream.record_worker, stream.bin_path);
+  SealRecording(stream.record_worker, stream.index_path);
+  stream.record_worker = -1;
+}
+
+// Passes an RTP packet on to Lua and the recorder, in the order the
+// stream's jitter buffer releases it.
+void UdpIoThread::DeliverRtp(RtpStreamState& stream, const RtpHeader& header,
+                             const char* data, std::size_t len, std::uint64_t now,
+                             std::uint32_t flags) {
+  bool created = false;
+  std::uint64_t offset = 0;
+  RtpSession rtp_session =
+      rtp_sessions_.FindOrCreate(header.ssrc, index_, now, len, &offset, &created);
+  if (created) {
+    rtp_idle_wheel_.Schedule(header.ssrc, now + config_.rtp_idle_timeout_ms);
+  }
+  int worker_index =
+      static_cast<int>(rtp_session.id % static_cast<std::uint64_t>(config_.worker_threads));
+  if ((flags & kRtpToLua) != 0) {
+    Event event;
+    event.protocol = ProtocolType::Rtp;
+    event.kind = (flags & kRtpForwarded) != 0 ? EventKind::Forwarded : EventKind::Message;
+    event.session_id = static_cast<std::uint64_t>(header.ssrc);
+    event.context.timestamp_ms = now;
+    event.context.remote_ip = IpFromSockaddr(stream.last_addr);
+    event.context.remote_port = ntohs(stream.last_addr.sin_port);
+    event.payload.assign(data, len);
+    pending_events_[worker_index].push_back(std::move(event));
+  }
+  if (worker_index < 0 || worker_index >= static_cast<int>(to_disk_.size())) {
+    return;
+  }
+  if (stream.record_id != rtp_session.id) {
+    SealRtpSegment(stream);
+    stream.record_id = rtp_session.id;
+    stream.segments =
+        RecordingSegmenter(config_.recording_segment_bytes, config_.recording_segment_ms);
+  }
+  // Each segment is a recording of its own: offsets start over and its
+  // index gets a header and a first checkpoint.
+  if (stream.segments.Place(offset, len, now)) {
+    SealRtpSegment(stream);
+    std::string base = SegmentName(kRtpRecordingDir + std::string("/session_") +
+                                       std::to_string(rtp_session.id),
+                                   stream.segments.Segment(), WallMs());
+    stream.record_worker = worker_index;
+    stream.bin_path = base + ".bin" + kSegmentPartSuffix;
+    stream.index_path = base + ".ridx" + kSegmentPartSuffix;
+    stream.index = RtpIndexWriter(header.ssrc);
+  }
+  DiskTask record;
+  record.op = DiskOp::Append;
+  record.path = stream.bin_path;
+  record.data.assign(data, len);
+  record.reserve_bytes = config_.recording_segment_bytes;
+  if (!to_disk_[worker_index]->Push(std::move(record))) {
+    AddCounter(counters_.recording_drops, 1);
+    rtp_sessions_.ReturnRecordBytes(header.ssrc, offset, len);
+    return;
+  }
+  DiskTask index_task;
+  index_task.op = DiskOp::Append;
+  index_task.path = stream.index_path;
+  index_task.reserve_bytes = config_.recording_segment_bytes / kRtpIndexReserveDivisor;
+  stream.index.Append(header.sequence_number, header.timestamp, header.payload_type,
+                      header.marker, WallMs(), stream.segments.SegmentOffset(),
+                      static_cast<std::uint32_t>(len), index_task.data);
+  if (!to_disk_[worker_index]->Push(std::move(index_task))) {
+    AddCounter(counters_.recording_drops, 1);
+  }
+}
+
+// Ends an RTP stream on idle expiry or RTCP BYE: whatever its jitter
+// buffer still holds is delivered, its rules are dropped and Lua is told.
+void UdpIoThread::CloseRtp(std::uint32_t ssrc, EventKind kind, std::uint64_t now) {
+  RtpSession rtp_session;
+  if (!rtp_sessions_.Find(ssrc, rtp_session)) {
+    return;
+  }
+  auto stream = rtp_streams_.find(ssrc);
+  if (stream != rtp_streams_.end()) {
+    RtpStreamState& state = *stream->second;
+    state.buffer.Release(std::numeric_limits<std::uint64_t>::max(),
+                         [&](const char* data, std::size_t len, std::uint64_t,
+                             std::uint32_t flags) {
+                           RtpHeader released;
+                           if (ParseRtpHeader(data, len, released)) {
+                             DeliverRtp(state, released, data, len, now, flags);
+                           }
+                         });
+    SealRtpSegment(state);
+    rtp_streams_.erase(stream);
+  }
+  Event event;
+  event.protocol = ProtocolType::Rtp;
+  event.kind = kind;
+  event.session_id = ssrc;
+  event.context.timestamp_ms = now;
+  event.context.remote_port = 0;
+  pending_events_[rtp_session.id % static_cast<std::uint64_t>(config_.worker_threads)]
+      .push_back(std::move(event));
+  rtp_sessions_.Remove(ssrc);
+  rtp_forwards_.Remove(ssrc);
+}
+
+// What RTCP changes in a stream this thread keeps: a sender report gives
+// the address to send reports to, a BYE ends the stream.
+void UdpIoThread::ApplyRtcp(std::uint32_t ssrc, bool bye, const sockaddr_in& addr,
+                            std::uint64_t now) {
+  if (bye) {
+    CloseRtp(ssrc, EventKind::Closed, now);
+    return;
+  }
+  auto stream = rtp_streams_.find(ssrc);
+  if (stream != rtp_streams_.end()) {
+    stream->second->rtcp_addr = addr;
+    stream->second->has_rtcp_addr = true;
+  }
+}
+
+// Streams kept by another thread get it through that thread's queue. A
+// lost BYE leaves the stream to idle expiry.
+void UdpIoThread::RouteRtcp(std::uint32_t ssrc, bool bye, const sockaddr_in& addr,
+                            std::uint64_t now) {
+  RtpSession rtp_session;
+  if (!rtp_sessions_.Find(ssrc, rtp_session)) {
+    return;
+  }
+  std::size_t owner = static_cast<std::size_t>(rtp_session.owner);
+  if (rtp_session.owner == index_ || owner >= rtcp_queues_.size()) {
+    ApplyRtcp(ssrc, bye, addr, now);
+    return;
+  }
+  RtcpTask task;
+  task.ssrc = ssrc;
+  task.bye = bye;
+  task.remote_addr = addr.sin_addr.s_addr;
+  task.remote_port = ntohs(addr.sin_port);
+  rtcp_queues_[owner]->Push(task);
+}
+
+// RTCP stays in C++: SRs feed the LSR/DLSR of our reports, SDES names
+// streams and BYE closes them.
+void UdpIoThread::HandleRtcp(const char* data, std::size_t len, const sockaddr_in& addr,
+                             std::uint64_t now) {
+  AddCounter(counters_.rtcp_packets, 1);
+  rtcp_.Clear();
+  ParseRtcp(data, len, rtcp_);
+  for (const RtcpCompound::SenderReport& report : rtcp_.sender_reports) {
+    rtp_sessions_.NoteSenderReport(report.ssrc, report.info.ntp_timestamp, now);
+    RouteRtcp(report.ssrc, false, addr, now);
+  }
+  for (const auto& cname : rtcp_.cnames) {
+    rtp_sessions_.SetCname(cname.first, cname.second);
+  }
+  for (std::uint32_t ssrc : rtcp_.bye_ssrcs) {
+    RouteRtcp(ssrc, true, addr, now);
+  }
+}
+
+void UdpIoThread::HandleDatagram(const char* data, std::size_t len, const sockaddr_in& addr,
+                                 PacketClass kind, const RtpHeader& header) {
+  std::uint16_t port = ntohs(addr.sin_port);
+  std::uint64_t now = NowMs();
+  if (kind == PacketClass::Rtcp) {
+    HandleRtcp(data, len, addr, now);
+    return;
+  }
+  if (kind == PacketClass::Rtp) {
+    // Forwarding does not wait for the jitter buffer.
+    bool sampled = false;
+    bool forwarded = rtp_forwards_.Lookup(header.ssrc, forward_targets_, &sampled);
+    for (const RtpForwardTarget& target : forward_targets_) {
+      ForwardRtp(target, data, len);
+    }
+    // Packets relayed by a rule reach Lua only when sampled.
+    std::uint32_t flags =
+        (forwarded ? kRtpForwarded : 0) | (!forwarded || sampled ? kRtpToLua : 0);
+    std::unique_ptr<RtpStreamState>& stream = rtp_streams_[header.ssrc];
+    if (!stream) {
+      stream = std::make_unique<RtpStreamState>(
+          header.ssrc, config_.rtp_jitter_buffer_ms, config_.rtp_clock_rate,
+          config_.recording_segment_bytes, config_.recording_segment_ms);
+    }
+    if (!stream->touched) {
+      stream->touched = true;
+      touched_streams_.push_back(header.ssrc);
+    }
+    stream->last_addr = addr;
+    std::uint64_t extended =
+        stream->buffer.Track(header.sequence_number, header.timestamp, now);
+    if (extended == RtpJitterBuffer::kRejected) {
+      return;
+    }
+    if (stream->buffer.DepthMs() == 0) {
+      DeliverRtp(*stream, header, data, len, now, flags);
+      return;
+    }
+    bool created = false;
+    rtp_sessions_.FindOrCreate(header.ssrc, index_, now, 0, nullptr, &created);
+    if (created) {
+      rtp_idle_wheel_.Schedule(header.ssrc, now + config_.rtp_idle_timeout_ms);
+    }
+    stream->buffer.Hold(extended, now, data, len, flags);
+    return;
+  }
+  bool created = false;
+  UdpSession session = udp_sessions_.FindOrCreate(addr.sin_addr.s_addr, port,
+                                                  ProtocolType::Udp, index_, now, &created);
+  if (created) {
+    udp_idle_wheel_.Schedule(session.id, now + config_.udp_idle_timeout_ms);
+  }
+  Event event;
+  event.protocol = ProtocolType::Udp;
+  event.session_id = session.id;
+  event.context.timestamp_ms = now;
+  event.context.remote_ip = IpFromSockaddr(addr);
+  event.context.remote_port = port;
+  event.payload.assign(data, len);
+  int worker_index =
+      static_cast<int>(session.id % static_cast<std::uint64_t>(config_.worker_threads));
+  pending_events_[worker_index].push_back(std::move(event));
+  RecordUdp(session.id, worker_index, data, len, now);
+}
+
+void UdpIoThread::RecordUdp(std::uint64_t session_id, int worker, const char* data,
+                            std::size_t len, std::uint64_t now) {
+  if (worker < 0 || worker >= static_cast<int>(to_disk_.size())) {
+    return;
+  }
+  auto found = udp_recordings_.find(session_id);
+  if (found == udp_recordings_.end()) {
+    found = udp_recordings_
+                .emplace(session_id, UdpRecording(config_.recording_segment_bytes,
+                                                  config_.recording_segment_ms))
+                .first;
+  }
+  UdpRecording& recording = found->second;
+  if (recording.segments.Place(recording.bytes, len, now)) {
+    if (recording.worker >= 0) {
+      SealRecording(recording.worker, recording.path);
+    }
+    recording.worker = worker;
+    recording.path = SegmentName(kUdpRecordingDir + std::string("/udp_session_") +
+                                     std::to_string(session_id),
+                                 recording.segments.Segment(), WallMs()) +
+                     ".bin" + kSegmentPartSuffix;
+  }
+  DiskTask record;
+  record.op = DiskOp::Append;
+  record.path = recording.path;
+  record.data.assign(data, len);
+  record.reserve_bytes = config_.recording_segment_bytes;
+  if (to_disk_[worker]->Push(std::move(record))) {
+    recording.bytes += len;
+  } else {
+    AddCounter(counters_.recording_drops, 1);
+  }
+}
+
+// Releases what the jitter buffer allows and publishes the stream's
+// statistics.
+void UdpIoThread::ReleaseStream(std::uint32_t ssrc, RtpStreamState& stream,
+                                std::uint64_t now) {
+  stream.buffer.Release(now, [&](const char* data, std::size_t len, std::uint64_t,
+                                 std::uint32_t flags) {
+    RtpHeader released;
+    if (ParseRtpHeader(data, len, released)) {
+      DeliverRtp(stream, released, data, len, now, flags);
+    }
+  });
+  next_release_ms_ = std::min(next_release_ms_, stream.buffer.NextDueMs());
+  rtp_sessions_.PublishStats(ssrc, stream.buffer.Stats());
+}
+
+// One RR with our SDES per stream that sent something since the last round.
+void UdpIoThread::SendReports(std::uint64_t now) {
+  for (auto& entry : rtp_streams_) {
+    RtpStreamState& stream = *entry.second;
+    const RtpStreamStats& stats = stream.buffer.Stats();
+    if (stats.expected < stream.expected_prior || stats.received < stream.received_prior) {
+      // The sender restarted its sequence and the counts with it.
+      stream.expected_prior = 0;
+      stream.received_prior = 0;
+    }
+    if (stats.received == stream.received_prior) {
+      continue;
+    }
+    RtcpReportBlock block =
+        MakeRtcpReportBlock(entry.first, stats, stream.expected_prior, stream.received_prior);
+    std::uint64_t last_sr_ms = 0;
+    if (rtp_sessions_.LastSenderReport(entry.first, &block.last_sr, &last_sr_ms)) {
+      block.delay_since_last_sr = static_cast<std::uint32_t>((now - last_sr_ms) * 65536 / 1000);
+    }
+    stream.expected_prior = stats.expected;
+    stream.received_prior = stats.received;
+    std::string payload = SparePayload();
+    payload.resize(kRtcpReportMaxSize);
+    std::size_t size =
+        BuildRtcpReport(rtcp_ssrc_, nullptr, &block, 1, &payload[0], payload.size());
+    // The node name is this server's CNAME.
+    size += BuildRtcpSdes(rtcp_ssrc_, config_.node_name, &payload[size], payload.size() - size);
+    payload.resize(size);
+    SendDatagram(stream.has_rtcp_addr ? stream.rtcp_addr : stream.last_addr,
+                 std::move(payload));
+    AddCounter(counters_.rtcp_reports, 1);
+  }
+}
+
+void UdpIoThread::ExpireUdpSessions(std::uint64_t now) {
+  udp_idle_wheel_.Advance(now, expired_);
+  for (std::uint64_t id : expired_) {
+    // Every thread may refresh the session, but only its creator expires it.
+    UdpSession session;
+    if (!udp_sessions_.FindById(id, session)) {
+      continue;
+    }
+    if (now - session.last_active_ms < config_.udp_idle_timeout_ms) {
+      udp_idle_wheel_.Schedule(id, session.last_active_ms + config_.udp_idle_timeout_ms);
+      continue;
+    }
+    Event event;
+    event.protocol = ProtocolType::Udp;
+    event.kind = EventKind::Expired;
+    event.session_id = id;
+    event.context.timestamp_ms = now;
+    event.context.remote_ip = IpFromAddress(session.remote_addr);
+    event.context.remote_port = session.remote_port;
+    pending_events_[id % static_cast<std::uint64_t>(config_.worker_threads)].push_back(
+        std::move(event));
+    udp_sessions_.Remove(id);
+    rtp_forwards_.RemoveSession(id);
+    auto recording = udp_recordings_.find(id);
+    if (recording != udp_recordings_.end()) {
+      if (recording->second.worker >= 0) {
+        SealRecording(recording->second.worker, recording->second.path);
+      }
+      udp_recordings_.erase(recording);
+    }
+  }
+  expired_.clear();
+}
+
+void UdpIoThread::ExpireRtpStreams(std::uint64_t now) {
+  rtp_idle_wheel_.Advance(now, expired_);
+  for (std::uint64_t key : expired_) {
+    std::uint32_t ssrc = static_cast<std::uint32_t>(key);
+    RtpSession rtp_session;
+    if (!rtp_sessions_.Find(ssrc, rtp_session)) {
+      continue;
+    }
+    if (now - rtp_session.last_active_ms < config_.rtp_idle_timeout_ms) {
+      rtp_idle_wheel_.Schedule(key, rtp_session.last_active_ms + config_.rtp_idle_timeout_ms);
+      continue;
+    }
+    CloseRtp(ssrc, EventKind::Expired, now);
+  }
+  expired_.clear();
+}
+
+// RTCP other threads received about streams kept here.
+void UdpIoThread::DrainRtcpQueue(std::uint64_t now) {
+  MpscQueue<RtcpTask>& queue = *rtcp_queues_[static_cast<std::size_t>(index_)];
+  while (std::size_t count = queue.PopBatch(rtcp_tasks_.data(), rtcp_tasks_.size())) {
+    for (std::size_t i_task = 0; i_task < count; ++i_task) {
+      const RtcpTask& task = rtcp_tasks_[i_task];
+      sockaddr_in addr;
+      std::memset(&addr, 0, sizeof(addr));
+      addr.sin_family = AF_INET;
+      addr.sin_port = htons(task.remote_port);
+      addr.sin_addr.s_addr = task.remote_addr;
+      ApplyRtcp(task.ssrc, task.bye, addr, now);
+    }
+  }
+}
+
+// Coalesces a few full drains into the same send batches.
+void UdpIoThread::DrainOutbound() {
+  for (int drain = 0; drain < kUdpOutboundDrains; ++drain) {
+    std::size_t count = inbound_.PopBatch(outbound_.data(), outbound_.size());
+    for (std::size_t i_task = 0; i_task < count; ++i_task) {
+      GenericTask& task = outbound_[i_task];
+      if (task.type != TaskType::Udp) {
+        continue;
+      }
+      UdpSession session;
+      if (!udp_sessions_.FindById(task.session_id, session)) {
+        continue;
+      }
+      sockaddr_in addr;
+      std::memset(&addr, 0, sizeof(addr));
+      addr.sin_family = AF_INET;
+      addr.sin_port = htons(session.remote_port);
+      addr.sin_addr.s_addr = session.remote_addr;
+      SendDatagram(addr, std::move(task.payload));
+    }
+    if (count < outbound_.size()) {
+      break;
+    }
+  }
+}
+
+void UdpIoThread::Run() {
+  while (running_.load()) {
+    notifier_.Park();
+    int timeout_ms = inbound_.Empty() ? kParkTimeoutMs : 0;
+    if (next_release_ms_ != std::numeric_limits<std::uint64_t>::max()) {
+      std::uint64_t wait_now = NowMs();
+      std::uint64_t wait_ms = next_release_ms_ > wait_now ? next_release_ms_ - wait_now : 0;
+      timeout_ms = std::min(timeout_ms, static_cast<int>(std::min<std::uint64_t>(
+                                            wait_ms, static_cast<std::uint64_t>(kParkTimeoutMs))));
+    }
+    Poll(timeout_ms);
+    std::uint64_t now = NowMs();
+    // Streams still holding packets are only revisited once the earliest of
+    // them is due; the rest are those that moved this pass.
+    if (now >= next_release_ms_) {
+      next_release_ms_ = std::numeric_limits<std::uint64_t>::max();
+      for (auto& entry : rtp_streams_) {
+        if (entry.second->buffer.Held() > 0) {
+          ReleaseStream(entry.first, *entry.second, now);
+        }
+      }
+    }
+    for (std::uint32_t ssrc : touched_streams_) {
+      auto it = rtp_streams_.find(ssrc);
+      if (it == rtp_streams_.end()) {
+        continue;
+      }
+      it->second->touched = false;
+      ReleaseStream(ssrc, *it->second, now);
+    }
+    touched_streams_.clear();
+    if (now >= next_report_ms_) {
+      SendReports(now);
+      next_report_ms_ =
+          NextRtcpReportMs(now, config_.rtcp_report_interval_ms, report_random_());
+    }
+    ExpireUdpSessions(now);
+    ExpireRtpStreams(now);
+    DrainRtcpQueue(now);
+    // Datagrams a lagging worker cannot take are dropped rather than queued.
+    if (FlushPendingEvents(pending_events_, to_workers_)) {
+      for (auto& batch : pending_events_) {
+        batch.clear();
+      }
+    }
+    DrainOutbound();
+    FlushSends();
+  }
+}
+
+}  // namespace backend
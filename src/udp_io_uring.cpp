@@ -0,0 +1,177 @@
+#include "udp_io_thread.h"
+
+#include "io_thread.h"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+namespace backend {
+
+namespace {
+
+// io_uring_recvmsg_out plus a sockaddr_in, rounded up.
+const std::size_t kUringRecvMsgHeader = 64;
+const unsigned kUringMinUdpBuffers = 16;
+
+// One outbound datagram owned by the ring until its send completes.
+struct UdpSendSlot {
+  sockaddr_in addr;
+  iovec iov;
+  msghdr msg;
+  std::string payload;
+};
+
+// A multishot recvmsg into provided buffers and one sendmsg per reply. Each
+// reply owns a slot holding its address, iovec and payload until the send
+// completes; all sends of a pass go out with the next io_uring_enter.
+class UringUdpIoThread : public UdpIoThread {
+ public:
+  UringUdpIoThread(const UdpIoContext& context, std::unique_ptr<UringReactor> uring)
+      : UdpIoThread(context), uring_(std::move(uring)) {
+    std::memset(&recv_msg_, 0, sizeof(recv_msg_));
+    recv_msg_.msg_namelen = sizeof(sockaddr_in);
+  }
+
+ protected:
+  bool Init() override;
+  void Poll(int timeout_ms) override;
+  void SendDatagram(const sockaddr_in& addr, std::string&& payload) override;
+  std::string SparePayload() override {
+    if (!free_send_slots_.empty()) {
+      return std::move(send_slots_[free_send_slots_.back()]->payload);
+    }
+    return std::string();
+  }
+  // Sends were prepared as they were queued and go out with the next enter.
+  void FlushSends() override {
+  }
+
+ private:
+  void HandleRecv(const UringCompletion& cqe);
+  void HandleCompletion(const UringCompletion& cqe);
+
+  std::unique_ptr<UringReactor> uring_;
+  // Layout of every datagram received by the multishot recvmsg.
+  msghdr recv_msg_;
+  std::vector<std::unique_ptr<UdpSendSlot>> send_slots_;
+  std::vector<std::uint32_t> free_send_slots_;
+  std::uint64_t enter_calls_ = 0;
+};
+
+bool UringUdpIoThread::Init() {
+  uring_->PrepareMultishotRecvMsg(udp_fd_, &recv_msg_, UringData(UringOp::Recv, udp_fd_));
+  uring_->PrepareMultishotPoll(notifier_.Fd(), UringData(UringOp::Notify, notifier_.Fd()));
+  return true;
+}
+
+void UringUdpIoThread::SendDatagram(const sockaddr_in& addr, std::string&& payload) {
+  std::uint32_t slot_index;
+  if (free_send_slots_.empty()) {
+    slot_index = static_cast<std::uint32_t>(send_slots_.size());
+    send_slots_.push_back(std::make_unique<UdpSendSlot>());
+  } else {
+    slot_index = free_send_slots_.back();
+    free_send_slots_.pop_back();
+  }
+  UdpSendSlot& slot = *send_slots_[slot_index];
+  slot.addr = addr;
+  slot.payload = std::move(payload);
+  slot.iov.iov_base = &slot.payload[0];
+  slot.iov.iov_len = slot.payload.size();
+  std::memset(&slot.msg, 0, sizeof(slot.msg));
+  slot.msg.msg_name = &slot.addr;
+  slot.msg.msg_namelen = sizeof(slot.addr);
+  slot.msg.msg_iov = &slot.iov;
+  slot.msg.msg_iovlen = 1;
+  uring_->PrepareSendMsg(udp_fd_, &slot.msg,
+                         UringData(UringOp::Send, static_cast<int>(slot_index)));
+}
+
+void UringUdpIoThread::HandleRecv(const UringCompletion& cqe) {
+  if (cqe.HasBuffer()) {
+    unsigned buffer = cqe.BufferId();
+    UringRecvMsg datagram;
+    if (cqe.res > 0 &&
+        UringReactor::ParseRecvMsg(recv_msg_, uring_->Buffer(buffer),
+                                   static_cast<std::size_t>(cqe.res), datagram) &&
+        datagram.name_len >= sizeof(sockaddr_in)) {
+      AddCounter(counters_.received_datagrams, 1);
+      AddCounter(counters_.recv_buffers, 1);
+      if (datagram.truncated) {
+        AddCounter(counters_.truncated_datagrams, 1);
+      } else if (datagram.payload_len > 0) {
+        sockaddr_in addr;
+        std::memcpy(&addr, datagram.name, sizeof(addr));
+        // Completions arrive one at a time, so they are classified alone.
+        RtpHeader header{};
+        PacketClass kind = ClassifyPacket(datagram.payload, datagram.payload_len, header);
+        HandleDatagram(datagram.payload, datagram.payload_len, addr, kind, header);
+      }
+    }
+    uring_->RecycleBuffer(buffer);
+  }
+  if (!cqe.More()) {
+    uring_->PrepareMultishotRecvMsg(udp_fd_, &recv_msg_, cqe.user_data);
+  }
+}
+
+void UringUdpIoThread::HandleCompletion(const UringCompletion& cqe) {
+  switch (UringDataOp(cqe.user_data)) {
+    case UringOp::Notify:
+      notifier_.Drain();
+      if (!cqe.More()) {
+        uring_->PrepareMultishotPoll(notifier_.Fd(), cqe.user_data);
+      }
+      break;
+    case UringOp::Recv:
+      HandleRecv(cqe);
+      break;
+    case UringOp::Send: {
+      std::uint32_t slot_index = static_cast<std::uint32_t>(UringDataFd(cqe.user_data));
+      send_slots_[slot_index]->payload.clear();
+      free_send_slots_.push_back(slot_index);
+      AddCounter(counters_.sent_datagrams, cqe.res >= 0 ? 1 : 0);
+      AddCounter(counters_.send_buffers, cqe.res >= 0 ? 1 : 0);
+      AddCounter(counters_.send_drops, cqe.res >= 0 ? 0 : 1);
+      break;
+    }
+    default:
+      break;
+  }
+}
+
+void UringUdpIoThread::Poll(int timeout_ms) {
+  uring_->SubmitAndWait(timeout_ms);
+  notifier_.Unpark();
+  // One enter both reaps receives and submits queued sends.
+  AddCounter(counters_.recv_syscalls, uring_->EnterCalls() - enter_calls_);
+  enter_calls_ = uring_->EnterCalls();
+  uring_->ForEachCompletion([this](const UringCompletion& cqe) { HandleCompletion(cqe); });
+}
+
+}  // namespace
+
+std::unique_ptr<UdpIoThread> MakeUringUdpIoThread(const UdpIoContext& context) {
+  // Every provided buffer must hold a whole datagram plus the recvmsg header,
+  // so UDP threads use fewer, larger buffers for the same memory.
+  const AppConfig& config = *context.config;
+  unsigned buffer_size = std::max<unsigned>(
+      config.io_uring_buffer_size,
+      static_cast<unsigned>(config.udp_max_datagram_size + kUringRecvMsgHeader));
+  unsigned buffer_count = std::max<unsigned>(
+      kUringMinUdpBuffers,
+      static_cast<unsigned>(static_cast<std::uint64_t>(config.io_uring_buffer_count) *
+                            config.io_uring_buffer_size / buffer_size));
+  std::unique_ptr<UringReactor> uring =
+      MakeUringReactor(config, "udp", context.index, buffer_count, buffer_size);
+  if (!uring) {
+    return nullptr;
+  }
+  return std::make_unique<UringUdpIoThread>(context, std::move(uring));
+}
+
+}  // namespace backend
@@ -0,0 +1,282 @@
+#include "udp_session_directory.h"
+
+#include <mutex>
+
+namespace backend {
+
+namespace {
+
+std::uint64_t AddressKey(std::uint32_t remote_addr, std::uint16_t remote_port) {
+  return (static_cast<std::uint64_t>(remote_addr) << 16) | remote_port;
+}
+
+std::uint32_t ShardOf(std::uint64_t key, std::uint32_t shard_count) {
+  key *= 0x9e3779b97f4a7c15ULL;
+  return static_cast<std::uint32_t>(key >> 32) & (shard_count - 1);
+}
+
+}  // namespace
+
+UdpSessionDirectory::UdpSessionDirectory() = default;
+
+void UdpSessionDirectory::Copy(const Slot& slot, UdpSession& out) {
+  out.remote_addr = slot.remote_addr;
+  out.remote_port = slot.remote_port;
+  out.id = slot.id;
+  out.protocol = slot.protocol;
+  out.last_active_ms = slot.last_active_ms.load(std::memory_order_relaxed);
+}
+
+UdpSession UdpSessionDirectory::FindOrCreate(std::uint32_t remote_addr,
+                                             std::uint16_t remote_port,
+                                             ProtocolType protocol,
+                                             int owner,
+                                             std::uint64_t now_ms,
+                                             bool* created) {
+  std::uint64_t key = AddressKey(remote_addr, remote_port);
+  std::uint32_t shard_index = ShardOf(key, kShardCount);
+  Shard& shard = shards_[shard_index];
+  UdpSession session;
+  if (created) {
+    *created = false;
+  }
+  {
+    std::shared_lock<std::shared_mutex> lock(shard.mutex);
+    auto it = shard.by_address.find(key);
+    if (it != shard.by_address.end()) {
+      Slot& slot = shard.slots[it->second];
+      slot.last_active_ms.store(now_ms, std::memory_order_relaxed);
+      Copy(slot, session);
+      return session;
+    }
+  }
+  std::unique_lock<std::shared_mutex> lock(shard.mutex);
+  // Another thread may have created it between the two locks.
+  auto it = shard.by_address.find(key);
+  if (it != shard.by_address.end()) {
+    Slot& slot = shard.slots[it->second];
+    slot.last_active_ms.store(now_ms, std::memory_order_relaxed);
+    Copy(slot, session);
+    return session;
+  }
+  std::uint32_t local;
+  if (!shard.free_slots.empty()) {
+    local = shard.free_slots.back();
+    shard.free_slots.pop_back();
+  } else {
+    local = static_cast<std::uint32_t>(shard.slots.size());
+    shard.slots.emplace_back();
+  }
+  Slot& slot = shard.slots[local];
+  slot.generation = (slot.generation + 1) & kSessionGenerationMask;
+  slot.live = true;
+  slot.remote_addr = remote_addr;
+  slot.remote_port = remote_port;
+  slot.id = MakeSessionId(owner, (local << kShardBits) | shard_index, slot.generation);
+  slot.protocol = protocol;
+  slot.last_active_ms.store(now_ms, std::memory_order_relaxed);
+  shard.by_address.emplace(key, local);
+  if (created) {
+    *created = true;
+  }
+  Copy(slot, session);
+  return session;
+}
+
+bool UdpSessionDirectory::FindById(std::uint64_t id, UdpSession& out) const {
+  std::uint32_t index = SessionIndex(id);
+  const Shard& shard = shards_[index & (kShardCount - 1)];
+  std::uint32_t local = index >> kShardBits;
+  std::shared_lock<std::shared_mutex> lock(shard.mutex);
+  if (local >= shard.slots.size()) {
+    return false;
+  }
+  const Slot& slot = shard.slots[local];
+  if (!slot.live || slot.id != id) {
+    return false;
+  }
+  Copy(slot, out);
+  return true;
+}
+
+bool UdpSessionDirectory::Remove(std::uint64_t id) {
+  std::uint32_t index = SessionIndex(id);
+  Shard& shard = shards_[index & (kShardCount - 1)];
+  std::uint32_t local = index >> kShardBits;
+  std::unique_lock<std::shared_mutex> lock(shard.mutex);
+  if (local >= shard.slots.size()) {
+    return false;
+  }
+  Slot& slot = shard.slots[local];
+  if (!slot.live || slot.id != id) {
+    return false;
+  }
+  shard.by_address.erase(AddressKey(slot.remote_addr, slot.remote_port));
+  slot.live = false;
+  shard.free_slots.push_back(local);
+  return true;
+}
+
+std::size_t UdpSessionDirectory::Size() const {
+  std::size_t size = 0;
+  for (const Shard& shard : shards_) {
+    std::shared_lock<std::shared_mutex> lock(shard.mutex);
+    size += shard.by_address.size();
+  }
+  return size;
+}
+
+RtpSessionDirectory::RtpSessionDirectory()
+    : next_id_(1) {
+}
+
+RtpSession RtpSessionDirectory::FindOrCreate(std::uint32_t ssrc,
+                                             int owner,
+                                             std::uint64_t now_ms,
+                                             std::uint64_t record_bytes,
+                                             std::uint64_t* record_offset,
+                                             bool* created) {
+  Shard& shard = shards_[ShardOf(ssrc, kShardCount)];
+  RtpSession session;
+  session.ssrc = ssrc;
+  session.last_active_ms = now_ms;
+  if (created) {
+    *created = false;
+  }
+  auto touch = [&](Entry& entry) {
+    entry.last_active_ms.store(now_ms, std::memory_order_relaxed);
+    std::uint64_t offset =
+        entry.record_bytes.fetch_add(record_bytes, std::memory_order_relaxed);
+    if (record_offset) {
+      *record_offset = offset;
+    }
+    session.id = entry.id;
+    session.owner = entry.owner;
+  };
+  {
+    std::shared_lock<std::shared_mutex> lock(shard.mutex);
+    auto it = shard.entries.find(ssrc);
+    if (it != shard.entries.end()) {
+      touch(it->second);
+      return session;
+    }
+  }
+  std::unique_lock<std::shared_mutex> lock(shard.mutex);
+  auto result = shard.entries.try_emplace(ssrc);
+  if (result.second) {
+    result.first->second.id = next_id_.fetch_add(1, std::memory_order_relaxed);
+    result.first->second.owner = owner;
+    if (created) {
+      *created = true;
+    }
+  }
+  touch(result.first->second);
+  return session;
+}
+
+bool RtpSessionDirectory::Find(std::uint32_t ssrc, RtpSession& out) const {
+  const Shard& shard = shards_[ShardOf(ssrc, kShardCount)];
+  std::shared_lock<std::shared_mutex> lock(shard.mutex);
+  auto it = shard.entries.find(ssrc);
+  if (it == shard.entries.end()) {
+    return false;
+  }
+  out.ssrc = ssrc;
+  out.id = it->second.id;
+  out.last_active_ms = it->second.last_active_ms.load(std::memory_order_relaxed);
+  out.owner = it->second.owner;
+  return true;
+}
+
+void RtpSessionDirectory::Remove(std::uint32_t ssrc) {
+  Shard& shard = shards_[ShardOf(ssrc, kShardCount)];
+  std::unique_lock<std::shared_mutex> lock(shard.mutex);
+  shard.entries.erase(ssrc);
+}
+
+bool RtpSessionDirectory::ReturnRecordBytes(std::uint32_t ssrc, std::uint64_t record_offset,
+                                            std::uint64_t record_bytes) {
+  Shard& shard = shards_[ShardOf(ssrc, kShardCount)];
+  std::shared_lock<std::shared_mutex> lock(shard.mutex);
+  auto it = shard.entries.find(ssrc);
+  if (it == shard.entries.end()) {
+    return false;
+  }
+  std::uint64_t expected = record_offset + record_bytes;
+  return it->second.record_bytes.compare_exchange_strong(expected, record_offset,
+                                                         std::memory_order_relaxed);
+}
+
+void RtpSessionDirectory::PublishStats(std::uint32_t ssrc, const RtpStreamStats& stats) {
+  Shard& shard = shards_[ShardOf(ssrc, kShardCount)];
+  std::shared_lock<std::shared_mutex> lock(shard.mutex);
+  auto it = shard.entries.find(ssrc);
+  if (it == shard.entries.end()) {
+    return;
+  }
+  std::lock_guard<std::mutex> stats_lock(it->second.stats_mutex);
+  it->second.stats = stats;
+}
+
+bool RtpSessionDirectory::GetStats(std::uint32_t ssrc, RtpStreamStats& out) const {
+  const Shard& shard = shards_[ShardOf(ssrc, kShardCount)];
+  std::shared_lock<std::shared_mutex> lock(shard.mutex);
+  auto it = shard.entries.find(ssrc);
+  if (it == shard.entries.end()) {
+    return false;
+  }
+  std::lock_guard<std::mutex> stats_lock(it->second.stats_mutex);
+  out = it->second.stats;
+  return true;
+}
+
+void RtpSessionDirectory::NoteSenderReport(std::uint32_t ssrc, std::uint64_t ntp_timestamp,
+                                           std::uint64_t now_ms) {
+  Shard& shard = shards_[ShardOf(ssrc, kShardCount)];
+  std::shared_lock<std::shared_mutex> lock(shard.mutex);
+  auto it = shard.entries.find(ssrc);
+  if (it == shard.entries.end()) {
+    return;
+  }
+  it->second.last_sr.store(static_cast<std::uint32_t>(ntp_timestamp >> 16),
+                           std::memory_order_relaxed);
+  it->second.last_sr_ms.store(now_ms, std::memory_order_relaxed);
+}
+
+bool RtpSessionDirectory::LastSenderReport(std::uint32_t ssrc, std::uint32_t* last_sr,
+                                           std::uint64_t* received_ms) const {
+  const Shard& shard = shards_[ShardOf(ssrc, kShardCount)];
+  std::shared_lock<std::shared_mutex> lock(shard.mutex);
+  auto it = shard.entries.find(ssrc);
+  if (it == shard.entries.end() || it->second.last_sr_ms.load(std::memory_order_relaxed) == 0) {
+    return false;
+  }
+  *last_sr = it->second.last_sr.load(std::memory_order_relaxed);
+  *received_ms = it->second.last_sr_ms.load(std::memory_order_relaxed);
+  return true;
+}
+
+void RtpSessionDirectory::SetCname(std::uint32_t ssrc, const std::string& cname) {
+  Shard& shard = shards_[ShardOf(ssrc, kShardCount)];
+  std::shared_lock<std::shared_mutex> lock(shard.mutex);
+  auto it = shard.entries.find(ssrc);
+  if (it == shard.entries.end()) {
+    return;
+  }
+  std::lock_guard<std::mutex> stats_lock(it->second.stats_mutex);
+  it->second.cname = cname;
+}
+
+bool RtpSessionDirectory::GetCname(std::uint32_t ssrc, std::string& out) const {
+  const Shard& shard = shards_[ShardOf(ssrc, kShardCount)];
+  std::shared_lock<std::shared_mutex> lock(shard.mutex);
+  auto it = shard.entries.find(ssrc);
+  if (it == shard.entries.end()) {
+    return false;
+  }
+  std::lock_guard<std::mutex> stats_lock(it->second.stats_mutex);
+  out = it->second.cname;
+  return true;
+}
+
+}  // namespace backend
@@ -0,0 +1,527 @@
+#include "uring_reactor.h"
+
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <vector>
+
+#include <linux/io_uring.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace backend {
+
+#if defined(IORING_RECV_MULTISHOT)
+
+namespace {
+
+const unsigned kBufferGroup = 0;
+// user_data of the requests Init makes to probe the kernel. The top byte is
+// 0, which no IO thread operation uses.
+const std::uint64_t kProbeRecv = 1;
+const std::uint64_t kProbeCancel = 2;
+const int kProbeWaitMs = 100;
+const int kProbeWaits = 10;
+
+int SysSetup(unsigned entries, io_uring_params* params) {
+  return static_cast<int>(::syscall(__NR_io_uring_setup, entries, params));
+}
+
+int SysEnter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags,
+             const void* arg, std::size_t arg_size) {
+  return static_cast<int>(
+      ::syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, arg, arg_size));
+}
+
+int SysRegister(int fd, unsigned opcode, const void* arg, unsigned count) {
+  return static_cast<int>(::syscall(__NR_io_uring_register, fd, opcode, arg, count));
+}
+
+// True if the kernel knows every opcode the IO threads use.
+bool OpcodesSupported(int fd) {
+  const unsigned ops = 256;
+  std::vector<char> buffer(sizeof(io_uring_probe) + ops * sizeof(io_uring_probe_op));
+  auto* probe = reinterpret_cast<io_uring_probe*>(buffer.data());
+  if (SysRegister(fd, IORING_REGISTER_PROBE, probe, ops) < 0) {
+    return false;
+  }
+  for (unsigned op : {IORING_OP_ACCEPT, IORING_OP_RECV, IORING_OP_RECVMSG, IORING_OP_SENDMSG,
+                      IORING_OP_POLL_ADD, IORING_OP_ASYNC_CANCEL}) {
+    if (op > probe->last_op || (probe->ops[op].flags & IO_URING_OP_SUPPORTED) == 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+unsigned RoundUpPowerOfTwo(unsigned value) {
+  unsigned result = 1;
+  while (result < value) {
+    result <<= 1;
+  }
+  return result;
+}
+
+}  // namespace
+
+struct UringReactor::Rings {
+  int fd = -1;
+  void* sq_ptr = MAP_FAILED;
+  std::size_t sq_size = 0;
+  void* cq_ptr = MAP_FAILED;
+  std::size_t cq_size = 0;
+  io_uring_sqe* sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+  std::size_t sqes_size = 0;
+  unsigned* sq_head = nullptr;
+  unsigned* sq_tail = nullptr;
+  unsigned* sq_array = nullptr;
+  unsigned sq_mask = 0;
+  unsigned sq_entries = 0;
+  unsigned* cq_head = nullptr;
+  unsigned* cq_tail = nullptr;
+  io_uring_cqe* cqes = nullptr;
+  unsigned cq_mask = 0;
+  unsigned sqe_tail = 0;
+  unsigned to_submit = 0;
+  // Entries prepared while the kernel would not take a full ring, moved in
+  // by the next Submit with room.
+  std::deque<io_uring_sqe> backlog;
+
+  // The provided buffer ring is an array of io_uring_buf whose first resv
+  // field doubles as the tail. io_uring_buf_ring is not used because its
+  // flexible array member lands at offset 8 when compiled as C++.
+  io_uring_buf* buf_ring = static_cast<io_uring_buf*>(MAP_FAILED);
+  std::size_t buf_ring_size = 0;
+  unsigned buf_count = 0;
+  unsigned buf_size = 0;
+  unsigned short buf_tail = 0;
+  std::unique_ptr<char[]> buffers;
+
+  ~Rings() {
+    if (buf_ring != MAP_FAILED) {
+      ::munmap(buf_ring, buf_ring_size);
+    }
+    if (sqes != MAP_FAILED) {
+      ::munmap(sqes, sqes_size);
+    }
+    if (cq_ptr != MAP_FAILED && cq_ptr != sq_ptr) {
+      ::munmap(cq_ptr, cq_size);
+    }
+    if (sq_ptr != MAP_FAILED) {
+      ::munmap(sq_ptr, sq_size);
+    }
+    if (fd >= 0) {
+      ::close(fd);
+    }
+  }
+
+  bool SqFull() const {
+    return sqe_tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE) >= sq_entries;
+  }
+
+  io_uring_sqe* PushSqe() {
+    unsigned index = sqe_tail & sq_mask;
+    io_uring_sqe* sqe = &sqes[index];
+    sq_array[index] = index;
+    ++sqe_tail;
+    ++to_submit;
+    return sqe;
+  }
+
+  void AddBuffer(unsigned id) {
+    io_uring_buf* buf = &buf_ring[buf_tail & (buf_count - 1)];
+    buf->addr = reinterpret_cast<std::uint64_t>(buffers.get() +
+                                                static_cast<std::size_t>(id) * buf_size);
+    buf->len = buf_size;
+    buf->bid = static_cast<unsigned short>(id);
+    ++buf_tail;
+    __atomic_store_n(&buf_ring[0].resv, buf_tail, __ATOMIC_RELEASE);
+  }
+};
+
+bool UringCompletion::More() const {
+  return (flags & IORING_CQE_F_MORE) != 0;
+}
+
+bool UringCompletion::HasBuffer() const {
+  return (flags & IORING_CQE_F_BUFFER) != 0;
+}
+
+unsigned UringCompletion::BufferId() const {
+  return flags >> IORING_CQE_BUFFER_SHIFT;
+}
+
+UringReactor::UringReactor()
+    : enter_calls_(0) {
+}
+
+UringReactor::~UringReactor() = default;
+
+bool UringReactor::Init(unsigned entries, unsigned buffer_count, unsigned buffer_size) {
+  auto rings = std::make_unique<Rings>();
+  io_uring_params params;
+  std::memset(&params, 0, sizeof(params));
+  params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_SUBMIT_ALL;
+  params.cq_entries = entries * 4;
+  rings->fd = SysSetup(entries, &params);
+  if (rings->fd < 0 || (params.features & IORING_FEAT_EXT_ARG) == 0) {
+    return false;
+  }
+  rings->sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  rings->cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+  if (single_mmap && rings->cq_size > rings->sq_size) {
+    rings->sq_size = rings->cq_size;
+  }
+  rings->sq_ptr = ::mmap(nullptr, rings->sq_size, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE, rings->fd, IORING_OFF_SQ_RING);
+  if (rings->sq_ptr == MAP_FAILED) {
+    return false;
+  }
+  if (single_mmap) {
+    rings->cq_ptr = rings->sq_ptr;
+  } else {
+    rings->cq_ptr = ::mmap(nullptr, rings->cq_size, PROT_READ | PROT_WRITE,
+                           MAP_SHARED | MAP_POPULATE, rings->fd, IORING_OFF_CQ_RING);
+    if (rings->cq_ptr == MAP_FAILED) {
+      return false;
+    }
+  }
+  rings->sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+  rings->sqes = static_cast<io_uring_sqe*>(
+      ::mmap(nullptr, rings->sqes_size, PROT_READ | PROT_WRITE,
+             MAP_SHARED | MAP_POPULATE, rings->fd, IORING_OFF_SQES));
+  if (rings->sqes == MAP_FAILED) {
+    return false;
+  }
+  char* sq = static_cast<char*>(rings->sq_ptr);
+  rings->sq_head = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+  rings->sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+  rings->sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+  rings->sq_mask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+  rings->sq_entries = params.sq_entries;
+  rings->sqe_tail = *rings->sq_tail;
+  char* cq = static_cast<char*>(rings->cq_ptr);
+  rings->cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+  rings->cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+  rings->cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+  rings->cq_mask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+
+  rings->buf_count = RoundUpPowerOfTwo(buffer_count > 32768 ? 32768 : buffer_count);
+  rings->buf_size = buffer_size;
+  rings->buf_ring_size = rings->buf_count * sizeof(io_uring_buf);
+  rings->buf_ring = static_cast<io_uring_buf*>(
+      ::mmap(nullptr, rings->buf_ring_size, PROT_READ | PROT_WRITE,
+             MAP_ANONYMOUS | MAP_PRIVATE, -1, 0));
+  if (rings->buf_ring == MAP_FAILED) {
+    return false;
+  }
+  io_uring_buf_reg reg;
+  std::memset(&reg, 0, sizeof(reg));
+  reg.ring_addr = reinterpret_cast<std::uint64_t>(rings->buf_ring);
+  reg.ring_entries = rings->buf_count;
+  reg.bgid = kBufferGroup;
+  if (SysRegister(rings->fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+    return false;
+  }
+  rings->buffers.reset(new char[static_cast<std::size_t>(rings->buf_count) * buffer_size]);
+  for (unsigned id = 0; id < rings->buf_count; ++id) {
+    rings->AddBuffer(id);
+  }
+  if (!OpcodesSupported(rings->fd)) {
+    return false;
+  }
+  rings_ = std::move(rings);
+  if (!ProbeMultishotRecv()) {
+    rings_.reset();
+    return false;
+  }
+  return true;
+}
+
+// Multishot recv and recvmsg came in 6.0, after provided buffer rings and
+// multishot accept, and the opcode probe cannot tell: older kernels fail the
+// request with EINVAL. One datagram over a socketpair finds out.
+bool UringReactor::ProbeMultishotRecv() {
+  int fds[2];
+  if (::socketpair(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0, fds) != 0) {
+    return false;
+  }
+  char byte = 0;
+  bool supported = false;
+  bool armed = false;
+  bool cancelled = false;
+  if (::send(fds[1], &byte, sizeof(byte), 0) == static_cast<ssize_t>(sizeof(byte))) {
+    PrepareMultishotRecv(fds[0], kProbeRecv);
+    armed = true;
+  }
+  // Closing the socket does not end a multishot recv, so a supported one is
+  // cancelled and its last completion reaped before the ring is used.
+  for (int wait = 0; armed && wait < kProbeWaits; ++wait) {
+    Submit(1, kProbeWaitMs);
+    UringCompletion completion;
+    while (PeekCompletion(completion)) {
+      if (completion.user_data == kProbeRecv) {
+        if (completion.HasBuffer()) {
+          RecycleBuffer(completion.BufferId());
+        }
+        supported = supported || (completion.res > 0 && completion.More());
+        armed = completion.More();
+      }
+      AdvanceCompletion();
+    }
+    if (armed && !cancelled) {
+      PrepareCancel(kProbeRecv, kProbeCancel);
+      cancelled = true;
+    }
+  }
+  ::close(fds[0]);
+  ::close(fds[1]);
+  return supported && !armed;
+}
+
+void UringReactor::PrepareMultishotAccept(int fd, std::uint64_t user_data) {
+  auto* sqe = static_cast<io_uring_sqe*>(NextSqe());
+  sqe->opcode = IORING_OP_ACCEPT;
+  sqe->fd = fd;
+  sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+  sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+  sqe->user_data = user_data;
+}
+
+void UringReactor::PrepareMultishotRecv(int fd, std::uint64_t user_data) {
+  auto* sqe = static_cast<io_uring_sqe*>(NextSqe());
+  sqe->opcode = IORING_OP_RECV;
+  sqe->fd = fd;
+  sqe->ioprio = IORING_RECV_MULTISHOT;
+  sqe->flags = IOSQE_BUFFER_SELECT;
+  sqe->buf_group = kBufferGroup;
+  sqe->user_data = user_data;
+}
+
+void UringReactor::PrepareMultishotRecvMsg(int fd, msghdr* msg, std::uint64_t user_data) {
+  auto* sqe = static_cast<io_uring_sqe*>(NextSqe());
+  sqe->opcode = IORING_OP_RECVMSG;
+  sqe->fd = fd;
+  sqe->addr = reinterpret_cast<std::uint64_t>(msg);
+  sqe->len = 1;
+  sqe->ioprio = IORING_RECV_MULTISHOT;
+  sqe->flags = IOSQE_BUFFER_SELECT;
+  sqe->buf_group = kBufferGroup;
+  sqe->user_data = user_data;
+}
+
+void UringReactor::PrepareSendMsg(int fd, const msghdr* msg, std::uint64_t user_data) {
+  auto* sqe = static_cast<io_uring_sqe*>(NextSqe());
+  sqe->opcode = IORING_OP_SENDMSG;
+  sqe->fd = fd;
+  sqe->addr = reinterpret_cast<std::uint64_t>(msg);
+  sqe->len = 1;
+  sqe->msg_flags = MSG_NOSIGNAL;
+  sqe->user_data = user_data;
+}
+
+void UringReactor::PrepareMultishotPoll(int fd, std::uint64_t user_data) {
+  auto* sqe = static_cast<io_uring_sqe*>(NextSqe());
+  sqe->opcode = IORING_OP_POLL_ADD;
+  sqe->fd = fd;
+  sqe->poll32_events = POLLIN;
+  sqe->len = IORING_POLL_ADD_MULTI;
+  sqe->user_data = user_data;
+}
+
+void UringReactor::PrepareCancel(std::uint64_t target_user_data, std::uint64_t user_data) {
+  auto* sqe = static_cast<io_uring_sqe*>(NextSqe());
+  sqe->opcode = IORING_OP_ASYNC_CANCEL;
+  sqe->fd = -1;
+  sqe->addr = target_user_data;
+  sqe->user_data = user_data;
+}
+
+void UringReactor::SubmitAndWait(int timeout_ms) {
+  // Backlogged entries wait for completions to be reaped, so do not block.
+  bool ready = *rings_->cq_head != __atomic_load_n(rings_->cq_tail, __ATOMIC_ACQUIRE) ||
+               !rings_->backlog.empty();
+  Submit(ready || timeout_ms == 0 ? 0 : 1, timeout_ms);
+}
+
+bool UringReactor::ParseRecvMsg(const msghdr& msg, const char* buffer, std::size_t len,
+                                UringRecvMsg& out) {
+  std::size_t header = sizeof(io_uring_recvmsg_out) + msg.msg_namelen + msg.msg_controllen;
+  if (len < header) {
+    return false;
+  }
+  io_uring_recvmsg_out result;
+  std::memcpy(&result, buffer, sizeof(result));
+  out.name = reinterpret_cast<const sockaddr*>(buffer + sizeof(io_uring_recvmsg_out));
+  out.name_len = result.namelen < msg.msg_namelen ? result.namelen : msg.msg_namelen;
+  out.payload = buffer + header;
+  out.payload_len = len - header;
+  if (result.payloadlen < out.payload_len) {
+    out.payload_len = result.payloadlen;
+  }
+  out.truncated = (result.flags & MSG_TRUNC) != 0;
+  return true;
+}
+
+const char* UringReactor::Buffer(unsigned id) const {
+  return rings_->buffers.get() + static_cast<std::size_t>(id) * rings_->buf_size;
+}
+
+unsigned UringReactor::BufferSize() const {
+  return rings_->buf_size;
+}
+
+void UringReactor::RecycleBuffer(unsigned id) {
+  rings_->AddBuffer(id);
+}
+
+void* UringReactor::NextSqe() {
+  Rings& rings = *rings_;
+  if (rings.backlog.empty() && rings.SqFull()) {
+    Submit(0, 0);
+  }
+  io_uring_sqe* sqe;
+  if (!rings.backlog.empty() || rings.SqFull()) {
+    // The kernel did not take the ring, for example EBUSY while completions
+    // overflow. The slots still hold unsubmitted entries.
+    rings.backlog.emplace_back();
+    sqe = &rings.backlog.back();
+  } else {
+    sqe = rings.PushSqe();
+  }
+  std::memset(sqe, 0, sizeof(*sqe));
+  return sqe;
+}
+
+void UringReactor::Submit(unsigned wait_nr, int timeout_ms) {
+  Rings& rings = *rings_;
+  while (!rings.backlog.empty() && !rings.SqFull()) {
+    *rings.PushSqe() = rings.backlog.front();
+    rings.backlog.pop_front();
+  }
+  if (rings.to_submit == 0 && wait_nr == 0) {
+    return;
+  }
+  __atomic_store_n(rings.sq_tail, rings.sqe_tail, __ATOMIC_RELEASE);
+  unsigned flags = 0;
+  io_uring_getevents_arg arg;
+  __kernel_timespec timeout;
+  const void* arg_ptr = nullptr;
+  std::size_t arg_size = 0;
+  if (wait_nr > 0) {
+    std::memset(&arg, 0, sizeof(arg));
+    timeout.tv_sec = timeout_ms / 1000;
+    timeout.tv_nsec = static_cast<long long>(timeout_ms % 1000) * 1000000;
+    arg.ts = reinterpret_cast<std::uint64_t>(&timeout);
+    flags |= IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG;
+    arg_ptr = &arg;
+    arg_size = sizeof(arg);
+  }
+  int submitted = SysEnter(rings.fd, rings.to_submit, wait_nr, flags, arg_ptr, arg_size);
+  ++enter_calls_;
+  if (submitted > 0) {
+    rings.to_submit -= static_cast<unsigned>(submitted) < rings.to_submit
+                           ? static_cast<unsigned>(submitted)
+                           : rings.to_submit;
+  }
+}
+
+bool UringReactor::PeekCompletion(UringCompletion& out) {
+  unsigned head = *rings_->cq_head;
+  if (head == __atomic_load_n(rings_->cq_tail, __ATOMIC_ACQUIRE)) {
+    return false;
+  }
+  const io_uring_cqe& cqe = rings_->cqes[head & rings_->cq_mask];
+  out.user_data = cqe.user_data;
+  out.res = cqe.res;
+  out.flags = cqe.flags;
+  return true;
+}
+
+void UringReactor::AdvanceCompletion() {
+  __atomic_store_n(rings_->cq_head, *rings_->cq_head + 1, __ATOMIC_RELEASE);
+}
+
+#else
+
+bool UringCompletion::More() const {
+  return false;
+}
+
+bool UringCompletion::HasBuffer() const {
+  return false;
+}
+
+unsigned UringCompletion::BufferId() const {
+  return 0;
+}
+
+struct UringReactor::Rings {};
+
+UringReactor::UringReactor()
+    : enter_calls_(0) {
+}
+
+UringReactor::~UringReactor() = default;
+
+bool UringReactor::Init(unsigned, unsigned, unsigned) {
+  return false;
+}
+
+void UringReactor::PrepareMultishotAccept(int, std::uint64_t) {
+}
+
+void UringReactor::PrepareMultishotRecv(int, std::uint64_t) {
+}
+
+void UringReactor::PrepareMultishotRecvMsg(int, msghdr*, std::uint64_t) {
+}
+
+void UringReactor::PrepareSendMsg(int, const msghdr*, std::uint64_t) {
+}
+
+void UringReactor::PrepareMultishotPoll(int, std::uint64_t) {
+}
+
+void UringReactor::PrepareCancel(std::uint64_t, std::uint64_t) {
+}
+
+void UringReactor::SubmitAndWait(int) {
+}
+
+bool UringReactor::ParseRecvMsg(const msghdr&, const char*, std::size_t, UringRecvMsg&) {
+  return false;
+}
+
+const char* UringReactor::Buffer(unsigned) const {
+  return nullptr;
+}
+
+unsigned UringReactor::BufferSize() const {
+  return 0;
+}
+
+void UringReactor::RecycleBuffer(unsigned) {
+}
+
+void* UringReactor::NextSqe() {
+  return nullptr;
+}
+
+void UringReactor::Submit(unsigned, int) {
+}
+
+bool UringReactor::PeekCompletion(UringCompletion&) {
+  return false;
+}
+
+void UringReactor::AdvanceCompletion() {
+}
+
+#endif
+
+}  // namespace backend
@@ -0,0 +1,92 @@
+#include "worker_assigner.h"
+
+#include <algorithm>
+
+namespace backend {
+
+namespace {
+
+std::uint64_t Mix(std::uint64_t value) {
+  value ^= value >> 33;
+  value *= 0xff51afd7ed558ccdULL;
+  value ^= value >> 33;
+  value *= 0xc4ceb9fe1a85ec53ULL;
+  value ^= value >> 33;
+  return value;
+}
+
+}  // namespace
+
+bool ParseWorkerAssignment(const std::string& name, WorkerAssignment& out) {
+  if (name == "round_robin") {
+    out = WorkerAssignment::RoundRobin;
+  } else if (name == "least_loaded") {
+    out = WorkerAssignment::LeastLoaded;
+  } else if (name == "consistent_hash") {
+    out = WorkerAssignment::ConsistentHash;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+WorkerAssigner::WorkerAssigner(WorkerAssignment policy, int worker_count, int start,
+                               std::function<std::size_t(int)> load)
+    : policy_(policy),
+      worker_count_(worker_count > 0 ? worker_count : 1),
+      next_(start % worker_count_),
+      load_(std::move(load)) {
+  if (policy_ == WorkerAssignment::LeastLoaded && !load_) {
+    policy_ = WorkerAssignment::RoundRobin;
+  }
+  if (policy_ == WorkerAssignment::ConsistentHash) {
+    ring_.reserve(static_cast<std::size_t>(worker_count_) * kVirtualNodes);
+    for (int worker = 0; worker < worker_count_; ++worker) {
+      for (int node = 0; node < kVirtualNodes; ++node) {
+        std::uint64_t key = (static_cast<std::uint64_t>(worker) << 32) |
+                            static_cast<std::uint64_t>(node);
+        ring_.emplace_back(Mix(key), worker);
+      }
+    }
+    std::sort(ring_.begin(), ring_.end());
+  }
+}
+
+int WorkerAssigner::Assign(std::uint32_t remote_addr) {
+  switch (policy_) {
+    case WorkerAssignment::LeastLoaded: {
+      int first = NextRoundRobin();
+      int best = first;
+      std::size_t best_load = load_(first);
+      for (int i = 1; i < worker_count_ && best_load > 0; ++i) {
+        int worker = (first + i) % worker_count_;
+        std::size_t load = load_(worker);
+        if (load < best_load) {
+          best = worker;
+          best_load = load;
+        }
+      }
+      return best;
+    }
+    case WorkerAssignment::ConsistentHash: {
+      std::uint64_t point = Mix(0x9e3779b97f4a7c15ULL ^ remote_addr);
+      auto it = std::lower_bound(ring_.begin(), ring_.end(),
+                                 std::make_pair(point, 0));
+      if (it == ring_.end()) {
+        it = ring_.begin();
+      }
+      return it->second;
+    }
+    case WorkerAssignment::RoundRobin:
+    default:
+      return NextRoundRobin();
+  }
+}
+
+int WorkerAssigner::NextRoundRobin() {
+  int worker = next_;
+  next_ = (next_ + 1) % worker_count_;
+  return worker;
+}
+
+}  // namespace backend
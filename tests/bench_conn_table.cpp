@@ -0,0 +1,144 @@
+#include "conn.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <malloc.h>
+
+namespace {
+
+// The connection record and map TcpConnTable used before the slab, kept here
+// as the baseline for the comparison.
+struct LegacyConn {
+  int fd;
+  backend::ConnState state;
+  int worker_index;
+  backend::ProtocolType protocol;
+  std::string recv_buffer;
+  backend::SendQueue send_queue;
+  bool write_armed;
+  bool send_blocked;
+  bool send_scheduled;
+  std::string remote_ip;
+  std::uint16_t remote_port;
+  std::uint64_t last_active_ms;
+};
+
+std::size_t HeapInUse() {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+  return mallinfo2().uordblks;
+#else
+  return static_cast<std::size_t>(mallinfo().uordblks);
+#endif
+}
+
+struct Result {
+  double bytes_per_conn;
+  double lookup_ns;
+};
+
+template <typename Lookup>
+double TimeLookups(const std::vector<int>& order, Lookup lookup) {
+  std::uint64_t sink = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int round = 0; round < 10; ++round) {
+    for (int fd : order) {
+      sink += lookup(fd);
+    }
+  }
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  if (sink == 0) {
+    std::printf("unexpected empty lookups\n");
+  }
+  return std::chrono::duration<double, std::nano>(elapsed).count() /
+         (10.0 * static_cast<double>(order.size()));
+}
+
+Result RunLegacy(int connection_count, int first_fd, const std::vector<int>& order) {
+  std::size_t before = HeapInUse();
+  std::unordered_map<int, LegacyConn> conns;
+  for (int i = 0; i < connection_count; ++i) {
+    LegacyConn conn;
+    conn.fd = first_fd + i;
+    conn.state = backend::ConnState::Established;
+    conn.worker_index = conn.fd % 4;
+    conn.protocol = backend::ProtocolType::Tcp;
+    conn.write_armed = false;
+    conn.send_blocked = false;
+    conn.send_scheduled = false;
+    conn.remote_ip = "192.168.100.200";
+    conn.remote_port = 40000;
+    conn.last_active_ms = 0;
+    conns.emplace(conn.fd, std::move(conn));
+  }
+  std::size_t after = HeapInUse();
+  Result result;
+  result.bytes_per_conn =
+      static_cast<double>(after - before) / static_cast<double>(connection_count);
+  result.lookup_ns = TimeLookups(order, [&conns](int fd) {
+    auto it = conns.find(fd);
+    return it == conns.end() ? 0u : static_cast<unsigned>(it->second.worker_index + 1);
+  });
+  return result;
+}
+
+Result RunSlab(int connection_count, int first_fd, const std::vector<int>& order,
+               std::size_t& slab_bytes) {
+  std::size_t before = HeapInUse();
+  backend::TcpConnTable table;
+  for (int i = 0; i < connection_count; ++i) {
+    int fd = first_fd + i;
+    backend::Conn* conn = table.Add(fd);
+    conn->state = backend::ConnState::Established;
+    conn->worker_index = fd % 4;
+    backend::ConnInfo& info = table.Info(fd);
+    info.remote_addr = 0xC8640AC0u;
+    info.remote_port = 40000;
+  }
+  std::size_t after = HeapInUse();
+  slab_bytes = table.MemoryUsage();
+  Result result;
+  result.bytes_per_conn =
+      static_cast<double>(after - before) / static_cast<double>(connection_count);
+  result.lookup_ns = TimeLookups(order, [&table](int fd) {
+    backend::Conn* conn = table.Find(fd);
+    return conn ? static_cast<unsigned>(conn->worker_index + 1) : 0u;
+  });
+  return result;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int connection_count = argc > 1 ? std::atoi(argv[1]) : 100000;
+  const int first_fd = 16;
+
+  std::vector<int> order;
+  order.reserve(static_cast<std::size_t>(connection_count));
+  for (int i = 0; i < connection_count; ++i) {
+    order.push_back(first_fd + i);
+  }
+  std::mt19937 rng(42);
+  std::shuffle(order.begin(), order.end(), rng);
+
+  Result legacy = RunLegacy(connection_count, first_fd, order);
+  std::size_t slab_bytes = 0;
+  Result slab = RunSlab(connection_count, first_fd, order, slab_bytes);
+
+  std::printf("%d idle connections, sizeof(Conn)=%zu sizeof(ConnInfo)=%zu\n",
+              connection_count, sizeof(backend::Conn), sizeof(backend::ConnInfo));
+  std::printf("%-14s %16s %16s\n", "table", "heap bytes/conn", "lookup ns");
+  std::printf("%-14s %16.1f %16.2f\n", "unordered_map", legacy.bytes_per_conn,
+              legacy.lookup_ns);
+  std::printf("%-14s %16.1f %16.2f\n", "fd slab", slab.bytes_per_conn, slab.lookup_ns);
+  std::printf("slab MemoryUsage()=%zu bytes (%.1f bytes/conn)\n", slab_bytes,
+              static_cast<double>(slab_bytes) / static_cast<double>(connection_count));
+  return 0;
+}
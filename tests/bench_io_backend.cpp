@@ -0,0 +1,141 @@
+#include "app_config.h"
+#include "logger.h"
+#include "runtime.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+struct Result {
+  bool ran;
+  double syscalls_per_message;
+  double p50_us;
+  double p99_us;
+  double messages_per_second;
+};
+
+// Runs connection_count echo clients that each send round_trips messages of
+// message_size bytes and wait for the reply before sending the next one.
+Result RunPingPong(backend::AppConfig config, const std::string& io_backend,
+                   int connection_count, int round_trips, std::size_t message_size) {
+  config.io_backend = io_backend;
+  backend::Runtime runtime(config);
+  runtime.Start();
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+  sockaddr_in addr;
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(config.tcp_port);
+  ::inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+
+  std::vector<std::vector<double>> latencies(static_cast<std::size_t>(connection_count));
+  std::vector<std::thread> clients;
+  auto start = std::chrono::steady_clock::now();
+  for (int c = 0; c < connection_count; ++c) {
+    clients.emplace_back([&, c]() {
+      int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+      if (fd < 0) {
+        return;
+      }
+      int on = 1;
+      ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+      if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        ::close(fd);
+        return;
+      }
+      std::string message(message_size, 'x');
+      std::vector<char> reply(message_size);
+      auto& samples = latencies[static_cast<std::size_t>(c)];
+      samples.reserve(static_cast<std::size_t>(round_trips));
+      for (int i = 0; i < round_trips; ++i) {
+        auto sent_at = std::chrono::steady_clock::now();
+        if (::send(fd, message.data(), message.size(), 0) !=
+            static_cast<ssize_t>(message.size())) {
+          break;
+        }
+        std::size_t received = 0;
+        while (received < message_size) {
+          ssize_t n = ::recv(fd, reply.data() + received, message_size - received, 0);
+          if (n <= 0) {
+            break;
+          }
+          received += static_cast<std::size_t>(n);
+        }
+        if (received < message_size) {
+          break;
+        }
+        samples.push_back(std::chrono::duration<double, std::micro>(
+                              std::chrono::steady_clock::now() - sent_at)
+                              .count());
+      }
+      ::close(fd);
+    });
+  }
+  for (auto& t : clients) {
+    t.join();
+  }
+  double seconds =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  backend::TcpIoStats stats = runtime.GetTcpIoStats();
+  runtime.Stop();
+  runtime.Join();
+
+  std::vector<double> all;
+  for (const auto& samples : latencies) {
+    all.insert(all.end(), samples.begin(), samples.end());
+  }
+  Result result;
+  result.ran = !all.empty();
+  if (!result.ran) {
+    return result;
+  }
+  std::sort(all.begin(), all.end());
+  result.syscalls_per_message = stats.IoSyscallsPerMessage();
+  result.p50_us = all[all.size() / 2];
+  result.p99_us = all[std::min(all.size() - 1, all.size() * 99 / 100)];
+  result.messages_per_second = static_cast<double>(all.size()) / seconds;
+  return result;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::string config_path = argc > 1 ? argv[1] : "config/app_config.cfg";
+  int connection_count = argc > 2 ? std::atoi(argv[2]) : 16;
+  int round_trips = argc > 3 ? std::atoi(argv[3]) : 2000;
+  std::size_t message_size = argc > 4 ? static_cast<std::size_t>(std::atoi(argv[4])) : 64;
+
+  backend::AppConfig config = backend::AppConfig::LoadFromFile(config_path);
+  config.log_level = "warn";
+  config.tcp_framing = "raw";
+  backend::InitLogger(config.log_level);
+
+  // Syscalls count every send, receive, wait and registration call the TCP IO
+  // threads made, divided by messages received plus messages sent.
+  std::printf("%-10s %18s %12s %12s %14s\n", "backend", "syscalls/message", "p50 us",
+              "p99 us", "round trips/s");
+  for (const char* io_backend : {"epoll", "io_uring"}) {
+    Result result =
+        RunPingPong(config, io_backend, connection_count, round_trips, message_size);
+    if (!result.ran) {
+      std::printf("%-10s %18s\n", io_backend, "failed");
+      continue;
+    }
+    std::printf("%-10s %18.2f %12.1f %12.1f %14.0f\n", io_backend,
+                result.syscalls_per_message, result.p50_us, result.p99_us,
+                result.messages_per_second);
+  }
+  return 0;
+}
@@ -0,0 +1,109 @@
+#include "mpsc_queue.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// The spinlock queue MpscQueue used before it became lock-free, kept here as
+// the baseline for the comparison.
+template <typename T>
+class SpinlockQueue {
+ public:
+  explicit SpinlockQueue(std::size_t capacity)
+      : buffer_(capacity),
+        capacity_(capacity),
+        head_(0),
+        tail_(0) {
+  }
+
+  bool Push(const T& value) {
+    while (lock_.test_and_set(std::memory_order_acquire)) {
+    }
+    std::size_t head = head_.load(std::memory_order_relaxed);
+    if (head - tail_ >= capacity_) {
+      lock_.clear(std::memory_order_release);
+      return false;
+    }
+    buffer_[head % capacity_] = value;
+    head_.store(head + 1, std::memory_order_release);
+    lock_.clear(std::memory_order_release);
+    return true;
+  }
+
+  bool Pop(T& out) {
+    std::size_t head = head_.load(std::memory_order_acquire);
+    if (tail_ == head) {
+      return false;
+    }
+    out = std::move(buffer_[tail_ % capacity_]);
+    ++tail_;
+    return true;
+  }
+
+ private:
+  std::vector<T> buffer_;
+  const std::size_t capacity_;
+  std::atomic<std::size_t> head_;
+  std::size_t tail_;
+  std::atomic_flag lock_ = ATOMIC_FLAG_INIT;
+};
+
+template <typename Queue>
+double RunOnce(int producer_count, std::uint64_t items_per_producer) {
+  Queue queue(65536);
+  std::atomic<bool> go{false};
+  std::vector<std::thread> producers;
+  for (int p = 0; p < producer_count; ++p) {
+    producers.emplace_back([&queue, &go, items_per_producer]() {
+      while (!go.load(std::memory_order_acquire)) {
+      }
+      for (std::uint64_t i = 0; i < items_per_producer; ++i) {
+        while (!queue.Push(i)) {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+  std::uint64_t total = items_per_producer * static_cast<std::uint64_t>(producer_count);
+  std::uint64_t received = 0;
+  std::uint64_t value = 0;
+  auto start = std::chrono::steady_clock::now();
+  go.store(true, std::memory_order_release);
+  while (received < total) {
+    if (queue.Pop(value)) {
+      ++received;
+    }
+  }
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  for (auto& t : producers) {
+    t.join();
+  }
+  double seconds = std::chrono::duration<double>(elapsed).count();
+  return static_cast<double>(total) / seconds / 1e6;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::uint64_t items_per_producer = 2000000;
+  if (argc > 1) {
+    items_per_producer = std::strtoull(argv[1], nullptr, 10);
+  }
+  std::printf("%-10s %16s %16s %8s\n", "producers", "spinlock Mops/s",
+              "lockfree Mops/s", "gain");
+  for (int producers = 1; producers <= 8; ++producers) {
+    double spin = RunOnce<SpinlockQueue<std::uint64_t>>(producers, items_per_producer);
+    double lockfree =
+        RunOnce<backend::MpscQueue<std::uint64_t>>(producers, items_per_producer);
+    std::printf("%-10d %16.2f %16.2f %7.2fx\n", producers, spin, lockfree,
+                lockfree / spin);
+  }
+  return 0;
+}
@@ -0,0 +1,111 @@
+#include "recorder.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+struct Result {
+  double seconds;
+  double file_calls_per_record;
+};
+
+std::string StreamPath(const std::string& dir, int stream, const char* suffix) {
+  return dir + "/session_" + std::to_string(stream) + suffix;
+}
+
+// What the disk thread did before the recorder: mkdir, fopen, fwrite and
+// fclose for every payload and every index record.
+Result RunPerRecordOpen(const std::string& dir, int streams, int packets,
+                        std::size_t packet_size) {
+  std::string payload(packet_size, 'p');
+  std::string index(32, 'i');
+  auto start = std::chrono::steady_clock::now();
+  for (int packet = 0; packet < packets; ++packet) {
+    for (int stream = 0; stream < streams; ++stream) {
+      for (int part = 0; part < 2; ++part) {
+        ::mkdir(dir.c_str(), 0755);
+        const std::string& data = part == 0 ? payload : index;
+        FILE* f = ::fopen(StreamPath(dir, stream, part == 0 ? ".bin" : ".ridx").c_str(), "ab");
+        if (f) {
+          (void)::fwrite(data.data(), 1, data.size(), f);
+          ::fclose(f);
+        }
+      }
+    }
+  }
+  Result result;
+  result.seconds =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  // mkdir, open, write, close.
+  result.file_calls_per_record = 4.0;
+  return result;
+}
+
+Result RunRecorder(const std::string& dir, int streams, int packets, std::size_t packet_size,
+                   std::size_t max_open_files) {
+  std::string payload(packet_size, 'p');
+  std::string index(32, 'i');
+  std::vector<std::string> paths;
+  for (int stream = 0; stream < streams; ++stream) {
+    paths.push_back(StreamPath(dir, stream, ".bin"));
+    paths.push_back(StreamPath(dir, stream, ".ridx"));
+  }
+  backend::RecorderCounters counters;
+  auto start = std::chrono::steady_clock::now();
+  {
+    backend::Recorder recorder(max_open_files, 65536, 1000, &counters);
+    for (int packet = 0; packet < packets; ++packet) {
+      for (int stream = 0; stream < streams; ++stream) {
+        recorder.Append(paths[stream * 2], payload.data(), payload.size(), 0);
+        recorder.Append(paths[stream * 2 + 1], index.data(), index.size(), 0);
+      }
+    }
+  }
+  Result result;
+  result.seconds =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  backend::RecorderStats stats{};
+  stats.records = counters.records.load();
+  stats.write_calls = counters.write_calls.load();
+  stats.opens = counters.opens.load();
+  stats.closes = counters.closes.load();
+  result.file_calls_per_record = stats.WriteAmplification();
+  return result;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int streams = argc > 1 ? std::atoi(argv[1]) : 100;
+  int packets = argc > 2 ? std::atoi(argv[2]) : 500;
+  std::size_t packet_size = argc > 3 ? static_cast<std::size_t>(std::atoi(argv[3])) : 1200;
+  std::string dir = argc > 4 ? argv[4] : "bench_recorder";
+
+  // Every stream records a payload and an index record per packet. With
+  // fewer open files than files, the LRU cycles and each eviction costs a
+  // close and a reopen, which is still far below one open per record.
+  std::printf("%-22s %10s %12s %18s\n", "mode", "seconds", "records/s", "file calls/record");
+  double records = static_cast<double>(streams) * packets * 2;
+  Result open_each = RunPerRecordOpen(dir, streams, packets, packet_size);
+  std::printf("%-22s %10.3f %12.0f %18.3f\n", "open per record", open_each.seconds,
+              records / open_each.seconds, open_each.file_calls_per_record);
+  for (std::size_t max_open : {static_cast<std::size_t>(streams) * 2, std::size_t(64)}) {
+    Result buffered = RunRecorder(dir, streams, packets, packet_size, max_open);
+    std::string mode = "recorder, " + std::to_string(max_open) + " open";
+    std::printf("%-22s %10.3f %12.0f %18.3f\n", mode.c_str(), buffered.seconds,
+                records / buffered.seconds, buffered.file_calls_per_record);
+  }
+  for (int stream = 0; stream < streams; ++stream) {
+    std::remove(StreamPath(dir, stream, ".bin").c_str());
+    std::remove(StreamPath(dir, stream, ".ridx").c_str());
+  }
+  ::rmdir(dir.c_str());
+  return 0;
+}
@@ -0,0 +1,108 @@
+#include "rtcp.h"
+#include "rtp_classifier.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Mostly RTP of a few sizes, with some RTCP, STUN and other datagrams.
+std::vector<std::string> MakePackets(std::size_t count) {
+  std::mt19937 random(1);
+  std::vector<std::string> packets;
+  for (std::size_t i = 0; i < count; ++i) {
+    std::string packet(random() % 2 != 0 ? 1200 : 160, 'p');
+    unsigned pick = random() % 20;
+    if (pick == 0) {
+      packet.resize(32);
+      packet[0] = static_cast<char>(0x81);
+      packet[1] = static_cast<char>(backend::kRtcpReceiverReport);
+    } else if (pick == 1) {
+      packet.assign(20, 0);
+      packet[1] = 1;
+      packet[4] = 0x21;
+      packet[5] = 0x12;
+      packet[6] = static_cast<char>(0xA4);
+      packet[7] = 0x42;
+    } else if (pick == 2) {
+      packet[0] = 'x';
+    } else {
+      packet[0] = static_cast<char>(0x80);
+      packet[1] = static_cast<char>(96 | (random() % 2 != 0 ? 0x80 : 0));
+      for (int b = 2; b < 12; ++b) {
+        packet[b] = static_cast<char>(random());
+      }
+    }
+    packets.push_back(packet);
+  }
+  return packets;
+}
+
+double Seconds(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::size_t batch_size = argc > 1 ? static_cast<std::size_t>(std::atoi(argv[1])) : 32;
+  int rounds = argc > 2 ? std::atoi(argv[2]) : 200000;
+
+  // One recvmmsg batch, classified over and over.
+  std::vector<std::string> packets = MakePackets(batch_size);
+  std::vector<const char*> data;
+  std::vector<std::size_t> len;
+  for (const std::string& packet : packets) {
+    data.push_back(packet.data());
+    len.push_back(packet.size());
+  }
+  double total = static_cast<double>(batch_size) * rounds;
+
+  // What the UDP IO thread did per datagram before: IsRtcp, then
+  // ParseRtpHeader.
+  std::uint64_t checksum = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int round = 0; round < rounds; ++round) {
+    for (std::size_t i = 0; i < batch_size; ++i) {
+      backend::RtpHeader header;
+      if (backend::IsRtcp(data[i], len[i])) {
+        checksum += 1;
+      } else if (backend::ParseRtpHeader(data[i], len[i], header)) {
+        checksum += header.ssrc + header.sequence_number;
+      }
+    }
+  }
+  double scalar = Seconds(start);
+  std::uint64_t scalar_checksum = checksum;
+
+  checksum = 0;
+  backend::PacketBatch batch;
+  start = std::chrono::steady_clock::now();
+  for (int round = 0; round < rounds; ++round) {
+    backend::ClassifyPackets(data.data(), len.data(), batch_size, batch);
+    for (std::size_t i = 0; i < batch_size; ++i) {
+      if (batch.kind[i] == backend::PacketClass::Rtcp) {
+        checksum += 1;
+      } else if (batch.kind[i] == backend::PacketClass::Rtp) {
+        checksum += batch.ssrc[i] + batch.sequence_number[i];
+      }
+    }
+  }
+  double batched = Seconds(start);
+
+  std::printf("%-16s %10s %14s %10s\n", "mode", "seconds", "packets/s", "ns/packet");
+  std::printf("%-16s %10.3f %14.0f %10.2f\n", "scalar", scalar, total / scalar,
+              scalar * 1e9 / total);
+  std::printf("%-16s %10.3f %14.0f %10.2f\n", "batch", batched, total / batched,
+              batched * 1e9 / total);
+  if (checksum != scalar_checksum) {
+    std::printf("checksum mismatch\n");
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,119 @@
+#include "app_config.h"
+#include "logger.h"
+#include "runtime.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+struct Mode {
+  const char* name;
+  bool edge_triggered;
+  const char* accept_mode;
+};
+
+// Opens connection_count connections from client_threads threads as fast as
+// possible and measures how long the server needs to accept all of them.
+double RunStorm(backend::AppConfig config, const Mode& mode, int connection_count,
+                int client_threads) {
+  config.tcp_edge_triggered = mode.edge_triggered;
+  config.tcp_accept_mode = mode.accept_mode;
+  backend::Runtime runtime(config);
+  runtime.Start();
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+  sockaddr_in addr;
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(config.tcp_port);
+  ::inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+
+  std::vector<std::vector<int>> client_fds(static_cast<std::size_t>(client_threads));
+  std::vector<std::thread> clients;
+  auto start = std::chrono::steady_clock::now();
+  for (int t = 0; t < client_threads; ++t) {
+    clients.emplace_back([&, t]() {
+      int share = connection_count / client_threads;
+      for (int i = 0; i < share; ++i) {
+        int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        if (fd < 0) {
+          break;
+        }
+        if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+          ::close(fd);
+          continue;
+        }
+        client_fds[static_cast<std::size_t>(t)].push_back(fd);
+      }
+    });
+  }
+  for (auto& t : clients) {
+    t.join();
+  }
+  std::uint64_t expected = 0;
+  for (const auto& fds : client_fds) {
+    expected += fds.size();
+  }
+  auto deadline = start + std::chrono::seconds(30);
+  while (runtime.GetTcpIoStats().accepted < expected &&
+         std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::microseconds(200));
+  }
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  std::uint64_t accepted = runtime.GetTcpIoStats().accepted;
+
+  linger no_linger;
+  no_linger.l_onoff = 1;
+  no_linger.l_linger = 0;
+  for (const auto& fds : client_fds) {
+    for (int fd : fds) {
+      ::setsockopt(fd, SOL_SOCKET, SO_LINGER, &no_linger, sizeof(no_linger));
+      ::close(fd);
+    }
+  }
+  runtime.Stop();
+  runtime.Join();
+  double seconds = std::chrono::duration<double>(elapsed).count();
+  return static_cast<double>(accepted) / seconds;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::string config_path = argc > 1 ? argv[1] : "config/app_config.cfg";
+  int connection_count = argc > 2 ? std::atoi(argv[2]) : 5000;
+  int client_threads = argc > 3 ? std::atoi(argv[3]) : 4;
+
+  rlimit limit;
+  if (::getrlimit(RLIMIT_NOFILE, &limit) == 0) {
+    limit.rlim_cur = limit.rlim_max;
+    ::setrlimit(RLIMIT_NOFILE, &limit);
+  }
+
+  backend::AppConfig config = backend::AppConfig::LoadFromFile(config_path);
+  config.log_level = "warn";
+  backend::InitLogger(config.log_level);
+
+  const Mode modes[] = {
+      {"level-triggered reuseport", false, "reuseport"},
+      {"edge-triggered reuseport", true, "reuseport"},
+      {"edge-triggered exclusive", true, "exclusive"},
+  };
+  std::printf("%-28s %16s\n", "mode", "accepts/s");
+  for (const Mode& mode : modes) {
+    double rate = RunStorm(config, mode, connection_count, client_threads);
+    std::printf("%-28s %16.0f\n", mode.name, rate);
+  }
+  return 0;
+}
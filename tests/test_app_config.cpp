@@ -1,6 +1,9 @@
 #include "app_config.h"
+#include "rtcp.h"
 
+#include <cstdio>
 #include <fstream>
+#include <limits>
 #include <string>
 
 #include <gtest/gtest.h>
@@ -17,6 +20,17 @@ std::string WriteTempConfig() {
   return path;
 }
 
+// Loads a config holding only line and removes the file again.
+backend::AppConfig LoadConfigLine(const std::string& line) {
+  std::string path = "test_temp_app_config_line.cfg";
+  std::ofstream output(path);
+  output << line << '\n';
+  output.close();
+  backend::AppConfig config = backend::AppConfig::LoadFromFile(path);
+  std::remove(path.c_str());
+  return config;
+}
+
 }  // namespace
 
 TEST(AppConfigTest, LoadFromFileParsesValues) {
@@ -25,6 +39,37 @@ TEST(AppConfigTest, LoadFromFileParsesValues) {
   EXPECT_EQ(config.node_name, "test-node");
   EXPECT_EQ(config.log_level, "debug");
   EXPECT_EQ(config.tcp_port, 12345);
+  EXPECT_EQ(config.io_backend, "epoll");
+  EXPECT_GT(config.io_uring_entries, 0u);
+  EXPECT_GT(config.io_uring_buffer_count, 0u);
+  EXPECT_GT(config.io_uring_buffer_size, 0u);
+  EXPECT_GT(config.tcp_listen_backlog, 0);
+  EXPECT_GT(config.tcp_accept_batch, 0);
+  EXPECT_FALSE(config.tcp_edge_triggered);
+  EXPECT_EQ(config.tcp_accept_mode, "reuseport");
+  EXPECT_EQ(config.tcp_worker_assignment, "round_robin");
+  EXPECT_LT(config.tcp_send_low_watermark, config.tcp_send_high_watermark);
+  EXPECT_EQ(config.tcp_framing, "raw");
+  EXPECT_EQ(config.tcp_frame_length_bytes, 4);
+  EXPECT_EQ(config.tcp_frame_delimiter, "\n");
+  EXPECT_GT(config.tcp_max_message_size, 0u);
+  EXPECT_EQ(config.tcp_idle_timeout_ms, 300000u);
+  EXPECT_EQ(config.udp_idle_timeout_ms, 60000u);
+  EXPECT_EQ(config.udp_batch_size, 32u);
+  EXPECT_EQ(config.udp_max_datagram_size, 65536u);
+  EXPECT_TRUE(config.udp_gso);
+  EXPECT_TRUE(config.udp_gro);
+  EXPECT_EQ(config.rtp_idle_timeout_ms, 30000u);
+  EXPECT_EQ(config.rtp_forward_sample_every, 1000u);
+  EXPECT_EQ(config.rtp_jitter_buffer_ms, 0u);
+  EXPECT_EQ(config.rtp_clock_rate, 90000u);
+  EXPECT_EQ(config.rtcp_report_interval_ms, 5000u);
+  EXPECT_EQ(config.recorder_max_open_files, 64u);
+  EXPECT_EQ(config.recorder_block_size, 65536u);
+  EXPECT_EQ(config.recorder_flush_interval_ms, 1000u);
+  EXPECT_EQ(config.recording_segment_bytes, 16777216u);
+  EXPECT_EQ(config.recording_segment_ms, 300000u);
+  EXPECT_EQ(config.recording_retention_bytes, 0u);
   EXPECT_GT(config.tcp_io_threads, 0);
   EXPECT_GT(config.udp_io_threads, 0);
   EXPECT_GT(config.worker_threads, 0);
@@ -35,4 +80,36 @@ TEST(AppConfigTest, LoadFromFileParsesValues) {
   EXPECT_GT(config.queue_size_worker_to_io, 0u);
   EXPECT_GT(config.queue_size_worker_to_disk, 0u);
   EXPECT_GT(config.queue_size_worker_to_log, 0u);
+  EXPECT_GT(config.tcp_read_pause_watermark, 0u);
+  EXPECT_LE(config.tcp_read_pause_watermark, config.queue_size_io_to_worker);
+  EXPECT_GT(config.queue_batch_size, 0u);
+  EXPECT_GT(config.queue_spin_iterations, 0);
+}
+
+TEST(AppConfigTest, ZeroReportIntervalSchedulesNoReports) {
+  backend::AppConfig config = LoadConfigLine("rtcp_report_interval_ms=0");
+  EXPECT_EQ(config.rtcp_report_interval_ms, 0u);
+  EXPECT_EQ(backend::NextRtcpReportMs(1000, config.rtcp_report_interval_ms, 12345),
+            std::numeric_limits<std::uint64_t>::max());
+  config = LoadConfigLine("rtcp_report_interval_ms=2000");
+  std::uint64_t next = backend::NextRtcpReportMs(1000, config.rtcp_report_interval_ms, 12345);
+  EXPECT_GE(next, 2000u);
+  EXPECT_LE(next, 4000u);
+}
+
+TEST(AppConfigTest, ZeroFlushIntervalIsKept) {
+  backend::AppConfig config = LoadConfigLine("recorder_flush_interval_ms=0");
+  EXPECT_EQ(config.recorder_flush_interval_ms, 0u);
+}
+
+TEST(AppConfigTest, ZeroSegmentBytesLiftsTheLimit) {
+  backend::AppConfig config = LoadConfigLine("recording_segment_bytes=0");
+  EXPECT_EQ(config.recording_segment_bytes, 0u);
+  EXPECT_EQ(config.recording_segment_ms, 300000u);
+}
+
+TEST(AppConfigTest, ZeroSegmentMsLiftsTheLimit) {
+  backend::AppConfig config = LoadConfigLine("recording_segment_ms=0");
+  EXPECT_EQ(config.recording_segment_ms, 0u);
+  EXPECT_EQ(config.recording_segment_bytes, 16777216u);
 }
@@ -0,0 +1,135 @@
+#include "conn.h"
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace {
+
+std::string Collect(const backend::SendQueue& queue, int max_iov) {
+  std::vector<iovec> iov(static_cast<std::size_t>(max_iov));
+  int count = queue.FillIov(iov.data(), max_iov);
+  std::string result;
+  for (int i = 0; i < count; ++i) {
+    result.append(static_cast<const char*>(iov[i].iov_base), iov[i].iov_len);
+  }
+  return result;
+}
+
+}  // namespace
+
+TEST(SendQueueTest, GathersChunksInOrder) {
+  backend::SendQueue queue;
+  queue.Append("abc");
+  queue.Append("");
+  queue.Append("defg");
+  queue.Append("h");
+  EXPECT_EQ(queue.PendingBytes(), 8u);
+  EXPECT_EQ(Collect(queue, 16), "abcdefgh");
+  EXPECT_EQ(Collect(queue, 2), "abcdefg");
+}
+
+TEST(SendQueueTest, PartialConsumeResumesMidChunk) {
+  backend::SendQueue queue;
+  queue.Append("abc");
+  queue.Append("defg");
+  queue.Consume(2);
+  EXPECT_EQ(Collect(queue, 16), "cdefg");
+  queue.Consume(3);
+  EXPECT_EQ(Collect(queue, 16), "fg");
+  EXPECT_EQ(queue.PendingBytes(), 2u);
+  queue.Consume(2);
+  EXPECT_TRUE(queue.Empty());
+  queue.Append("xyz");
+  EXPECT_EQ(Collect(queue, 16), "xyz");
+}
+
+TEST(SendQueueTest, ManySmallChunksCompact) {
+  backend::SendQueue queue;
+  std::string expected;
+  for (int i = 0; i < 500; ++i) {
+    std::string chunk(1, static_cast<char>('a' + i % 26));
+    expected += chunk;
+    queue.Append(std::move(chunk));
+  }
+  for (int i = 0; i < 300; ++i) {
+    queue.Consume(1);
+  }
+  EXPECT_EQ(Collect(queue, 1024), expected.substr(300));
+}
+
+TEST(TcpConnTableTest, AddFindRemove) {
+  backend::TcpConnTable table;
+  backend::Conn* conn = table.Add(5);
+  ASSERT_NE(conn, nullptr);
+  EXPECT_EQ(conn->fd, 5);
+  EXPECT_EQ(table.Add(5), nullptr);
+  EXPECT_EQ(table.Find(5), conn);
+  EXPECT_EQ(table.Find(6), nullptr);
+  EXPECT_EQ(table.Find(1 << 20), nullptr);
+  EXPECT_EQ(table.Size(), 1u);
+  table.Remove(5);
+  EXPECT_EQ(table.Find(5), nullptr);
+  EXPECT_EQ(table.Size(), 0u);
+}
+
+TEST(TcpConnTableTest, ReusedFdGetsNewGeneration) {
+  backend::TcpConnTable table;
+  backend::Conn* first = table.Add(3000);
+  ASSERT_NE(first, nullptr);
+  std::uint64_t stale = backend::MakeSessionId(2, 3000, first->generation);
+  first->Send().Append("pending");
+  table.Remove(3000);
+
+  backend::Conn* second = table.Add(3000);
+  ASSERT_NE(second, nullptr);
+  EXPECT_EQ(second, first);
+  EXPECT_EQ(second->PendingSendBytes(), 0u);
+  std::uint64_t fresh = backend::MakeSessionId(2, 3000, second->generation);
+  EXPECT_NE(stale, fresh);
+  EXPECT_EQ(table.Find(3000, backend::SessionGeneration(stale)), nullptr);
+  EXPECT_EQ(table.Find(3000, backend::SessionGeneration(fresh)), second);
+  EXPECT_EQ(backend::SessionOwner(fresh), 2);
+  EXPECT_EQ(backend::SessionIndex(fresh), 3000u);
+}
+
+TEST(TcpConnTableTest, GrowthKeepsEntriesInPlace) {
+  backend::TcpConnTable table;
+  backend::Conn* low = table.Add(1);
+  ASSERT_NE(low, nullptr);
+  for (int fd = 2; fd < 5000; ++fd) {
+    ASSERT_NE(table.Add(fd), nullptr);
+  }
+  EXPECT_EQ(table.Find(1), low);
+  table.Info(4999).remote_port = 4242;
+  EXPECT_EQ(table.Info(4999).remote_port, 4242);
+  EXPECT_EQ(table.Size(), 4999u);
+}
+
+TEST(RecvRingTest, ReadsWrapAndLinearize) {
+  backend::RecvRing ring(8);
+  iovec iov[2];
+  ASSERT_EQ(ring.FillIov(iov), 1);
+  EXPECT_EQ(iov[0].iov_len, 8u);
+  std::memcpy(iov[0].iov_base, "abcdef", 6);
+  ring.Commit(6);
+  ring.Consume(4);
+  EXPECT_EQ(std::string(ring.Data(), ring.Size()), "ef");
+
+  ASSERT_EQ(ring.FillIov(iov), 2);
+  EXPECT_EQ(iov[0].iov_len, 2u);
+  EXPECT_EQ(iov[1].iov_len, 4u);
+  std::memcpy(iov[0].iov_base, "gh", 2);
+  std::memcpy(iov[1].iov_base, "ijkl", 4);
+  ring.Commit(6);
+  EXPECT_TRUE(ring.Full());
+  EXPECT_EQ(ring.FillIov(iov), 0);
+  EXPECT_EQ(std::string(ring.Data(), ring.Size()), "efghijkl");
+  ring.Consume(8);
+  EXPECT_EQ(ring.Size(), 0u);
+  ASSERT_EQ(ring.FillIov(iov), 1);
+  EXPECT_EQ(iov[0].iov_len, 8u);
+}
@@ -0,0 +1,139 @@
+#include "framer.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace {
+
+std::vector<std::string> Payloads(const std::vector<backend::Event>& events) {
+  std::vector<std::string> result;
+  for (const auto& event : events) {
+    result.push_back(event.payload);
+  }
+  return result;
+}
+
+// Appends chunk to the unread bytes in buffer, frames them and keeps the
+// unconsumed tail, the way the IO thread does with its receive ring.
+bool Feed(backend::Framer& framer, std::string& buffer, const std::string& chunk,
+          std::vector<backend::Event>& out) {
+  buffer.append(chunk);
+  std::size_t consumed = framer.Feed(buffer.data(), buffer.size(), out);
+  if (consumed == backend::ProtocolHandler::kFrameError) {
+    return false;
+  }
+  buffer.erase(0, consumed);
+  return true;
+}
+
+std::string Prefixed(const std::string& body) {
+  std::string frame;
+  frame.push_back(static_cast<char>((body.size() >> 8) & 0xFF));
+  frame.push_back(static_cast<char>(body.size() & 0xFF));
+  return frame + body;
+}
+
+// Frames "<digit>" followed by that many bytes.
+class DigitHandler : public backend::ProtocolHandler {
+ public:
+  std::size_t Frame(const char* data, std::size_t length) override {
+    if (data[0] < '0' || data[0] > '9') {
+      return kFrameError;
+    }
+    std::size_t size = 1 + static_cast<std::size_t>(data[0] - '0');
+    return length < size ? 0 : size;
+  }
+
+  bool Parse(const char* data, std::size_t length, backend::Event& out_event) override {
+    out_event.payload.assign(data + 1, length - 1);
+    return true;
+  }
+
+  bool Encode(const backend::Event& event, std::string& out_bytes) override {
+    out_bytes = std::to_string(event.payload.size()) + event.payload;
+    return true;
+  }
+};
+
+}  // namespace
+
+TEST(FramerTest, LengthPrefixReassemblesSplitMessages) {
+  backend::Framer framer(std::make_shared<backend::LengthPrefixHandler>(2, 1024));
+  std::string stream = Prefixed("hello") + Prefixed("") + Prefixed("world!");
+  std::string partial;
+  std::vector<backend::Event> out;
+  for (char c : stream) {
+    ASSERT_TRUE(Feed(framer, partial, std::string(1, c), out));
+  }
+  EXPECT_TRUE(partial.empty());
+  EXPECT_EQ(Payloads(out), (std::vector<std::string>{"hello", "", "world!"}));
+}
+
+TEST(FramerTest, LengthPrefixParsesWholeReadsInPlace) {
+  backend::Framer framer(std::make_shared<backend::LengthPrefixHandler>(2, 1024));
+  std::string stream = Prefixed("one") + Prefixed("two") + Prefixed("three").substr(0, 4);
+  std::vector<backend::Event> out;
+  EXPECT_EQ(framer.Feed(stream.data(), stream.size(), out), 10u);
+  EXPECT_EQ(Payloads(out), (std::vector<std::string>{"one", "two"}));
+  std::string partial = stream.substr(10);
+  ASSERT_TRUE(Feed(framer, partial, "ree", out));
+  EXPECT_EQ(out.back().payload, "three");
+  EXPECT_TRUE(partial.empty());
+}
+
+TEST(FramerTest, LengthPrefixRejectsOversizedMessages) {
+  backend::Framer framer(std::make_shared<backend::LengthPrefixHandler>(4, 16));
+  std::string header("\x00\x00\x01\x00", 4);
+  std::vector<backend::Event> out;
+  EXPECT_EQ(framer.Feed(header.data(), header.size(), out),
+            backend::ProtocolHandler::kFrameError);
+}
+
+TEST(FramerTest, DelimiterSplitsLines) {
+  backend::Framer framer(std::make_shared<backend::DelimiterHandler>("\r\n", 64));
+  std::string partial;
+  std::vector<backend::Event> out;
+  std::string first = "GET a\r\nGET b\r";
+  std::string second = "\nGET";
+  ASSERT_TRUE(Feed(framer, partial, first, out));
+  ASSERT_TRUE(Feed(framer, partial, second, out));
+  EXPECT_EQ(Payloads(out), (std::vector<std::string>{"GET a", "GET b"}));
+  EXPECT_EQ(partial, "GET");
+}
+
+TEST(FramerTest, DelimiterRejectsRunawayLines) {
+  backend::Framer framer(std::make_shared<backend::DelimiterHandler>("\n", 8));
+  std::string partial;
+  std::vector<backend::Event> out;
+  EXPECT_FALSE(Feed(framer, partial, std::string(32, 'x'), out));
+}
+
+TEST(FramerTest, CustomHandlerFromRegistry) {
+  backend::ProtocolRegistry::Instance().RegisterHandler("digits",
+                                                        std::make_shared<DigitHandler>());
+  auto handler = backend::ProtocolRegistry::Instance().GetHandler("digits");
+  ASSERT_NE(handler, nullptr);
+  backend::Framer framer(handler);
+  std::string partial;
+  std::vector<backend::Event> out;
+  ASSERT_TRUE(Feed(framer, partial, "3abc0", out));
+  ASSERT_TRUE(Feed(framer, partial, "2x", out));
+  EXPECT_EQ(Payloads(out), (std::vector<std::string>{"abc", ""}));
+  EXPECT_EQ(partial, "2x");
+  std::string fresh;
+  EXPECT_FALSE(Feed(framer, fresh, "x", out));
+  EXPECT_FALSE(backend::ProtocolRegistry::Instance().GetHandler("missing"));
+}
+
+TEST(FramerTest, RawPassesReadsThrough) {
+  backend::Framer framer(std::make_shared<backend::RawHandler>());
+  std::string partial;
+  std::vector<backend::Event> out;
+  ASSERT_TRUE(Feed(framer, partial, "abc", out));
+  ASSERT_TRUE(Feed(framer, partial, "de", out));
+  EXPECT_EQ(Payloads(out), (std::vector<std::string>{"abc", "de"}));
+  EXPECT_TRUE(partial.empty());
+}
@@ -1,6 +1,8 @@
 #include "mpsc_queue.h"
 
 #include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <thread>
 #include <vector>
 
@@ -19,6 +21,22 @@ TEST(MpscQueueTest, SingleThreadPushPopKeepsOrder) {
   EXPECT_FALSE(queue.Pop(value));
 }
 
+TEST(MpscQueueTest, SizeTracksQueuedItems) {
+  backend::MpscQueue<int> queue(16);
+  EXPECT_EQ(queue.Size(), 0u);
+  int items[5] = {1, 2, 3, 4, 5};
+  EXPECT_EQ(queue.PushBatch(items, 5), 5u);
+  queue.Push(6);
+  EXPECT_EQ(queue.Size(), 6u);
+  int out[4];
+  EXPECT_EQ(queue.PopBatch(out, 4), 4u);
+  EXPECT_EQ(queue.Size(), 2u);
+  int value = 0;
+  queue.Pop(value);
+  queue.Pop(value);
+  EXPECT_EQ(queue.Size(), 0u);
+}
+
 TEST(MpscQueueTest, MultiProducerSingleConsumerTransfersAllItems) {
   backend::MpscQueue<int> queue(1024);
   const int producer_count = 4;
@@ -53,3 +71,163 @@ TEST(MpscQueueTest, MultiProducerSingleConsumerTransfersAllItems) {
   EXPECT_EQ(consumed.load(), total);
 }
 
+
+TEST(MpscQueueTest, CapacityIsRoundedUpToPowerOfTwo) {
+  backend::MpscQueue<int> queue(100);
+  EXPECT_EQ(queue.Capacity(), 128u);
+  for (int i = 0; i < 128; ++i) {
+    EXPECT_TRUE(queue.Push(i));
+  }
+  EXPECT_FALSE(queue.Push(128));
+  int value = 0;
+  EXPECT_TRUE(queue.Pop(value));
+  EXPECT_EQ(value, 0);
+  EXPECT_TRUE(queue.Push(128));
+}
+
+TEST(MpscQueueTest, ContendedProducersKeepPerProducerOrder) {
+  backend::MpscQueue<std::uint64_t> queue(64);
+  const int producer_count = 8;
+  const std::uint64_t items_per_producer = 20000;
+  std::atomic<bool> go{false};
+  std::vector<std::thread> producers;
+  for (int p = 0; p < producer_count; ++p) {
+    producers.emplace_back([&queue, &go, p, items_per_producer]() {
+      while (!go.load()) {
+      }
+      for (std::uint64_t i = 0; i < items_per_producer; ++i) {
+        std::uint64_t value = (static_cast<std::uint64_t>(p) << 32) | i;
+        while (!queue.Push(value)) {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+  go.store(true);
+  std::vector<std::uint64_t> next(producer_count, 0);
+  std::uint64_t total = producer_count * items_per_producer;
+  std::uint64_t received = 0;
+  std::uint64_t value = 0;
+  while (received < total) {
+    if (!queue.Pop(value)) {
+      std::this_thread::yield();
+      continue;
+    }
+    int producer = static_cast<int>(value >> 32);
+    ASSERT_LT(producer, producer_count);
+    ASSERT_EQ(value & 0xFFFFFFFFu, next[producer]);
+    ++next[producer];
+    ++received;
+  }
+  for (auto& t : producers) {
+    t.join();
+  }
+  for (int p = 0; p < producer_count; ++p) {
+    EXPECT_EQ(next[p], items_per_producer);
+  }
+  EXPECT_FALSE(queue.Pop(value));
+}
+
+TEST(MpscQueueTest, PushBatchAcceptsOnlyFreeSlots) {
+  backend::MpscQueue<int> queue(8);
+  std::vector<int> items = {0, 1, 2, 3, 4, 5};
+  EXPECT_EQ(queue.PushBatch(items.data(), items.size()), 6u);
+  std::vector<int> more = {6, 7, 8, 9};
+  std::size_t accepted = queue.PushBatch(more.data(), more.size());
+  EXPECT_GE(accepted, 1u);
+  EXPECT_LE(accepted, 2u);
+  std::vector<int> out(16);
+  std::size_t popped = queue.PopBatch(out.data(), out.size());
+  ASSERT_EQ(popped, 6u + accepted);
+  for (std::size_t i = 0; i < popped; ++i) {
+    EXPECT_EQ(out[i], static_cast<int>(i));
+  }
+  EXPECT_EQ(queue.PopBatch(out.data(), out.size()), 0u);
+}
+
+TEST(MpscQueueTest, PopBatchRespectsMaxCount) {
+  backend::MpscQueue<int> queue(16);
+  for (int i = 0; i < 10; ++i) {
+    EXPECT_TRUE(queue.Push(i));
+  }
+  std::vector<int> out(4);
+  EXPECT_EQ(queue.PopBatch(out.data(), out.size()), 4u);
+  EXPECT_EQ(out[3], 3);
+  int value = 0;
+  EXPECT_TRUE(queue.Pop(value));
+  EXPECT_EQ(value, 4);
+}
+
+TEST(MpscQueueTest, BatchedProducersTransferAllItems) {
+  backend::MpscQueue<std::uint64_t> queue(256);
+  const int producer_count = 4;
+  const std::uint64_t items_per_producer = 20000;
+  const std::size_t batch = 16;
+  std::vector<std::thread> producers;
+  for (int p = 0; p < producer_count; ++p) {
+    producers.emplace_back([&queue, p, items_per_producer, batch]() {
+      std::vector<std::uint64_t> pending;
+      std::uint64_t i = 0;
+      while (i < items_per_producer || !pending.empty()) {
+        while (pending.size() < batch && i < items_per_producer) {
+          pending.push_back((static_cast<std::uint64_t>(p) << 32) | i);
+          ++i;
+        }
+        std::size_t accepted = queue.PushBatch(pending.data(), pending.size());
+        pending.erase(pending.begin(),
+                      pending.begin() + static_cast<std::ptrdiff_t>(accepted));
+        if (accepted == 0) {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+  std::vector<std::uint64_t> next(producer_count, 0);
+  std::vector<std::uint64_t> out(32);
+  std::uint64_t total = producer_count * items_per_producer;
+  std::uint64_t received = 0;
+  while (received < total) {
+    std::size_t count = queue.PopBatch(out.data(), out.size());
+    if (count == 0) {
+      std::this_thread::yield();
+      continue;
+    }
+    for (std::size_t i = 0; i < count; ++i) {
+      int producer = static_cast<int>(out[i] >> 32);
+      ASSERT_EQ(out[i] & 0xFFFFFFFFu, next[producer]);
+      ++next[producer];
+    }
+    received += count;
+  }
+  for (auto& t : producers) {
+    t.join();
+  }
+  EXPECT_EQ(received, total);
+}
+
+TEST(MpscQueueTest, ParkedConsumerIsWokenByPush) {
+  backend::EventNotifier notifier;
+  backend::MpscQueue<int> queue(16);
+  queue.SetNotifier(&notifier);
+  std::atomic<int> received{-1};
+  std::thread consumer([&]() {
+    int value = 0;
+    auto try_pop = [&]() {
+      if (!queue.Pop(value)) {
+        return false;
+      }
+      received.store(value);
+      return true;
+    };
+    while (received.load() < 0) {
+      notifier.Await(try_pop, 10, 5000);
+    }
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  auto start = std::chrono::steady_clock::now();
+  EXPECT_TRUE(queue.Push(42));
+  consumer.join();
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  EXPECT_EQ(received.load(), 42);
+  EXPECT_LT(elapsed, std::chrono::milliseconds(1000));
+}
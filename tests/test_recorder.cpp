@@ -0,0 +1,111 @@
+#include "logger.h"
+#include "recorder.h"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include <gtest/gtest.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+std::string ReadFile(const std::string& path) {
+  std::ifstream input(path, std::ios::binary);
+  std::stringstream content;
+  content << input.rdbuf();
+  return content.str();
+}
+
+}  // namespace
+
+TEST(RecorderTest, BuffersUntilBlockIsFull) {
+  backend::RecorderCounters counters;
+  std::string path = "test_recorder_dir/a/block.bin";
+  std::remove(path.c_str());
+  {
+    // Rounded up to one 4096-byte block.
+    backend::Recorder recorder(4, 100, 60000, &counters);
+    std::string record(1000, 'r');
+    for (int i = 0; i < 4; ++i) {
+      ASSERT_TRUE(recorder.Append(path, record.data(), record.size(), 0));
+    }
+    EXPECT_EQ(ReadFile(path).size(), 0u);
+    EXPECT_EQ(counters.write_calls.load(), 0u);
+    // The fifth record does not fit: the first four go out in one write.
+    ASSERT_TRUE(recorder.Append(path, record.data(), record.size(), 0));
+    EXPECT_EQ(ReadFile(path).size(), 4000u);
+    EXPECT_EQ(counters.write_calls.load(), 1u);
+  }
+  EXPECT_EQ(ReadFile(path).size(), 5000u);
+  EXPECT_EQ(counters.records.load(), 5u);
+  EXPECT_EQ(counters.opens.load(), 1u);
+  EXPECT_EQ(counters.closes.load(), 1u);
+  EXPECT_EQ(counters.written_bytes.load(), 5000u);
+  std::remove(path.c_str());
+  ::rmdir("test_recorder_dir/a");
+  ::rmdir("test_recorder_dir");
+}
+
+TEST(RecorderTest, FlushesByTime) {
+  backend::RecorderCounters counters;
+  std::string path = "test_recorder_time.bin";
+  std::remove(path.c_str());
+  backend::Recorder recorder(4, 65536, 100, &counters);
+  ASSERT_TRUE(recorder.Append(path, "abc", 3, 1000));
+  recorder.FlushDue(1050);
+  EXPECT_EQ(ReadFile(path), "");
+  recorder.FlushDue(1100);
+  EXPECT_EQ(ReadFile(path), "abc");
+  std::remove(path.c_str());
+}
+
+TEST(RecorderTest, FlushesEveryPassWithoutInterval) {
+  backend::RecorderCounters counters;
+  std::string path = "test_recorder_no_interval.bin";
+  std::remove(path.c_str());
+  backend::Recorder recorder(4, 65536, 0, &counters);
+  ASSERT_TRUE(recorder.Append(path, "abc", 3, 1000));
+  EXPECT_EQ(ReadFile(path), "");
+  recorder.FlushDue(1000);
+  EXPECT_EQ(ReadFile(path), "abc");
+  std::remove(path.c_str());
+}
+
+TEST(RecorderTest, EvictsLeastRecentlyUsed) {
+  backend::RecorderCounters counters;
+  backend::Recorder recorder(2, 4096, 60000, &counters);
+  std::string paths[3] = {"test_recorder_lru0.bin", "test_recorder_lru1.bin",
+                          "test_recorder_lru2.bin"};
+  for (const std::string& path : paths) {
+    std::remove(path.c_str());
+  }
+  recorder.Append(paths[0], "0", 1, 0);
+  recorder.Append(paths[1], "1", 1, 0);
+  recorder.Append(paths[0], "0", 1, 0);
+  // paths[1] is the least recently used; opening paths[2] closes it.
+  recorder.Append(paths[2], "2", 1, 0);
+  EXPECT_EQ(recorder.OpenFiles(), 2u);
+  EXPECT_EQ(counters.evictions.load(), 1u);
+  EXPECT_EQ(ReadFile(paths[1]), "1");
+  EXPECT_EQ(ReadFile(paths[0]), "");
+  recorder.CloseAll();
+  EXPECT_EQ(ReadFile(paths[0]), "00");
+  EXPECT_EQ(ReadFile(paths[2]), "2");
+  for (const std::string& path : paths) {
+    std::remove(path.c_str());
+  }
+}
+
+TEST(RecorderTest, CountsDroppedRecords) {
+  backend::InitLogger("error");
+  backend::RecorderCounters counters;
+  backend::Recorder recorder(2, 4096, 60000, &counters);
+  // A directory cannot be opened for writing.
+  ::mkdir("test_recorder_not_a_file", 0755);
+  EXPECT_FALSE(recorder.Append("test_recorder_not_a_file", "x", 1, 0));
+  EXPECT_EQ(counters.dropped_records.load(), 1u);
+  ::rmdir("test_recorder_not_a_file");
+}
@@ -0,0 +1,130 @@
+#include "recording_segments.h"
+#include "recorder.h"
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+#include <gtest/gtest.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+void WriteFile(const std::string& path, std::size_t size) {
+  std::ofstream output(path, std::ios::binary | std::ios::trunc);
+  output << std::string(size, 's');
+}
+
+bool Exists(const std::string& path) {
+  struct stat st;
+  return ::stat(path.c_str(), &st) == 0;
+}
+
+}  // namespace
+
+TEST(RecordingSegmentsTest, CutsBySize) {
+  backend::RecordingSegmenter segmenter(100, 0);
+  EXPECT_TRUE(segmenter.Place(0, 60, 0));
+  EXPECT_FALSE(segmenter.Place(60, 40, 0));
+  // 100 bytes are full; the next record starts segment 1 at offset 0.
+  EXPECT_TRUE(segmenter.Place(100, 10, 0));
+  EXPECT_EQ(segmenter.Segment(), 1u);
+  EXPECT_EQ(segmenter.SegmentOffset(), 0u);
+  EXPECT_FALSE(segmenter.Place(110, 5, 0));
+  EXPECT_EQ(segmenter.SegmentOffset(), 10u);
+  // Too large for any segment: it gets one to itself.
+  EXPECT_TRUE(segmenter.Place(115, 500, 0));
+  EXPECT_TRUE(segmenter.Place(615, 1, 0));
+  EXPECT_EQ(segmenter.Segment(), 3u);
+}
+
+TEST(RecordingSegmentsTest, CutsByTime) {
+  backend::RecordingSegmenter segmenter(0, 1000);
+  EXPECT_TRUE(segmenter.Place(0, 10, 5000));
+  EXPECT_FALSE(segmenter.Place(10, 10, 5999));
+  EXPECT_TRUE(segmenter.Place(20, 10, 6000));
+  EXPECT_EQ(segmenter.SegmentOffset(), 0u);
+  EXPECT_EQ(backend::SegmentName("rtp/session_3", 2, 1760000000000),
+            "rtp/session_3_000002_1760000000000");
+}
+
+TEST(RecordingSegmentsTest, SealsPreallocatedSegment) {
+  backend::RecorderCounters counters;
+  std::string part = "test_segments_seal.bin.part";
+  {
+    backend::Recorder recorder(4, 4096, 60000, &counters);
+    ASSERT_TRUE(recorder.Append(part, "abc", 3, 0, 16 << 20));
+  }
+  struct stat st;
+  ASSERT_EQ(::stat(part.c_str(), &st), 0);
+  // The reservation does not show in the size, and only its first chunk is
+  // taken up front.
+  EXPECT_EQ(st.st_size, 3);
+  EXPECT_LE(st.st_blocks * 512, 2 << 20);
+  ASSERT_TRUE(backend::SealSegment(part));
+  EXPECT_FALSE(Exists(part));
+  ASSERT_EQ(::stat("test_segments_seal.bin", &st), 0);
+  EXPECT_EQ(st.st_size, 3);
+  EXPECT_LT(st.st_blocks * 512, 1 << 20);
+  EXPECT_FALSE(backend::SealSegment("test_segments_seal.bin"));
+  std::remove("test_segments_seal.bin");
+}
+
+TEST(RecordingSegmentsTest, KeepsNewestSegmentsWithinBudget) {
+  std::string dir = "test_segments_retention";
+  ::mkdir(dir.c_str(), 0755);
+  // Three segments of a payload and an index file each, oldest first, and
+  // one left unfinished by an earlier run.
+  const char* names[] = {"s_000000_1", "s_000001_2", "s_000002_3"};
+  for (const char* name : names) {
+    WriteFile(dir + "/" + name + ".bin", 40000);
+    WriteFile(dir + "/" + name + ".ridx", 1000);
+    ::usleep(20000);
+  }
+  WriteFile(dir + "/s_000003_4.bin.part", 40000);
+
+  EXPECT_EQ(backend::SealLeftoverSegments(dir), 1u);
+  EXPECT_TRUE(Exists(dir + "/s_000003_4.bin"));
+  std::uint64_t freed = 0;
+  EXPECT_EQ(backend::EnforceRetention(dir, 1 << 30, &freed), 0u);
+  EXPECT_EQ(freed, 0u);
+  // Room for about two segments: the two oldest go, each as a whole.
+  EXPECT_EQ(backend::EnforceRetention(dir, 100000, &freed), 2u);
+  EXPECT_GT(freed, 80000u);
+  EXPECT_FALSE(Exists(dir + "/s_000000_1.bin"));
+  EXPECT_FALSE(Exists(dir + "/s_000000_1.ridx"));
+  EXPECT_FALSE(Exists(dir + "/s_000001_2.ridx"));
+  EXPECT_TRUE(Exists(dir + "/s_000002_3.bin"));
+  EXPECT_TRUE(Exists(dir + "/s_000002_3.ridx"));
+  EXPECT_TRUE(Exists(dir + "/s_000003_4.bin"));
+
+  std::remove((dir + "/s_000002_3.bin").c_str());
+  std::remove((dir + "/s_000002_3.ridx").c_str());
+  std::remove((dir + "/s_000003_4.bin").c_str());
+  ::rmdir(dir.c_str());
+}
+
+TEST(RecordingSegmentsTest, OpenSegmentReservationsKeepSealedSegments) {
+  std::string dir = "test_segments_reserved";
+  ::mkdir(dir.c_str(), 0755);
+  WriteFile(dir + "/s_000000_1.bin", 40000);
+  backend::RecorderCounters counters;
+  backend::Recorder recorder(16, 4096, 60000, &counters);
+  for (int i = 0; i < 8; ++i) {
+    std::string part = dir + "/t" + std::to_string(i) + "_000000_2.bin.part";
+    ASSERT_TRUE(recorder.Append(part, "abc", 3, 0, 16 << 20));
+  }
+  recorder.CloseAll();
+
+  // Reserved megabytes of open segments are not data to make room for.
+  std::uint64_t freed = 0;
+  EXPECT_EQ(backend::EnforceRetention(dir, 100000, &freed), 0u);
+  EXPECT_TRUE(Exists(dir + "/s_000000_1.bin"));
+
+  for (int i = 0; i < 8; ++i) {
+    std::remove((dir + "/t" + std::to_string(i) + "_000000_2.bin.part").c_str());
+  }
+  std::remove((dir + "/s_000000_1.bin").c_str());
+  ::rmdir(dir.c_str());
+}
@@ -0,0 +1,144 @@
+#include "rtcp.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace {
+
+void Append32(std::string& out, std::uint32_t value) {
+  out.push_back(static_cast<char>(value >> 24));
+  out.push_back(static_cast<char>(value >> 16));
+  out.push_back(static_cast<char>(value >> 8));
+  out.push_back(static_cast<char>(value));
+}
+
+// SDES with one CNAME chunk, followed by a BYE for the same SSRC.
+std::string SdesAndBye(std::uint32_t ssrc, const std::string& cname) {
+  std::string chunk;
+  Append32(chunk, ssrc);
+  chunk.push_back(1);
+  chunk.push_back(static_cast<char>(cname.size()));
+  chunk.append(cname);
+  chunk.push_back(0);
+  while (chunk.size() % 4 != 0) {
+    chunk.push_back(0);
+  }
+  std::string packet;
+  packet.push_back(static_cast<char>(0x81));
+  packet.push_back(static_cast<char>(backend::kRtcpSourceDescription));
+  std::size_t words = chunk.size() / 4;
+  packet.push_back(static_cast<char>(words >> 8));
+  packet.push_back(static_cast<char>(words));
+  packet.append(chunk);
+  packet.push_back(static_cast<char>(0x81));
+  packet.push_back(static_cast<char>(backend::kRtcpBye));
+  packet.push_back(0);
+  packet.push_back(1);
+  Append32(packet, ssrc);
+  return packet;
+}
+
+}  // namespace
+
+TEST(RtcpTest, SenderReportRoundTrip) {
+  backend::RtcpSenderInfo info;
+  info.ntp_timestamp = 0x0102030405060708ull;
+  info.rtp_timestamp = 90000;
+  info.packet_count = 10;
+  info.octet_count = 12000;
+  backend::RtcpReportBlock block;
+  block.ssrc = 0xAABBCCDD;
+  block.fraction_lost = 64;
+  block.cumulative_lost = -3;
+  block.extended_highest_sequence = 0x10005;
+  block.jitter = 42;
+  block.last_sr = 0x03040506;
+  block.delay_since_last_sr = 65536;
+  char buffer[128];
+  std::size_t size = backend::BuildRtcpReport(0x11111111, &info, &block, 1, buffer, sizeof(buffer));
+  ASSERT_EQ(size, 52u);
+  EXPECT_TRUE(backend::IsRtcp(buffer, size));
+
+  backend::RtcpCompound compound;
+  ASSERT_TRUE(backend::ParseRtcp(buffer, size, compound));
+  ASSERT_EQ(compound.sender_reports.size(), 1u);
+  EXPECT_EQ(compound.sender_reports[0].ssrc, 0x11111111u);
+  EXPECT_EQ(compound.sender_reports[0].info.ntp_timestamp, info.ntp_timestamp);
+  EXPECT_EQ(compound.sender_reports[0].info.octet_count, 12000u);
+  ASSERT_EQ(compound.report_blocks.size(), 1u);
+  const backend::RtcpReportBlock& parsed = compound.report_blocks[0].second;
+  EXPECT_EQ(parsed.ssrc, block.ssrc);
+  EXPECT_EQ(parsed.fraction_lost, 64);
+  EXPECT_EQ(parsed.cumulative_lost, -3);
+  EXPECT_EQ(parsed.extended_highest_sequence, 0x10005u);
+  EXPECT_EQ(parsed.jitter, 42u);
+  EXPECT_EQ(parsed.last_sr, 0x03040506u);
+  EXPECT_EQ(parsed.delay_since_last_sr, 65536u);
+}
+
+TEST(RtcpTest, ParsesSdesAndBye) {
+  std::string packet = SdesAndBye(0x1234, "alice@example");
+  backend::RtcpCompound compound;
+  ASSERT_TRUE(backend::ParseRtcp(packet.data(), packet.size(), compound));
+  ASSERT_EQ(compound.cnames.size(), 1u);
+  EXPECT_EQ(compound.cnames[0].first, 0x1234u);
+  EXPECT_EQ(compound.cnames[0].second, "alice@example");
+  ASSERT_EQ(compound.bye_ssrcs.size(), 1u);
+  EXPECT_EQ(compound.bye_ssrcs[0], 0x1234u);
+
+  // A length running past the datagram is rejected.
+  compound.Clear();
+  EXPECT_FALSE(backend::ParseRtcp(packet.data(), packet.size() - 2, compound));
+}
+
+TEST(RtcpTest, BuildsReportWithCname) {
+  backend::RtcpReportBlock block;
+  block.ssrc = 0x22222222;
+  char buffer[300];
+  std::size_t size =
+      backend::BuildRtcpReport(0x11111111, nullptr, &block, 1, buffer, sizeof(buffer));
+  ASSERT_EQ(size, 32u);
+  std::size_t sdes =
+      backend::BuildRtcpSdes(0x11111111, "node-a", buffer + size, sizeof(buffer) - size);
+  // Header, SSRC, two item octets, six of CNAME and the end octet, padded.
+  ASSERT_EQ(sdes, 20u);
+  size += sdes;
+
+  backend::RtcpCompound compound;
+  ASSERT_TRUE(backend::ParseRtcp(buffer, size, compound));
+  ASSERT_EQ(compound.report_blocks.size(), 1u);
+  EXPECT_EQ(compound.report_blocks[0].first, 0x11111111u);
+  ASSERT_EQ(compound.cnames.size(), 1u);
+  EXPECT_EQ(compound.cnames[0].first, 0x11111111u);
+  EXPECT_EQ(compound.cnames[0].second, "node-a");
+
+  // A CNAME too long for the buffer writes nothing.
+  EXPECT_EQ(backend::BuildRtcpSdes(0x11111111, std::string(40, 'x'), buffer, 16), 0u);
+}
+
+TEST(RtcpTest, TellsRtcpFromRtp) {
+  // RTP with payload type 96 and the marker bit: second byte 0xE0.
+  const char rtp[12] = {static_cast<char>(0x80), static_cast<char>(0xE0)};
+  EXPECT_FALSE(backend::IsRtcp(rtp, sizeof(rtp)));
+  const char rr[8] = {static_cast<char>(0x80), static_cast<char>(201), 0, 1};
+  EXPECT_TRUE(backend::IsRtcp(rr, sizeof(rr)));
+}
+
+TEST(RtcpTest, ReportBlockFromStats) {
+  backend::RtpStreamStats stats;
+  stats.expected = 200;
+  stats.received = 190;
+  stats.lost = 10;
+  stats.extended_max_sequence = 0x100C7;
+  stats.jitter = 12.7;
+  // 100 expected and 90 received since the previous report: 10% lost.
+  backend::RtcpReportBlock block = backend::MakeRtcpReportBlock(7, stats, 100, 100);
+  EXPECT_EQ(block.ssrc, 7u);
+  EXPECT_EQ(block.fraction_lost, 25);
+  EXPECT_EQ(block.cumulative_lost, 10);
+  EXPECT_EQ(block.extended_highest_sequence, 0x100C7u);
+  EXPECT_EQ(block.jitter, 12u);
+}
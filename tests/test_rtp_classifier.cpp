@@ -0,0 +1,179 @@
+#include "rtp_classifier.h"
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace {
+
+void Append16(std::string& out, std::uint16_t value) {
+  out.push_back(static_cast<char>(value >> 8));
+  out.push_back(static_cast<char>(value));
+}
+
+void Append32(std::string& out, std::uint32_t value) {
+  out.push_back(static_cast<char>(value >> 24));
+  out.push_back(static_cast<char>(value >> 16));
+  out.push_back(static_cast<char>(value >> 8));
+  out.push_back(static_cast<char>(value));
+}
+
+std::string Rtp(std::uint8_t payload_type, bool marker, std::uint16_t seq, std::uint32_t ts,
+                std::uint32_t ssrc, int csrcs = 0, int extension_words = -1) {
+  std::string packet;
+  packet.push_back(static_cast<char>(0x80 | (extension_words >= 0 ? 0x10 : 0) | csrcs));
+  packet.push_back(static_cast<char>((marker ? 0x80 : 0) | payload_type));
+  Append16(packet, seq);
+  Append32(packet, ts);
+  Append32(packet, ssrc);
+  for (int i = 0; i < csrcs; ++i) {
+    Append32(packet, 1000 + i);
+  }
+  if (extension_words >= 0) {
+    Append16(packet, 0xBEDE);
+    Append16(packet, static_cast<std::uint16_t>(extension_words));
+    packet.append(static_cast<std::size_t>(extension_words) * 4, 'e');
+  }
+  packet.append(20, 'p');
+  return packet;
+}
+
+std::string Stun(std::uint16_t body) {
+  std::string packet;
+  Append16(packet, 0x0001);
+  Append16(packet, body);
+  Append32(packet, backend::kStunMagicCookie);
+  packet.append(12, 't');
+  packet.append(body, 'a');
+  return packet;
+}
+
+std::string ReceiverReport(std::uint32_t ssrc) {
+  std::string packet;
+  packet.push_back(static_cast<char>(0x80));
+  packet.push_back(static_cast<char>(201));
+  Append16(packet, 1);
+  Append32(packet, ssrc);
+  return packet;
+}
+
+backend::PacketBatch Classify(const std::vector<std::string>& packets) {
+  std::vector<const char*> data;
+  std::vector<std::size_t> len;
+  for (const std::string& packet : packets) {
+    data.push_back(packet.data());
+    len.push_back(packet.size());
+  }
+  backend::PacketBatch batch;
+  backend::ClassifyPackets(data.data(), len.data(), packets.size(), batch);
+  return batch;
+}
+
+}  // namespace
+
+TEST(RtpClassifierTest, ClassifiesAndParsesMixedBatch) {
+  std::vector<std::string> packets = {
+      Rtp(96, true, 65535, 90000, 0x11223344),
+      ReceiverReport(0x55667788),
+      Stun(8),
+      std::string("hello"),
+      Rtp(0, false, 7, 160, 42, 2, 1),
+  };
+  // STUN length that does not match the datagram.
+  std::string bad_stun = Stun(8);
+  bad_stun.push_back('x');
+  packets.push_back(bad_stun);
+  // Extension running past the end.
+  std::string short_rtp = Rtp(0, false, 1, 1, 1, 0, 100);
+  packets.push_back(short_rtp.substr(0, 20));
+
+  backend::PacketBatch batch = Classify(packets);
+  ASSERT_EQ(batch.kind.size(), packets.size());
+  EXPECT_EQ(batch.kind[0], backend::PacketClass::Rtp);
+  EXPECT_EQ(batch.kind[1], backend::PacketClass::Rtcp);
+  EXPECT_EQ(batch.kind[2], backend::PacketClass::Stun);
+  EXPECT_EQ(batch.kind[3], backend::PacketClass::Other);
+  EXPECT_EQ(batch.kind[4], backend::PacketClass::Rtp);
+  EXPECT_EQ(batch.kind[5], backend::PacketClass::Other);
+  EXPECT_EQ(batch.kind[6], backend::PacketClass::Other);
+
+  EXPECT_EQ(batch.payload_type[0], 96);
+  EXPECT_EQ(batch.marker[0], 1);
+  EXPECT_EQ(batch.sequence_number[0], 65535);
+  EXPECT_EQ(batch.timestamp[0], 90000u);
+  EXPECT_EQ(batch.ssrc[0], 0x11223344u);
+  EXPECT_EQ(batch.header_length[0], 12u);
+
+  backend::RtpHeader header = batch.Header(4);
+  EXPECT_EQ(header.version, 2);
+  EXPECT_EQ(header.csrc_count, 2);
+  EXPECT_TRUE(header.extension);
+  EXPECT_FALSE(header.marker);
+  EXPECT_EQ(header.ssrc, 42u);
+  EXPECT_EQ(header.header_length, 12u + 8u + 4u + 4u);
+}
+
+// Random and mutated packets, across several 16-packet blocks and a partial
+// one, must come out as the one-packet path classifies them.
+TEST(RtpClassifierTest, BatchMatchesSinglePacketPath) {
+  std::mt19937 random(7);
+  std::vector<std::string> packets;
+  for (int i = 0; i < 1000; ++i) {
+    std::string packet;
+    switch (random() % 4) {
+      case 0:
+        packet = Rtp(static_cast<std::uint8_t>(random() % 128), random() % 2 != 0,
+                     static_cast<std::uint16_t>(random()), random(), random(),
+                     static_cast<int>(random() % 3), static_cast<int>(random() % 3) - 1);
+        break;
+      case 1:
+        packet = ReceiverReport(random());
+        break;
+      case 2:
+        packet = Stun(static_cast<std::uint16_t>((random() % 8) * 4));
+        break;
+      default:
+        packet.resize(random() % 40);
+        for (char& c : packet) {
+          c = static_cast<char>(random());
+        }
+        break;
+    }
+    if (!packet.empty() && random() % 4 == 0) {
+      packet.resize(random() % packet.size());
+    }
+    if (!packet.empty() && random() % 4 == 0) {
+      packet[random() % std::min<std::size_t>(packet.size(), 4)] = static_cast<char>(random());
+    }
+    packets.push_back(packet);
+  }
+  packets.push_back(std::string(300, static_cast<char>(0x80)));
+
+  backend::PacketBatch batch = Classify(packets);
+  int rtp = 0;
+  for (std::size_t i = 0; i < packets.size(); ++i) {
+    backend::RtpHeader expected{};
+    backend::PacketClass kind =
+        backend::ClassifyPacket(packets[i].data(), packets[i].size(), expected);
+    ASSERT_EQ(batch.kind[i], kind) << "packet " << i;
+    if (kind != backend::PacketClass::Rtp) {
+      continue;
+    }
+    ++rtp;
+    backend::RtpHeader header = batch.Header(i);
+    EXPECT_EQ(header.version, expected.version);
+    EXPECT_EQ(header.padding, expected.padding);
+    EXPECT_EQ(header.extension, expected.extension);
+    EXPECT_EQ(header.csrc_count, expected.csrc_count);
+    EXPECT_EQ(header.marker, expected.marker);
+    EXPECT_EQ(header.payload_type, expected.payload_type);
+    EXPECT_EQ(header.sequence_number, expected.sequence_number);
+    EXPECT_EQ(header.timestamp, expected.timestamp);
+    EXPECT_EQ(header.ssrc, expected.ssrc);
+    EXPECT_EQ(header.header_length, expected.header_length);
+  }
+  EXPECT_GT(rtp, 100);
+}
@@ -0,0 +1,69 @@
+#include "rtp_forward_table.h"
+
+#include <cstdint>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace {
+
+backend::RtpForwardTarget SessionTarget(std::uint64_t session_id) {
+  return backend::RtpForwardTarget{session_id, 0, 0};
+}
+
+}  // namespace
+
+TEST(RtpForwardTableTest, AddLookupRemove) {
+  backend::RtpForwardTable table;
+  std::vector<backend::RtpForwardTarget> targets;
+  EXPECT_FALSE(table.Lookup(7, targets, nullptr));
+
+  EXPECT_TRUE(table.Add(7, SessionTarget(100)));
+  EXPECT_FALSE(table.Add(7, SessionTarget(100)));
+  EXPECT_TRUE(table.Add(7, backend::RtpForwardTarget{0, 0x0100007F, 9000}));
+  EXPECT_EQ(table.Size(), 1u);
+  ASSERT_TRUE(table.Lookup(7, targets, nullptr));
+  ASSERT_EQ(targets.size(), 2u);
+  EXPECT_EQ(targets[0].session_id, 100u);
+  EXPECT_EQ(targets[1].remote_port, 9000);
+  EXPECT_FALSE(table.Lookup(8, targets, nullptr));
+  EXPECT_TRUE(targets.empty());
+
+  table.Remove(7);
+  EXPECT_FALSE(table.Lookup(7, targets, nullptr));
+  EXPECT_EQ(table.Size(), 0u);
+}
+
+TEST(RtpForwardTableTest, RemoveSessionDropsItsTargets) {
+  backend::RtpForwardTable table;
+  table.Add(1, SessionTarget(100));
+  table.Add(2, SessionTarget(100));
+  table.Add(2, SessionTarget(200));
+  table.RemoveSession(100);
+  std::vector<backend::RtpForwardTarget> targets;
+  EXPECT_FALSE(table.Lookup(1, targets, nullptr));
+  ASSERT_TRUE(table.Lookup(2, targets, nullptr));
+  ASSERT_EQ(targets.size(), 1u);
+  EXPECT_EQ(targets[0].session_id, 200u);
+  EXPECT_EQ(table.Size(), 1u);
+}
+
+TEST(RtpForwardTableTest, SamplesEveryNthPacket) {
+  backend::RtpForwardTable table(4);
+  table.Add(9, SessionTarget(1));
+  std::vector<backend::RtpForwardTarget> targets;
+  int sampled_count = 0;
+  for (int i = 0; i < 12; ++i) {
+    bool sampled = false;
+    ASSERT_TRUE(table.Lookup(9, targets, &sampled));
+    sampled_count += sampled ? 1 : 0;
+    EXPECT_EQ(sampled, i % 4 == 0);
+  }
+  EXPECT_EQ(sampled_count, 3);
+
+  backend::RtpForwardTable silent;
+  silent.Add(9, SessionTarget(1));
+  bool sampled = true;
+  ASSERT_TRUE(silent.Lookup(9, targets, &sampled));
+  EXPECT_FALSE(sampled);
+}
@@ -0,0 +1,93 @@
+#include "rtp_index.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+#include <gtest/gtest.h>
+
+namespace {
+
+void WriteFile(const std::string& path, const std::string& data) {
+  std::ofstream output(path, std::ios::binary | std::ios::trunc);
+  output.write(data.data(), static_cast<std::streamsize>(data.size()));
+}
+
+}  // namespace
+
+TEST(RtpIndexTest, ExtendsTimestampsAcrossWrap) {
+  backend::RtpTimestampExtender extender;
+  std::uint64_t first = extender.Extend(0xFFFFFF00u);
+  EXPECT_EQ(extender.Extend(0x00000100u), first + 0x200);
+  // Slightly older timestamps stay below the newest one.
+  EXPECT_EQ(extender.Extend(0xFFFFFF80u), first + 0x80);
+}
+
+TEST(RtpIndexTest, WritesAndSeeks) {
+  // 20 ms audio frames at 8 kHz, one packet each, starting at wall time 5000.
+  backend::RtpIndexWriter writer(0x1234, 100);
+  std::string data;
+  std::uint64_t offset = 0;
+  for (std::uint32_t i = 0; i < 100; ++i) {
+    writer.Append(static_cast<std::uint16_t>(i), 0xFFFFF000u + i * 160u, 8, false, 5000 + i * 20,
+                  offset, 172, data);
+    offset += 172;
+  }
+  std::string path = "test_rtp_index.ridx";
+  WriteFile(path, data);
+
+  backend::RtpIndexReader reader;
+  ASSERT_TRUE(reader.Open(path));
+  EXPECT_EQ(reader.Header().ssrc, 0x1234u);
+  ASSERT_EQ(reader.Size(), 100u);
+  EXPECT_EQ(reader.Record(99).offset, 99u * 172u);
+  EXPECT_EQ(reader.Record(99).payload_type, 8);
+
+  EXPECT_EQ(reader.SeekWallClock(0), 0u);
+  EXPECT_EQ(reader.SeekWallClock(5000 + 50 * 20), 50u);
+  EXPECT_EQ(reader.SeekWallClock(5000 + 50 * 20 + 1), 51u);
+  EXPECT_EQ(reader.SeekWallClock(100000), 100u);
+  // The timestamps wrapped at packet 26; the seek does not notice.
+  std::uint64_t base = reader.Record(0).extended_timestamp;
+  EXPECT_EQ(reader.SeekTimestamp(base + 30 * 160), 30u);
+
+  // A checkpoint every 100 ms of wall time: every fifth packet.
+  EXPECT_EQ(reader.CheckpointBefore(0), 0u);
+  EXPECT_EQ(reader.CheckpointBefore(7), 5u);
+  EXPECT_EQ(reader.CheckpointBefore(10), 10u);
+  reader.Close();
+  std::remove(path.c_str());
+}
+
+TEST(RtpIndexTest, RejectsForeignFiles) {
+  std::string path = "test_rtp_index_foreign.ridx";
+  WriteFile(path, std::string(64, 'x'));
+  backend::RtpIndexReader reader;
+  EXPECT_FALSE(reader.Open(path));
+  EXPECT_FALSE(reader.Open("test_rtp_index_missing.ridx"));
+  std::remove(path.c_str());
+}
+
+TEST(RtpIndexTest, ConvertsTextIndex) {
+  std::string text_path = "test_rtp_index.idx";
+  std::string binary_path = "test_rtp_index_converted.ridx";
+  WriteFile(text_path,
+            "10 1000 4660 0 100\n"
+            "11 1000 4660 100 120\n"
+            "12 4000 4660 220 90\n");
+  ASSERT_TRUE(backend::ConvertRtpTextIndex(text_path, binary_path));
+  backend::RtpIndexReader reader;
+  ASSERT_TRUE(reader.Open(binary_path));
+  EXPECT_EQ(reader.Header().ssrc, 4660u);
+  ASSERT_EQ(reader.Size(), 3u);
+  EXPECT_EQ(reader.Record(1).sequence, 11);
+  EXPECT_EQ(reader.Record(1).offset, 100u);
+  EXPECT_EQ(reader.Record(2).length, 90u);
+  EXPECT_NE(reader.Record(2).flags & backend::kRtpIndexFrameStart, 0);
+  EXPECT_EQ(reader.Record(1).flags & backend::kRtpIndexFrameStart, 0);
+  EXPECT_EQ(reader.SeekTimestamp(reader.Record(0).extended_timestamp + 1), 2u);
+  reader.Close();
+  std::remove(text_path.c_str());
+  std::remove(binary_path.c_str());
+}
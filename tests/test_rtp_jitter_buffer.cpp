@@ -0,0 +1,144 @@
+#include "rtp_jitter_buffer.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace {
+
+// Tracks and holds a packet whose payload is its sequence number.
+void Push(backend::RtpJitterBuffer& buffer, std::uint16_t sequence, std::uint64_t now_ms) {
+  std::string payload = std::to_string(sequence);
+  std::uint64_t extended = buffer.Track(sequence, sequence * 3000u, now_ms);
+  if (extended != backend::RtpJitterBuffer::kRejected) {
+    buffer.Hold(extended, now_ms, payload.data(), payload.size());
+  }
+}
+
+std::vector<std::string> Release(backend::RtpJitterBuffer& buffer, std::uint64_t now_ms) {
+  std::vector<std::string> released;
+  buffer.Release(now_ms, [&](const char* data, std::size_t len, std::uint64_t, std::uint32_t) {
+    released.emplace_back(data, len);
+  });
+  return released;
+}
+
+}  // namespace
+
+TEST(RtpJitterBufferTest, ReleasesInSequenceOrder) {
+  backend::RtpJitterBuffer buffer(50, 90000);
+  Push(buffer, 10, 1000);
+  Push(buffer, 12, 1001);
+  Push(buffer, 11, 1002);
+  std::vector<std::string> released = Release(buffer, 1002);
+  ASSERT_EQ(released.size(), 3u);
+  EXPECT_EQ(released[0], "10");
+  EXPECT_EQ(released[1], "11");
+  EXPECT_EQ(released[2], "12");
+  EXPECT_EQ(buffer.Stats().reordered, 1u);
+  EXPECT_EQ(buffer.Stats().lost, 0);
+  EXPECT_EQ(buffer.Held(), 0u);
+}
+
+TEST(RtpJitterBufferTest, SkipsGapAfterDepth) {
+  backend::RtpJitterBuffer buffer(50, 90000);
+  Push(buffer, 1, 1000);
+  EXPECT_EQ(Release(buffer, 1000).size(), 1u);
+  Push(buffer, 3, 1010);
+  EXPECT_TRUE(Release(buffer, 1020).empty());
+  EXPECT_EQ(buffer.NextDueMs(), 1060u);
+  std::vector<std::string> released = Release(buffer, 1060);
+  ASSERT_EQ(released.size(), 1u);
+  EXPECT_EQ(released[0], "3");
+  EXPECT_EQ(buffer.Stats().skipped, 1u);
+  EXPECT_EQ(buffer.Stats().lost, 1);
+
+  // Sequence 2 shows up after its turn was given up.
+  std::uint64_t extended = buffer.Track(2, 6000, 1070);
+  EXPECT_FALSE(buffer.Hold(extended, 1070, "2", 1));
+  EXPECT_EQ(buffer.Stats().late, 1u);
+  EXPECT_EQ(buffer.Stats().lost, 0);
+}
+
+TEST(RtpJitterBufferTest, ExtendsSequenceAcrossWrap) {
+  backend::RtpJitterBuffer buffer(50, 90000);
+  Push(buffer, 65534, 1000);
+  Push(buffer, 0, 1001);
+  Push(buffer, 65535, 1002);
+  Push(buffer, 1, 1003);
+  std::vector<std::string> released = Release(buffer, 1003);
+  ASSERT_EQ(released.size(), 4u);
+  EXPECT_EQ(released[0], "65534");
+  EXPECT_EQ(released[1], "65535");
+  EXPECT_EQ(released[2], "0");
+  EXPECT_EQ(released[3], "1");
+  EXPECT_EQ(buffer.Stats().extended_max_sequence, (1u << 16) | 1u);
+  EXPECT_EQ(buffer.Stats().expected, 4u);
+  EXPECT_EQ(buffer.Stats().lost, 0);
+}
+
+// A jump of half the sequence space is a stray packet until the next one
+// follows it; then the stream restarts there.
+TEST(RtpJitterBufferTest, ResyncsAfterSequenceRestart) {
+  backend::RtpJitterBuffer buffer(50, 90000);
+  Push(buffer, 100, 1000);
+  Push(buffer, 101, 1001);
+  EXPECT_EQ(Release(buffer, 1001).size(), 2u);
+  Push(buffer, 103, 1002);
+
+  Push(buffer, 40000, 1003);
+  EXPECT_EQ(buffer.Stats().rejected, 1u);
+  Push(buffer, 102, 1004);
+  EXPECT_EQ(buffer.Stats().resyncs, 0u);
+  std::vector<std::string> released = Release(buffer, 1004);
+  ASSERT_EQ(released.size(), 2u);
+  EXPECT_EQ(released[1], "103");
+
+  Push(buffer, 104, 1005);
+  Push(buffer, 40000, 1006);
+  Push(buffer, 40001, 1007);
+  EXPECT_EQ(buffer.Stats().resyncs, 1u);
+  Push(buffer, 40002, 1008);
+  released = Release(buffer, 1008);
+  ASSERT_EQ(released.size(), 2u);
+  EXPECT_EQ(released[0], "40001");
+  EXPECT_EQ(released[1], "40002");
+  // 104 was still held when the sender restarted.
+  EXPECT_EQ(buffer.Stats().late, 1u);
+  EXPECT_EQ(buffer.Stats().expected, 2u);
+  EXPECT_EQ(buffer.Stats().lost, 0);
+
+  // Far behind the new highest is rejected too, not taken as reordering.
+  Push(buffer, 39000, 1009);
+  EXPECT_EQ(buffer.Stats().rejected, 3u);
+  EXPECT_EQ(buffer.Stats().reordered, 1u);
+}
+
+TEST(RtpJitterBufferTest, DropsDuplicates) {
+  backend::RtpJitterBuffer buffer(50, 90000);
+  Push(buffer, 5, 1000);
+  Push(buffer, 7, 1001);
+  Push(buffer, 7, 1002);
+  EXPECT_EQ(buffer.Stats().duplicates, 1u);
+  EXPECT_EQ(buffer.Held(), 2u);
+}
+
+TEST(RtpJitterBufferTest, InterarrivalJitter) {
+  // 8 kHz clock, 20 ms packets: 160 timestamp units apart.
+  backend::RtpJitterBuffer steady(0, 8000);
+  for (std::uint16_t i = 0; i < 50; ++i) {
+    steady.Track(i, i * 160u, 1000 + i * 20u);
+  }
+  EXPECT_DOUBLE_EQ(steady.Stats().jitter, 0.0);
+
+  // Arrivals alternating 10 ms early and late give |D| = 160 every packet,
+  // so the estimate converges on 160.
+  backend::RtpJitterBuffer uneven(0, 8000);
+  for (std::uint16_t i = 0; i < 200; ++i) {
+    std::uint64_t arrival = 1000 + i * 20u + (i % 2 == 0 ? 0 : 20);
+    uneven.Track(i, i * 160u, arrival);
+  }
+  EXPECT_NEAR(uneven.Stats().jitter, 160.0, 1.0);
+}
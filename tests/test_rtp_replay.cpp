@@ -0,0 +1,119 @@
+#include "rtp_index.h"
+#include "rtp_replay.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+
+#include <arpa/inet.h>
+#include <gtest/gtest.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+void WriteFile(const std::string& path, const std::string& data) {
+  std::ofstream output(path, std::ios::binary | std::ios::trunc);
+  output.write(data.data(), static_cast<std::streamsize>(data.size()));
+}
+
+// Writes count 20 ms audio packets at 8 kHz; packet i carries i in its
+// last byte. Returns the payload bytes written.
+std::size_t WriteRecording(const std::string& base, std::uint32_t count,
+                           std::size_t bin_limit = std::string::npos) {
+  backend::RtpIndexWriter writer(0x4242, 100);
+  std::string bin;
+  std::string index;
+  for (std::uint32_t i = 0; i < count; ++i) {
+    std::string packet(12, '\0');
+    packet[0] = static_cast<char>(0x80);
+    packet[1] = 8;
+    packet.push_back(static_cast<char>(i));
+    writer.Append(static_cast<std::uint16_t>(i), 1000 + i * 160, 8, false, 5000 + i * 20,
+                  bin.size(), static_cast<std::uint32_t>(packet.size()), index);
+    bin += packet;
+  }
+  bin = bin.substr(0, bin_limit);
+  WriteFile(base + ".bin", bin);
+  WriteFile(base + ".ridx", index);
+  return bin.size();
+}
+
+void RemoveRecording(const std::string& base) {
+  std::remove((base + ".bin").c_str());
+  std::remove((base + ".ridx").c_str());
+}
+
+}  // namespace
+
+TEST(RtpReplayTest, PacesByRtpTimestamp) {
+  std::string base = "test_rtp_replay_pace";
+  WriteRecording(base, 10);
+  backend::RtpReplay replay;
+  ASSERT_TRUE(replay.Open(base));
+  EXPECT_EQ(replay.Packets(), 10u);
+  replay.Start(1000000, 2.0, 8000);
+  EXPECT_EQ(replay.NextDueUs(), 1000000u);
+  // Nothing is due yet, so nothing is sent.
+  EXPECT_EQ(replay.SendDue(-1, sockaddr_in(), 999999, 8), 0u);
+  EXPECT_EQ(replay.SendCalls(), 0u);
+  replay.Close();
+  RemoveRecording(base);
+}
+
+TEST(RtpReplayTest, SendsDuePacketsInBatches) {
+  std::string base = "test_rtp_replay_send";
+  WriteRecording(base, 10);
+  int receiver = ::socket(AF_INET, SOCK_DGRAM, 0);
+  ASSERT_GE(receiver, 0);
+  sockaddr_in addr;
+  std::memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  ASSERT_EQ(::bind(receiver, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)), 0);
+  socklen_t addr_len = sizeof(addr);
+  ASSERT_EQ(::getsockname(receiver, reinterpret_cast<sockaddr*>(&addr), &addr_len), 0);
+  int sender = ::socket(AF_INET, SOCK_DGRAM, 0);
+  ASSERT_GE(sender, 0);
+
+  backend::RtpReplay replay;
+  ASSERT_TRUE(replay.Open(base));
+  // 160 ticks at 8 kHz are 20 ms; twice as fast, 10 ms.
+  replay.Start(0, 2.0, 8000);
+  // Packets 0 to 5 are due by 50 ms: one batch of four, one of two.
+  EXPECT_EQ(replay.SendDue(sender, addr, 50000, 4), 6u);
+  EXPECT_EQ(replay.SendCalls(), 2u);
+  EXPECT_EQ(replay.NextDueUs(), 60000u);
+  EXPECT_EQ(replay.SendDue(sender, addr, 1000000, 4), 4u);
+  EXPECT_TRUE(replay.Done());
+  EXPECT_EQ(replay.Sent(), 10u);
+
+  // Starting 110 ms in goes back to the checkpoint at packet 5.
+  replay.Start(0, 0, 8000, 110);
+  EXPECT_EQ(replay.SendDue(sender, addr, 0, 64), 5u);
+  EXPECT_TRUE(replay.Done());
+
+  for (int i = 0; i < 15; ++i) {
+    char buffer[64];
+    ssize_t n = ::recv(receiver, buffer, sizeof(buffer), 0);
+    ASSERT_EQ(n, 13);
+    EXPECT_EQ(buffer[12], static_cast<char>(i < 10 ? i : i - 5));
+  }
+  ::close(sender);
+  ::close(receiver);
+  RemoveRecording(base);
+}
+
+TEST(RtpReplayTest, StopsAtTheEndOfThePayloadFile) {
+  std::string base = "test_rtp_replay_short";
+  // The last packet is only half in the payload file.
+  WriteRecording(base, 4, 13 * 3 + 6);
+  backend::RtpReplay replay;
+  ASSERT_TRUE(replay.Open(base));
+  EXPECT_EQ(replay.Packets(), 3u);
+  EXPECT_FALSE(replay.Open("test_rtp_replay_missing"));
+  RemoveRecording(base);
+}
@@ -0,0 +1,89 @@
+#include "timing_wheel.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+TEST(TimingWheelTest, FiresAtDeadlineNotBefore) {
+  backend::TimingWheel wheel(10, 1000);
+  wheel.Schedule(7, 1055);
+  std::vector<std::uint64_t> expired;
+  wheel.Advance(1050, expired);
+  EXPECT_TRUE(expired.empty());
+  wheel.Advance(1059, expired);
+  EXPECT_TRUE(expired.empty());
+  wheel.Advance(1060, expired);
+  ASSERT_EQ(expired.size(), 1u);
+  EXPECT_EQ(expired[0], 7u);
+  EXPECT_EQ(wheel.Size(), 0u);
+}
+
+TEST(TimingWheelTest, PastDeadlineFiresOnNextTick) {
+  backend::TimingWheel wheel(10, 1000);
+  wheel.Schedule(1, 500);
+  std::vector<std::uint64_t> expired;
+  wheel.Advance(1000, expired);
+  EXPECT_TRUE(expired.empty());
+  wheel.Advance(1010, expired);
+  EXPECT_EQ(expired.size(), 1u);
+}
+
+TEST(TimingWheelTest, CancelledTimerDoesNotFire) {
+  backend::TimingWheel wheel(1, 0);
+  std::uint32_t a = wheel.Schedule(1, 5);
+  wheel.Schedule(2, 5);
+  wheel.Cancel(a);
+  wheel.Cancel(a);
+  EXPECT_EQ(wheel.Size(), 1u);
+  std::vector<std::uint64_t> expired;
+  wheel.Advance(10, expired);
+  ASSERT_EQ(expired.size(), 1u);
+  EXPECT_EQ(expired[0], 2u);
+}
+
+TEST(TimingWheelTest, CascadesThroughAllLevels) {
+  backend::TimingWheel wheel(1, 12345);
+  const std::vector<std::uint64_t> delays = {1, 63, 64, 65, 4095, 4096, 4097,
+                                             262143, 262144, 300000, 20000000};
+  for (std::uint64_t delay : delays) {
+    wheel.Schedule(delay, 12345 + delay);
+  }
+  std::vector<std::uint64_t> expired;
+  std::uint64_t now = 12345;
+  std::vector<std::uint64_t> fired_at;
+  while (wheel.Size() > 0) {
+    now += 1;
+    std::size_t before = expired.size();
+    wheel.Advance(now, expired);
+    for (std::size_t i = before; i < expired.size(); ++i) {
+      EXPECT_EQ(expired[i], now - 12345);
+    }
+  }
+  std::vector<std::uint64_t> sorted = expired;
+  std::sort(sorted.begin(), sorted.end());
+  EXPECT_EQ(sorted, delays);
+}
+
+TEST(TimingWheelTest, LargeJumpFiresEverything) {
+  backend::TimingWheel wheel(100, 0);
+  for (std::uint64_t i = 0; i < 1000; ++i) {
+    wheel.Schedule(i, i * 997);
+  }
+  std::vector<std::uint64_t> expired;
+  wheel.Advance(500000, expired);
+  EXPECT_EQ(expired.size(), 502u);
+  wheel.Advance(1000000, expired);
+  EXPECT_EQ(expired.size(), 1000u);
+  EXPECT_EQ(wheel.Size(), 0u);
+}
+
+TEST(TimingWheelTest, ReusesReleasedTimers) {
+  backend::TimingWheel wheel(1, 0);
+  std::uint32_t first = wheel.Schedule(1, 3);
+  std::vector<std::uint64_t> expired;
+  wheel.Advance(3, expired);
+  std::uint32_t second = wheel.Schedule(2, 10);
+  EXPECT_EQ(first, second);
+}
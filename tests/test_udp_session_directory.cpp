@@ -0,0 +1,157 @@
+#include "reuseport_steering.h"
+#include "udp_session_directory.h"
+
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+TEST(UdpSessionDirectoryTest, PeerKeepsIdAcrossThreads) {
+  backend::UdpSessionDirectory directory;
+  bool created = false;
+  backend::UdpSession first = directory.FindOrCreate(0x0100007F, 6000,
+                                                     backend::ProtocolType::Udp, 1, 10,
+                                                     &created);
+  EXPECT_TRUE(created);
+  EXPECT_EQ(backend::SessionOwner(first.id), 1);
+  // A second thread seeing the same peer gets the same session and owner.
+  backend::UdpSession again = directory.FindOrCreate(0x0100007F, 6000,
+                                                     backend::ProtocolType::Udp, 2, 20,
+                                                     &created);
+  EXPECT_FALSE(created);
+  EXPECT_EQ(again.id, first.id);
+
+  backend::UdpSession found;
+  ASSERT_TRUE(directory.FindById(first.id, found));
+  EXPECT_EQ(found.remote_addr, 0x0100007Fu);
+  EXPECT_EQ(found.remote_port, 6000);
+  EXPECT_EQ(found.last_active_ms, 20u);
+}
+
+TEST(UdpSessionDirectoryTest, RemovedIdsStayStale) {
+  backend::UdpSessionDirectory directory;
+  backend::UdpSession first =
+      directory.FindOrCreate(0x0200000A, 6000, backend::ProtocolType::Udp, 0, 0);
+  EXPECT_TRUE(directory.Remove(first.id));
+  EXPECT_FALSE(directory.Remove(first.id));
+  backend::UdpSession found;
+  EXPECT_FALSE(directory.FindById(first.id, found));
+
+  backend::UdpSession second =
+      directory.FindOrCreate(0x0200000A, 6000, backend::ProtocolType::Udp, 0, 0);
+  EXPECT_EQ(backend::SessionIndex(second.id), backend::SessionIndex(first.id));
+  EXPECT_NE(second.id, first.id);
+  EXPECT_FALSE(directory.FindById(first.id, found));
+  EXPECT_TRUE(directory.FindById(second.id, found));
+  EXPECT_EQ(directory.Size(), 1u);
+}
+
+TEST(UdpSessionDirectoryTest, ConcurrentCreatorsAgree) {
+  backend::UdpSessionDirectory directory;
+  const int threads = 4;
+  const std::uint16_t peers = 2000;
+  std::vector<std::vector<std::uint64_t>> ids(threads);
+  std::vector<std::thread> workers;
+  for (int t = 0; t < threads; ++t) {
+    workers.emplace_back([&, t]() {
+      for (std::uint16_t port = 0; port < peers; ++port) {
+        ids[t].push_back(directory
+                             .FindOrCreate(0x0100007F, port, backend::ProtocolType::Udp, t, 0)
+                             .id);
+      }
+    });
+  }
+  for (auto& worker : workers) {
+    worker.join();
+  }
+  for (int t = 1; t < threads; ++t) {
+    EXPECT_EQ(ids[t], ids[0]);
+  }
+  EXPECT_EQ(directory.Size(), peers);
+}
+
+TEST(RtpSessionDirectoryTest, ReservesRecordingOffsets) {
+  backend::RtpSessionDirectory directory;
+  std::uint64_t offset = 0;
+  bool created = false;
+  backend::RtpSession first = directory.FindOrCreate(42, 1, 0, 100, &offset, &created);
+  EXPECT_TRUE(created);
+  EXPECT_EQ(offset, 0u);
+  backend::RtpSession second = directory.FindOrCreate(42, 0, 5, 60, &offset, &created);
+  EXPECT_FALSE(created);
+  EXPECT_EQ(second.id, first.id);
+  EXPECT_EQ(second.owner, 1);
+  EXPECT_EQ(offset, 100u);
+  EXPECT_NE(directory.FindOrCreate(43, 0, 5, 10, &offset).id, first.id);
+
+  backend::RtpSession found;
+  ASSERT_TRUE(directory.Find(42, found));
+  EXPECT_EQ(found.last_active_ms, 5u);
+  EXPECT_EQ(found.owner, 1);
+  directory.Remove(42);
+  EXPECT_FALSE(directory.Find(42, found));
+}
+
+TEST(ReuseportSteeringTest, SourceAlwaysReachesPredictedSocket) {
+  const int group_size = 3;
+  std::vector<int> fds;
+  std::uint16_t port = 0;
+  for (int i = 0; i < group_size; ++i) {
+    int fd = ::socket(AF_INET, SOCK_DGRAM, 0);
+    ASSERT_GE(fd, 0);
+    int on = 1;
+    ::setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on));
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    ASSERT_EQ(::bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)), 0);
+    socklen_t len = sizeof(addr);
+    ::getsockname(fd, reinterpret_cast<sockaddr*>(&addr), &len);
+    port = ntohs(addr.sin_port);
+    fds.push_back(fd);
+  }
+  if (!backend::AttachReuseportSteering(fds[0], group_size)) {
+    for (int fd : fds) {
+      ::close(fd);
+    }
+    GTEST_SKIP() << "SO_ATTACH_REUSEPORT_CBPF not supported";
+  }
+  sockaddr_in target{};
+  target.sin_family = AF_INET;
+  target.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  target.sin_port = htons(port);
+  for (int client = 0; client < 24; ++client) {
+    int fd = ::socket(AF_INET, SOCK_DGRAM, 0);
+    ASSERT_GE(fd, 0);
+    sockaddr_in local{};
+    local.sin_family = AF_INET;
+    local.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    ASSERT_EQ(::bind(fd, reinterpret_cast<sockaddr*>(&local), sizeof(local)), 0);
+    socklen_t len = sizeof(local);
+    ::getsockname(fd, reinterpret_cast<sockaddr*>(&local), &len);
+    for (int i = 0; i < 3; ++i) {
+      ::sendto(fd, "x", 1, 0, reinterpret_cast<sockaddr*>(&target), sizeof(target));
+    }
+    int expected =
+        backend::ReuseportSteeringIndex(local.sin_addr.s_addr, ntohs(local.sin_port), group_size);
+    for (int i = 0; i < group_size; ++i) {
+      char byte;
+      int received = 0;
+      while (::recv(fds[i], &byte, 1, MSG_DONTWAIT) == 1) {
+        ++received;
+      }
+      EXPECT_EQ(received, i == expected ? 3 : 0);
+    }
+    ::close(fd);
+  }
+  for (int fd : fds) {
+    ::close(fd);
+  }
+}
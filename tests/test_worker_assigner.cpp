@@ -0,0 +1,68 @@
+#include "worker_assigner.h"
+
+#include <cstdint>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+TEST(WorkerAssignerTest, ParsesPolicyNames) {
+  backend::WorkerAssignment policy = backend::WorkerAssignment::RoundRobin;
+  EXPECT_TRUE(backend::ParseWorkerAssignment("least_loaded", policy));
+  EXPECT_EQ(policy, backend::WorkerAssignment::LeastLoaded);
+  EXPECT_TRUE(backend::ParseWorkerAssignment("consistent_hash", policy));
+  EXPECT_EQ(policy, backend::WorkerAssignment::ConsistentHash);
+  EXPECT_FALSE(backend::ParseWorkerAssignment("random", policy));
+}
+
+TEST(WorkerAssignerTest, RoundRobinCyclesFromStart) {
+  backend::WorkerAssigner assigner(backend::WorkerAssignment::RoundRobin, 3, 1);
+  EXPECT_EQ(assigner.Assign(0), 1);
+  EXPECT_EQ(assigner.Assign(0), 2);
+  EXPECT_EQ(assigner.Assign(0), 0);
+  EXPECT_EQ(assigner.Assign(0), 1);
+}
+
+TEST(WorkerAssignerTest, LeastLoadedPicksShallowestQueue) {
+  std::vector<std::size_t> depth = {5, 2, 7, 2};
+  backend::WorkerAssigner assigner(backend::WorkerAssignment::LeastLoaded, 4, 0,
+                                   [&](int worker) { return depth[worker]; });
+  EXPECT_EQ(assigner.Assign(0), 1);
+  // Ties go to the next worker in round-robin order.
+  EXPECT_EQ(assigner.Assign(0), 1);
+  EXPECT_EQ(assigner.Assign(0), 3);
+  depth = {0, 0, 0, 0};
+  EXPECT_EQ(assigner.Assign(0), 3);
+  EXPECT_EQ(assigner.Assign(0), 0);
+}
+
+TEST(WorkerAssignerTest, ConsistentHashIsStickyAndSpreads) {
+  backend::WorkerAssigner assigner(backend::WorkerAssignment::ConsistentHash, 8);
+  std::vector<int> counts(8, 0);
+  for (std::uint32_t addr = 0; addr < 8000; ++addr) {
+    int worker = assigner.Assign(addr);
+    ASSERT_GE(worker, 0);
+    ASSERT_LT(worker, 8);
+    EXPECT_EQ(assigner.Assign(addr), worker);
+    ++counts[static_cast<std::size_t>(worker)];
+  }
+  for (int count : counts) {
+    EXPECT_GT(count, 500);
+    EXPECT_LT(count, 1500);
+  }
+}
+
+TEST(WorkerAssignerTest, ConsistentHashMovesFewClientsWhenWorkersChange) {
+  backend::WorkerAssigner before(backend::WorkerAssignment::ConsistentHash, 8);
+  backend::WorkerAssigner after(backend::WorkerAssignment::ConsistentHash, 9);
+  int moved = 0;
+  const int clients = 9000;
+  for (std::uint32_t addr = 0; addr < static_cast<std::uint32_t>(clients); ++addr) {
+    int old_worker = before.Assign(addr);
+    int new_worker = after.Assign(addr);
+    if (new_worker != old_worker) {
+      EXPECT_EQ(new_worker, 8);
+      ++moved;
+    }
+  }
+  EXPECT_LT(moved, clients / 9 * 2);
+}